@@ -94,6 +94,7 @@ public class SerialPort {
 		public SerialPortFlowControl flowControl = SerialPortFlowControl.FLOW_NONE;
 		public char xonChar;
 		public char xoffChar;
+		public boolean lowLatency;
 
 		@Override
 		public boolean equals(Object obj) {
@@ -104,7 +105,8 @@ public class SerialPort {
 						Objects.equals(this.parity, other.parity) &&
 						Objects.equals(this.flowControl, other.flowControl) &&
 						this.xonChar == other.xonChar &&
-						this.xoffChar == other.xoffChar;
+						this.xoffChar == other.xoffChar &&
+						this.lowLatency == other.lowLatency;
 			}
 			return false;
 		}
@@ -140,6 +142,7 @@ public class SerialPort {
 	private static native boolean n_setManualPortState(long handle, boolean dtrState, boolean rtsState);
 	private static native boolean n_waitForEvents(long handle, boolean[] events);
 	private static native void n_abortWait(long handle);
+	private static native void n_wakeup(long handle);
 	
 	private final long handle;
 	private final String portName;
@@ -392,6 +395,14 @@ public class SerialPort {
 		n_abortWait(handle);
 	}
 	
+	/**
+	 * Releases the current or next call to waitForEvents, can be called from any thread.
+	 * In contrast to abortWait, the wakeup is not lost if it arrives before the wait started.
+	 */
+	public void wakeup() {
+		n_wakeup(handle);
+	}
+	
 	public SerialPortInputStream getInputStream(int bufferSize) {
 		return new SerialPortInputStream(this, bufferSize);
 	}
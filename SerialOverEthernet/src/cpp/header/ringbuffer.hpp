@@ -1,6 +1,10 @@
 /*
  * ringbuffer.hpp
  *
+ * Single producer, single consumer ring buffer.
+ * One thread may push data while another one reads it, without any further synchronization.
+ * On linux the buffer memory is mapped twice back to back, so data and free space are always one contiguous span.
+ *
  *  Created on: 26.08.2025
  *      Author: marvi
  */
@@ -8,24 +12,85 @@
 #ifndef SRC_CPP_HEADER_RINGBUFFER_HPP_
 #define SRC_CPP_HEADER_RINGBUFFER_HPP_
 
+#include <atomic>
+
+#define RINGBUFFER_CACHE_LINE 64
+
 class Ringbuffer {
 
 private:
 	unsigned long int size;
 	char* buffer;
-	unsigned long int writeIndex;
-	unsigned long int readIndex;
-	unsigned long int bufferEndIndex;
+	bool mirrored;																	// if the memory is mapped a second time behind the buffer end
+	alignas(RINGBUFFER_CACHE_LINE) std::atomic<unsigned long long int> writeIndex;	// total bytes written, only modified by the producer
+	alignas(RINGBUFFER_CACHE_LINE) std::atomic<unsigned long long int> readIndex;	// total bytes read, only modified by the consumer
 
 public:
 	Ringbuffer(unsigned long int size);
 	~Ringbuffer();
 
-	unsigned long int free();
+	/**
+	 * Returns the capacity of the buffer, which might be larger than requested.
+	 */
+	unsigned long int capacity() const;
+
+	// producer side
+
+	/**
+	 * Returns the total free capacity of the buffer.
+	 */
+	unsigned long int free() const;
+	/**
+	 * Copies as much of the data as fits into the buffer.
+	 * @return The number of bytes copied
+	 */
 	unsigned long int push(const char* data, unsigned long int length);
+	/**
+	 * Returns the start of the contiguous free space, which can be written directly and is then committed with pushWrite().
+	 */
+	char* writeStart();
+	/**
+	 * Returns the length of the contiguous free space at writeStart().
+	 */
+	unsigned long int writeAvailable() const;
+	/**
+	 * Makes data written to writeStart() available to the consumer.
+	 */
+	void pushWrite(unsigned long int length);
+
+	// consumer side
+
+	/**
+	 * Returns the total amount of data in the buffer.
+	 */
+	unsigned long int dataBuffered() const;
+	/**
+	 * Returns the length of the contiguous data at dataStart().
+	 */
 	unsigned long int dataAvailable() const;
+	/**
+	 * Returns the start of the contiguous data, which is released with pushRead().
+	 */
 	const char* dataStart() const;
+	/**
+	 * Releases data read from dataStart().
+	 */
 	void pushRead(unsigned long int length);
+	/**
+	 * Searches the buffered data for an byte value.
+	 * @param value The byte to search for
+	 * @param offset The position relative to dataStart() to start the search at
+	 * @return The position of the first match relative to dataStart(), or -1 if there is none
+	 */
+	long long int find(char value, unsigned long int offset) const;
+	/**
+	 * Copies buffered data without releasing it.
+	 * @param buffer The buffer to copy to
+	 * @param length The max number of bytes to copy
+	 * @param offset The position relative to dataStart() to start copying at
+	 * @return The number of bytes copied
+	 */
+	unsigned long int peek(char* buffer, unsigned long int length, unsigned long int offset) const;
 
 };
 
@@ -13,52 +13,306 @@
 #include <netsocket.hpp>
 #include <serial_port.hpp>
 #include <thread>
+#include <vector>
 #include <map>
 #include <shared_mutex>
 #include <string>
 #include <condition_variable>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include "ringbuffer.hpp"
+#include "soelatency.hpp"
 
 namespace SerialOverEthernet {
 
+class SOEReactor;
+
 #define SOE_TCP_DEFAULT_SOE_PORT 26U											// default server port
-#define SOE_TCP_FRAME_MAX_LEN 256UL												// max package length
+#define SOE_TCP_FRAME_MAX_LEN 65536UL											// max package length supported, the actual limit is negotiated per link
+#define SOE_TCP_FRAME_DEFAULT_LEN 256UL											// max package length used until negotiated, supported by all implementations
 #define SOE_TCP_FRAME_LEN_BYTES 3												// length of package length field
 #define SOE_TCP_PROTO_IDENT_LEN 4												// length of package identifier
 #define SOE_TCP_PROTO_IDENT 0x534F4950U											// package identifier
+#define SOE_TCP_PROTO_IDENT_CHANNEL 0x534F4943U									// package identifier of frames with an channel number behind the length
+#define SOE_TCP_PROTO_VERSION 5													// protocol version announced with the frame limit, 2 added channels, 3 added timestamps, 4 added session resume, 5 added request ids
 #define SOE_TCP_HANDSHAKE_TIMEOUT 4000UL										// timeout for handshake operations and initial connection
 #define SOE_TCP_HEADER_LEN (SOE_TCP_PROTO_IDENT_LEN + SOE_TCP_FRAME_LEN_BYTES)	// length of the package header
-#define SOE_SERIAL_BUFFER_LEN (SOE_TCP_FRAME_MAX_LEN - SOE_TCP_HEADER_LEN) - 1	// max length of received serial data for one package
-#define SOE_TCP_STREAM_BUFFER_LEN 512UL											// ring buffer capacity for received data to transmit over serial
-#define SOE_TX_HALT_CYCLE_LIMIT 10
+#define SOE_TCP_CHANNEL_HEADER_LEN (SOE_TCP_HEADER_LEN + 1)						// length of the package header with channel number
+#define SOE_TCP_MAX_CHANNELS 256U												// number of channels one connection can carry
+#define SOE_SERIAL_FRAME_HEADROOM (SOE_TCP_CHANNEL_HEADER_LEN + 1)				// space reserved in front of serial data for frame header and opcode
+#define SOE_TCP_STREAM_BUFFER_LEN 512UL											// default ring buffer capacity for received data to transmit over serial, small to keep the latency low
+#define SOE_GCODE_OFF 0															// serial data is passed trough unchanged
+#define SOE_GCODE_OK_COUNTING 1													// lines are written while less than the window wait for an "ok" (Marlin, RepRap)
+#define SOE_GCODE_CHAR_COUNTING 2												// lines are written while they fit into the receive buffer of the device (GRBL)
+#define SOE_GCODE_DEFAULT_LINES 4U												// default window for ok counting, the command buffer of Marlin
+#define SOE_GCODE_DEFAULT_BYTES 128U											// default window for character counting, the receive buffer of GRBL
+#define SOE_GCODE_DEFAULT_QUEUE 32U												// default number of lines acknowledged to the remote ahead of the device
+#define SOE_GCODE_HOLD_LEN 2													// max device response bytes held back while they could still be an "ok"
+#define SOE_RESUME_BUFFER_LEN (SOE_TCP_FRAME_MAX_LEN * 4)						// capacity for transmitted serial data not yet acknowledged by the remote
+#define SOE_RESUME_ACK_LEN (SOE_RESUME_BUFFER_LEN / 8)							// received serial data after which an acknowledgement is sent
+#define SOE_RESUME_READ_SPACE (SOE_TCP_FRAME_MAX_LEN * 2)						// free resume buffer required to read more serial data, the rest is left for G-code acknowledgements
+#define SOE_RESUME_TIMEOUT 60000UL												// default time in ms an link waits for its lost connection to be resumed
+#define SOE_RESUME_BACKOFF_MIN 250UL											// delay in ms before the first reconnect attempt is repeated
+#define SOE_RESUME_BACKOFF_MAX 8000UL											// max delay in ms between reconnect attempts
+#define SOE_TRANSPORT_TCP 0														// connections use an TCP socket
+#define SOE_TRANSPORT_UDP 1														// connections use an reliable stream over UDP, see soedatagram.hpp
+
+typedef struct SOELinkOptions {
+	unsigned long batchTime;	// max time in microseconds serial data is coalesced into one frame while it keeps arriving, zero disables batching
+	unsigned int batchBytes;	// amount of serial data after which an frame is sent without further coalescing, zero for the max frame length
+	unsigned long bufferSize;	// capacity of the buffer for network data waiting to be written to serial
+	unsigned int highWatermark;	// buffer fill level in percent above which the remote is requested to stop transmitting
+	unsigned int lowWatermark;	// buffer fill level in percent at or below which the remote is allowed to transmit again
+	unsigned int gcodeMode;		// G-code pipelining on serial ports, one of SOE_GCODE_*
+	unsigned int gcodeWindow;	// lines (ok counting) or bytes (character counting) the device can buffer, zero for the default of the mode
+	unsigned int gcodeQueue;	// max lines acknowledged to the remote but not yet to the device
+	unsigned int transport;		// network transport of the connections, one of SOE_TRANSPORT_*, has to match on both ends
+	bool latency;				// measure the latencies of the links, see soelatency.hpp
+	std::string latencyFile;	// file the latency histograms are written to periodically, empty for none
+	unsigned long latencyInterval; // interval in ms in which the latency histograms are written to the file
+	std::string statsPort;		// local port the link statistics are served on over HTTP, empty for none
+	unsigned long resumeTimeout; // time in ms an link waits for its lost connection to be resumed, zero disables resuming
+} SOELinkOptions;
+
+static const SOELinkOptions DEFAULT_LINK_OPTIONS = {
+	.batchTime = 0,
+	.batchBytes = 0,
+	.bufferSize = SOE_TCP_STREAM_BUFFER_LEN,
+	.highWatermark = 75,
+	.lowWatermark = 25,
+	.gcodeMode = SOE_GCODE_OFF,
+	.gcodeWindow = 0,
+	.gcodeQueue = SOE_GCODE_DEFAULT_QUEUE,
+	.transport = SOE_TRANSPORT_TCP,
+	.latency = false,
+	.latencyFile = "",
+	.latencyInterval = SOE_LATENCY_REPORT_INTERVAL,
+	.statsPort = "",
+	.resumeTimeout = SOE_RESUME_TIMEOUT
+};
 
-class SOELinkHandler {
+class SOELinkHandler;
+
+class SOEConnection : public std::enable_shared_from_this<SOEConnection> {
 
 public:
 
 	/**
-	 * Creates a new client network connection handler
+	 * Creates a new network connection, which carries the links of one or more serial ports as channels.
+	 * Channel zero uses the original frame format, so that single links remain compatible to older implementations.
 	 * @param socket The socket of the client-server connection
 	 * @param hostName The name of the remote host
 	 * @param hostPort The port of the remote host
-	 * @param onDeath A callback invoked when the connection was closed
+	 * @param bufferSize The capacity of the stream buffers of the links, limits the frame length accepted from the remote
+	 * @param onNewChannel A callback invoked when the remote uses an channel without link, returns the new link or nullptr, empty on client connections
+	 * @param onResumeChannel A callback invoked when the remote resumes an session on an channel, with the session and the serial data the remote received, returns true if the link was resumed, empty on client connections
+	 */
+	SOEConnection(NetSocket::Socket* socket, const std::string& hostName, const std::string& hostPort, unsigned long bufferSize, std::function<SOELinkHandler*(std::shared_ptr<SOEConnection>, unsigned char)> onNewChannel, std::function<bool(std::shared_ptr<SOEConnection>, unsigned char, unsigned long long, unsigned long long)> onResumeChannel);
+	/**
+	 * Closes the socket and waits for the reception thread to terminate
+	 */
+	~SOEConnection();
+
+	/**
+	 * Drops the references to connections which were taken by reception threads, see deferRelease().
+	 * Has to be called regularly by the thread owning the connections, so that an connection is never destroyed by its own reception thread.
+	 */
+	static void releaseDeferred();
+
+	/**
+	 * Has to be called once after construction to start the reception thread
+	 */
+	void start();
+	/**
+	 * Closes the socket, which terminates all links carried by this connection.
+	 */
+	void shutdown();
+	bool isAlive();
+
+	/**
+	 * Reserves an unused channel for an new link.
+	 * @return The channel number, or -1 if the remote does not support additional channels or all are in use
+	 */
+	int allocateChannel();
+	/**
+	 * Registers an link to receive the packages of its channel.
+	 * @param channel The channel of the link
+	 * @param handler The link
+	 */
+	void attach(unsigned char channel, SOELinkHandler* handler);
+	/**
+	 * Unregisters the link, blocks until no package is delivered to it anymore.
+	 * @param channel The channel of the link
+	 * @param handler The link to remove
+	 */
+	void detach(unsigned char channel, SOELinkHandler* handler);
+	/**
+	 * Called by an link when it shuts down, informs the remote end of the channel.
+	 * The socket is closed if this was the last open channel or the remote does not support channels.
+	 * @param channel The channel of the link
+	 */
+	void releaseChannel(unsigned char channel);
+
+	/**
+	 * Announces the local frame limit to the remote, unless this already happened.
+	 * @return false if the transmission failed, true otherwise
+	 */
+	bool negotiateFrameLimit();
+	/**
+	 * Announces the local frame limit and waits for the answer of the remote, which announces its protocol version.
+	 * Older implementations answer with an error, which ends the wait as well.
+	 * @return true if the remote answered, false otherwise
+	 */
+	bool awaitFrameLimit();
+	/**
+	 * Transmits an package which is already located in an frame buffer, the header is written in place.
+	 * @param frame The frame buffer, with SOE_TCP_CHANNEL_HEADER_LEN bytes reserved in front of the package
+	 * @param packageLen The length of the package behind the reserved header
+	 * @param channel The channel of the package
+	 * @param sends Optional counter, incremented by the number of socket send calls issued for the frame
+	 * @return true if the frame was transmitted successfully, false otherwise
+	 */
+	bool transmitFrame(char* frame, unsigned int packageLen, unsigned char channel, unsigned int* sends = nullptr);
+	/**
+	 * Returns the max frame length accepted by the remote
+	 */
+	unsigned int frameLimit();
+	/**
+	 * Returns true if the remote announced support for timestamp packages
+	 */
+	bool supportsTimestamps();
+	/**
+	 * Returns true if the remote announced support for resumable sessions
+	 */
+	bool supportsResume();
+	/**
+	 * Returns true if the remote announced support for request ids, which are then added to all requests and confirms
+	 */
+	bool supportsRequestIds();
+
+	const std::string& getHostName();
+	const std::string& getHostPort();
+
+private:
+
+	/**
+	 * Runs in the reception thread, delivers the packages to the links of their channels
+	 */
+	void doNetworkReception();
+	/**
+	 * Handles packages which concern the connection, the others are delivered to the link of the channel.
+	 */
+	bool processPackage(unsigned char channel, const char* package, unsigned int packageLen);
+	/**
+	 * Delivers an package to the link of its channel.
+	 * @param openChannel If true and the channel has no operational link, an new one is requested trough the callback
+	 * @return false if the connection should be shut down, true otherwise
+	 */
+	bool deliverPackage(unsigned char channel, const char* package, unsigned int packageLen, bool openChannel);
+
+	bool sendFrameLimit();
+	bool processFrameLimit(const char* package, unsigned int packageLen);
+
+	bool sendCloseChannel(unsigned char channel);
+	bool processCloseChannel(unsigned char channel);
+
+	/**
+	 * Handles the request of the remote to resume an session on an channel.
 	 */
-	SOELinkHandler(NetSocket::Socket* socket, std::string& hostName, std::string& hostPort, std::function<void(SOELinkHandler*)> onDeath);
+	bool processResume(unsigned char channel, const char* package, unsigned int packageLen);
+
+	/**
+	 * Returns the max frame length the remote may send, limited so that multiple frames fit into the stream buffer.
+	 * @return The max frame length accepted from the remote
+	 */
+	unsigned int localFrameLimit();
+
+	/**
+	 * Keeps an reference taken by the reception thread until releaseDeferred() is called.
+	 * The other owners might drop theirs meanwhile, the reception thread would then destroy the connection it is still running on.
+	 */
+	static void deferRelease(std::shared_ptr<SOEConnection> connection);
+
+	static std::mutex m_deferredReleases;								// protects deferredReleases
+	static std::vector<std::shared_ptr<SOEConnection>> deferredReleases;	// references taken by reception threads, dropped by releaseDeferred()
+
+	std::unique_ptr<NetSocket::Socket> socket;							// network TCP socket
+	std::string remoteHostName;											// the host name this connection was established with
+	std::string remoteHostPort;											// the host port this connection was established with
+	unsigned long bufferSize;											// capacity of the stream buffers of the links
+	std::function<SOELinkHandler*(std::shared_ptr<SOEConnection>, unsigned char)> onNewChannel; // callback to create links for new channels
+	std::function<bool(std::shared_ptr<SOEConnection>, unsigned char, unsigned long long, unsigned long long)> onResumeChannel; // callback to resume links on new channels
+	std::thread thread_rx;												// TCP reception thread
+
+	std::mutex m_socketTX;												// protect against async writes to network
+	unsigned long long txFrames = 0;									// number of frames transmitted, protected by m_socketTX
+	unsigned long long txSends = 0;										// number of socket send calls issued for frames, protected by m_socketTX
+	std::atomic<unsigned int> txFrameLimit {SOE_TCP_FRAME_DEFAULT_LEN};	// max frame length accepted by the remote, negotiated when the link opens
+	std::atomic<bool> frameLimitSent {false};							// if the local frame limit was announced to the remote
+	std::atomic<bool> remoteChannels {false};							// if the remote announced support for channels
+	std::atomic<bool> remoteTimestamps {false};							// if the remote announced support for timestamp packages
+	std::atomic<bool> remoteResume {false};								// if the remote announced support for resumable sessions
+	std::atomic<bool> remoteRequestIds {false};							// if the remote announced support for request ids
+	std::mutex m_remoteAnswer;											// protect the answer flag
+	std::condition_variable cv_remoteAnswer;							// waiting point for the answer to the frame limit
+	bool remoteAnswered = false;										// set when the first package of the remote was received
+
+	std::mutex m_channels;												// protect the channel list, held while packages are delivered
+	std::map<unsigned char, SOELinkHandler*> channels;					// links by channel, nullptr for reserved channels
+	std::mutex m_openChannels;											// protect the open channel list
+	std::vector<unsigned char> openChannels;							// channels of links which did not shut down yet
+
+};
+
+typedef struct SOELinkStats {
+	std::atomic<unsigned long long> txSerialBytes {0};			// serial data bytes transmitted to the remote
+	std::atomic<unsigned long long> txSerialFrames {0};			// serial data frames transmitted to the remote
+	std::atomic<unsigned long long> rxSerialBytes {0};			// serial data bytes received from the remote
+	std::atomic<unsigned long long> rxSerialFrames {0};			// serial data frames received from the remote
+	std::atomic<unsigned long long> txFrames {0};				// frames of any kind transmitted to the remote
+	std::atomic<unsigned long long> txSends {0};				// socket send calls issued for the transmitted frames
+	std::atomic<unsigned long long> flowControlToggles {0};		// flow control signals sent to the remote
+	std::atomic<unsigned long long> bufferHighWater {0};		// highest fill level of the stream buffer in bytes
+	std::atomic<unsigned long long> serialErrors {0};			// failed serial port operations and stream buffer overflows
+	std::atomic<unsigned long long> resumes {0};				// times the link was resumed on an new connection
+} SOELinkStats;
+
+class SOELinkHandler {
+
+public:
+
+	/**
+	 * Creates a new link, carried as one channel of an network connection
+	 * @param connection The network connection to the remote
+	 * @param channel The channel of this link on the connection
+	 * @param onDeath A callback invoked when the link was closed
+	 */
+	SOELinkHandler(std::shared_ptr<SOEConnection> connection, unsigned char channel, std::function<void(SOELinkHandler*)> onDeath);
 	/**
-	 * Closes all ports and the socket and cleans all allocated buffer memory
+	 * Closes all ports and cleans all allocated buffer memory
 	 */
 	virtual ~SOELinkHandler();
 
 	/**
 	 * Has to be called once after construction to start the handler
+	 * @param reactor The reactor to service the serial port with, or nullptr to start an dedicated serial thread for this link
 	 */
-	void start();
+	void start(SOEReactor* reactor = nullptr);
 	/**
 	 * Has to be called once before destruction to stop the handler
 	 */
 	void stop();
 
+	/**
+	 * Sets the tuning options of this link, has to be called before start().
+	 * Changing the buffer size replaces the stream buffer.
+	 * @param options The options to apply
+	 */
+	void setOptions(const SOELinkOptions& options);
+
 	/**
 	 * Attempts to open the local serial port.
 	 * @param localSerial The serial port file name
@@ -72,6 +326,38 @@ public:
 	 */
 	bool openRemotePort(const std::string& remoteSerial);
 
+	/**
+	 * Transmits the request to open the remote serial port, without waiting for the response.
+	 * Multiple requests can be in flight, the result is collected with awaitRequest().
+	 * @param remoteSerial The serial port file name
+	 * @return The id of the request, or -1 if the transmission failed
+	 */
+	int requestRemoteOpen(const std::string& remoteSerial);
+	/**
+	 * Transmits the serial port configuration for the remote port, without waiting for the response.
+	 * @param remoteConfig The serial port configuration
+	 * @param awaited If false, the result is discarded instead of being collected with awaitRequest()
+	 * @return The id of the request, or -1 if the transmission failed
+	 */
+	int requestRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig, bool awaited = true);
+	/**
+	 * Transmits the request to start an resumable session, if enabled and supported by both ends.
+	 * Has to be called by the client while the link is set up, the result is applied with awaitSession().
+	 * @return The id of the request, or -1 if no session was requested
+	 */
+	int requestSession();
+	/**
+	 * Waits for the response to an request.
+	 * @param request The id of the request, -1 for an request which could not be transmitted
+	 * @return 1 if the remote confirmed the request, 0 if it failed, -1 if the response timed out
+	 */
+	int awaitRequest(int request);
+	/**
+	 * Waits for the response to the session request, the link ends with the connection if the remote does not accept the session.
+	 * @param request The id of the session request, -1 if none was transmitted
+	 */
+	void awaitSession(int request);
+
 	/**
 	 * Attempts to apply the serial port configuration to the remote port
 	 * @param remoteConfig The serial port configuration
@@ -87,7 +373,7 @@ public:
 	bool setRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig);
 
 	/**
-	 * Closes this connection, releasing both the local and the remote serial port.
+	 * Closes this link, releasing both the local and the remote serial port.
 	 * This function blocks until everything is closed.
 	 * If an shutdown was already issued and the function is called a second time, it returns immediately.
 	 * @return false if the method was already called before and this call did not have any effect, true if this was the first call and the shutdown was performed
@@ -107,41 +393,150 @@ public:
 	virtual bool closeLocalPort() = 0;
 
 	/**
-	 * Returns true if the network connection is still operational
-	 * @return true as long as the network socket is still open
+	 * Returns true if the link is still operational
+	 * @return true as long as the link was not shut down and the network socket is still open
 	 */
 	bool isAlive();
 
-protected:
+	/**
+	 * Sets the callback which establishes an new connection and resumes the link on it, after the connection was lost.
+	 * Without callback (on the server), the link waits for the remote to resume it.
+	 * @param reconnect The callback, returns true if the link was resumed
+	 */
+	void setReconnect(std::function<bool(SOELinkHandler*)> reconnect);
+	/**
+	 * Called by an connection when it was lost, if it still carries this link.
+	 * Resumable links wait for the session to be resumed until the timeout expires, others are shut down.
+	 * @param lostConnection The connection which was lost
+	 */
+	void connectionLost(SOEConnection* lostConnection);
+	/**
+	 * Resumes the session on an new connection, requested by this end.
+	 * @param connection The new connection
+	 * @param channel The channel allocated for the link on the new connection
+	 * @return true if the remote resumed the session, false otherwise
+	 */
+	bool resumeSession(std::shared_ptr<SOEConnection> connection, unsigned char channel);
+	/**
+	 * Resumes the session on an new connection, requested by the remote.
+	 * @param connection The new connection
+	 * @param channel The channel of the link on the new connection
+	 * @param remoteReceived The serial data bytes the remote received on this link
+	 * @return true if the session was resumed, false otherwise
+	 */
+	bool acceptSession(std::shared_ptr<SOEConnection> connection, unsigned char channel, unsigned long long remoteReceived);
+	/**
+	 * Returns the id of the resumable session, or zero if the link can not be resumed
+	 */
+	unsigned long long getSession();
 
 	/**
-	 * Handles network package reception
+	 * Prints the latency histograms of this link, if latency measurement is enabled.
+	 * @param output The file to print to
 	 */
-	void doNetworkReception();
+	void printLatency(FILE* output);
+
+	/**
+	 * Returns the counters of this link, which can be read at any time from any thread.
+	 */
+	const SOELinkStats& getStats();
+	/**
+	 * Returns the stream buffer for network data waiting to be written to serial, for statistics.
+	 */
+	const Ringbuffer& getStreamBuffer();
+	/**
+	 * Returns the connection currently carrying this link, which changes when the link is resumed.
+	 * @param channel Optional, set to the channel of the link on the connection
+	 */
+	std::shared_ptr<SOEConnection> getConnection(unsigned char* channel = nullptr);
+	unsigned char getChannel();
+	const std::string& getLocalPortName();
+	const std::string& getRemotePortName();
+
+protected:
+
 	/**
 	 * Handles serial data reception
 	 */
 	virtual void doSerialReception() {};
+	/**
+	 * Handles pending serial events without blocking, called by the reactor when the local port signals an event.
+	 * @return false if the link should be shut down, true otherwise
+	 */
+	virtual bool serviceSerialReception() { return false; };
 
+	/**
+	 * Handles an package received on the channel of this link, called by the reception thread of the connection
+	 * @return false if the connection should be shut down, true otherwise
+	 */
 	bool processPackage(const char* package, unsigned int packageLen);
 	bool transmitPackage(const char* package, unsigned int packageLen);
+	/**
+	 * Transmits an package assembled from multiple segments as one frame.
+	 * The frame header and all segments are handed to the socket in a single send call.
+	 * @param segments The payload segments, in transmission order
+	 * @param segmentLens The length of each segment
+	 * @param segmentCount The number of segments
+	 * @return true if the frame was transmitted successfully, false otherwise
+	 */
+	bool transmitPackage(const char* const* segments, const unsigned int* segmentLens, unsigned int segmentCount);
+	/**
+	 * Transmits an package which is already located in an frame buffer, the header is written in place.
+	 * @param frame The frame buffer, with SOE_TCP_CHANNEL_HEADER_LEN bytes reserved in front of the package
+	 * @param packageLen The length of the package behind the reserved header
+	 * @return true if the frame was transmitted successfully, false otherwise
+	 */
+	bool transmitFrame(char* frame, unsigned int packageLen);
+	/**
+	 * Transmits an frame on the specified connection and channel and counts it in the statistics of the link.
+	 * Used instead of the connection directly, so that frames sent while the link is detached are counted too.
+	 */
+	bool transmitFrame(SOEConnection& connection, char* frame, unsigned int packageLen, unsigned char channel);
 
 	bool sendError(const std::string& errorMessage);
 	bool processError(const char* package, unsigned int packageLen);
 
-	bool sendConfirm(bool success);
+	/**
+	 * Registers an request and transmits it, the lock is held in between so that confirms without id can be matched in transmission order.
+	 * @param transmit Transmits the request with the supplied id
+	 * @param awaited If false, the result is discarded instead of being collected with awaitRequest()
+	 * @return The id of the request, or -1 if the transmission failed
+	 */
+	int transmitRequest(const std::function<bool(int)>& transmit, bool awaited = true);
+	/**
+	 * Stores the result of an request and wakes the threads waiting for it.
+	 * @param request The id of the request, or -1 to complete the oldest pending request
+	 * @param result The result of the request
+	 */
+	void completeRequest(int request, bool result);
+	/**
+	 * Fails all pending requests, when the link is shut down or the connection was lost.
+	 */
+	void failRequests();
+
+	bool sendConfirm(bool success, int request);
 	bool processConfirm(const char* package, unsigned int packageLen);
 
-	bool sendRemoteOpen(const std::string& remoteSerial);
+	bool sendRemoteOpen(const std::string& remoteSerial, int request);
 	bool processRemoteOpen(const char* package, unsigned int packageLen);
 
-	bool sendRemoteClose();
+	bool sendRemoteClose(int request);
 	bool processRemoteClose(const char* package, unsigned int packageLen);
 
-	bool sendRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig);
+	bool sendRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig, int request);
 	bool processRemoteConfig(const char* package, unsigned int packageLen);
 
-	bool sendSerialData(const char* data, unsigned int len);
+	/**
+	 * Transmits serial data which was read into an frame buffer, without copying it.
+	 * @param frame The frame buffer, with the data located at SOE_SERIAL_FRAME_HEADROOM
+	 * @param len The length of the serial data
+	 */
+	bool sendSerialData(char* frame, unsigned int len);
+	/**
+	 * Returns true if the link is currently busy transmitting serial data, meaning the last serial frame was sent within the batching time.
+	 * @return true if serial data should be coalesced, false if it should be sent immediately
+	 */
+	bool isSerialBatching();
 	bool processSerialData(const char* package, unsigned int packageLen);
 
 	bool sendPortState(bool dtrState, bool rtsState);
@@ -150,32 +545,120 @@ protected:
 	bool sendFlowControl(bool readyState);
 	bool processFlowControl(const char* package, unsigned int packageLen);
 
+	/**
+	 * Transmits the current time to the remote, which echoes it back to measure the round trip time.
+	 * Does nothing if the last timestamp was sent less than SOE_LATENCY_PROBE_INTERVAL ago, or the remote does not support it.
+	 */
+	bool sendTimestamp();
+	bool processTimestamp(const char* package, unsigned int packageLen);
+	bool processTimestampEcho(const char* package, unsigned int packageLen);
+
+	bool sendSession(unsigned long long session, int request);
+	bool processSession(const char* package, unsigned int packageLen);
+
+	/**
+	 * Transmits the resume request, or the response to it.
+	 */
+	bool sendResume();
+	bool processResume(const char* package, unsigned int packageLen);
+
+	bool sendAcknowledge(unsigned long long received);
+	bool processAcknowledge(const char* package, unsigned int packageLen);
+
+	/**
+	 * Waits for the link to be resumed after the connection was lost, runs in its own thread.
+	 * On the client, new connections are attempted with increasing delay.
+	 */
+	void doResume();
+	/**
+	 * Moves the link to an new connection and channel.
+	 */
+	void attachConnection(std::shared_ptr<SOEConnection> connection, unsigned char channel);
+	/**
+	 * Transmits the serial data the remote did not receive again and continues normal operation.
+	 * @param remoteReceived The serial data bytes the remote received on this link
+	 * @return false if the data is no longer available or could not be transmitted, true otherwise
+	 */
+	bool replaySession(unsigned long long remoteReceived);
+	/**
+	 * Releases the data acknowledged by the remote from the resume buffer, m_replay has to be held.
+	 */
+	void trimReplayData();
+	/**
+	 * Returns true if more serial data can be read and transmitted, which requires the remote flow control and an connection.
+	 * Resumable links also require space to keep the data until the remote acknowledged it.
+	 */
+	bool isSerialReadEnabled();
+	/**
+	 * Wakes the thread servicing the serial port, if it is waiting for events.
+	 */
+	virtual void wakeupSerial() {};
+
+	/**
+	 * Requests the remote to stop or resume transmission according to the stream buffer fill level and the watermarks.
+	 */
+	void updateRemoteFlowControl();
+
+	/**
+	 * Returns the max amount of serial data which can be transmitted in one package to the remote.
+	 * @return The max serial data length for one package
+	 */
+	unsigned int serialFrameLimit();
+
 	virtual void transmitSerialData(const char* data, unsigned int len);
 	virtual void updateFlowControl(bool enableTransmit);
 	virtual void updatePortState(bool dtr, bool rts) = 0;
 
-	std::mutex m_socketTX;												// protect against async writes to network
-	std::unique_ptr<NetSocket::Socket> socket;							// network TCP socket
-	std::string remoteHostName;											// the host name this connection was established with
-	std::string remoteHostPort;											// the host port this connection was established with
-	std::function<void(SOELinkHandler*)> onDeath;						// callback when connection is shut down
+	std::mutex m_connection;											// protect the connection and channel, which change when the link is resumed
+	std::shared_ptr<SOEConnection> connection;							// network connection carrying this link
+	unsigned char channel;												// channel of this link on the connection
+	std::atomic<bool> closed {false};									// set when the link was shut down, the connection might still carry other links
+	SOELinkOptions options = DEFAULT_LINK_OPTIONS;						// tuning options of this link
+	std::unique_ptr<char[]> serialFrame;								// frame buffer serial data is read into, with space reserved for the frame header
+	std::chrono::steady_clock::time_point lastSerialFrame;				// time the last serial frame was transmitted
+	SOELinkStats stats;													// counters of this link, for statistics
+	SOELinkLatency latency;												// latency histograms, only recorded if enabled by the options
+	std::chrono::steady_clock::time_point lastTimestamp;				// time the last timestamp was transmitted
+	std::function<void(SOELinkHandler*)> onDeath;						// callback when the link is shut down
 
-	std::thread thread_rx;												// TCP reception thread
 	std::thread thread_tx;												// TCP transmission thread
-	unsigned int txHaltCycles = 0;										// counter of cycles with no work of the TX thread, halts if limit reached
-	Ringbuffer serialData = Ringbuffer(SOE_TCP_STREAM_BUFFER_LEN);		// intermediate buffer for TCP to serial data
+	SOEReactor* reactor = nullptr;										// reactor servicing the serial port instead of the TX thread
+	std::unique_ptr<Ringbuffer> serialData;								// intermediate buffer for TCP to serial data
 	bool flowEnable = true;												// flow control for TCP transmissions
 	bool remoteFlowEnable = true;										// keeps track of the flow control signal for the remote port
 
-	std::mutex m_remoteReturn;											// protect return value against async writes
-	std::condition_variable cv_remoteReturn;							// waiting point for return value
-	bool remoteReturn = false;											// remote return value set by confirm package
+	std::mutex m_remoteReturn;											// protect the requests against async writes
+	std::condition_variable cv_remoteReturn;							// waiting point for request results
+	std::map<int, int> requests;										// results by request id, -1 while pending, -2 if the result is discarded
+	std::deque<int> requestOrder;										// pending requests in transmission order, matched by confirms without id
+	unsigned short nextRequest = 0;										// id of the next request
+
+	std::atomic<unsigned long long> session {0};						// id of the resumable session, zero if the link can not be resumed
+	std::atomic<bool> detached {false};									// set while the connection was lost and the link waits to be resumed
+	std::atomic<bool> portStateLost {false};							// set after an resume, the serial thread transmits the port state again
+	std::function<bool(SOELinkHandler*)> reconnect;						// callback to resume the link on an new connection, empty on the server
+	std::thread thread_resume;											// resume thread, waits for the link to be resumed
+	std::mutex m_resume;												// protect the resume waiting point
+	std::condition_variable cv_resume;									// waiting point of the resume thread
+	unsigned long long resumeReceived = 0;								// serial data bytes received by the remote, from its resume response, protected by m_remoteReturn
+
+	std::mutex m_replay;												// protect the resume buffer and the transmit position
+	std::unique_ptr<Ringbuffer> replayData;								// transmitted serial data not yet acknowledged by the remote
+	unsigned long long replayStart = 0;									// stream position of the first byte in the resume buffer
+	unsigned long long txSequence = 0;									// serial data bytes transmitted
+	std::atomic<unsigned long long> txAcknowledged {0};					// serial data bytes acknowledged by the remote
+	std::atomic<bool> replayBlocked {false};							// set while serial reads wait for acknowledgements to free the resume buffer
+	std::atomic<unsigned long long> rxSequence {0};						// serial data bytes received
+	unsigned long long rxAcknowledged = 0;								// serial data bytes received and acknowledged to the remote, only accessed by the reception thread
 
 	std::mutex m_localPort;												// protect local serial port against async modification
 	std::condition_variable cv_openLocalPort;							// waiting point for TX thread when port closed
 	std::string localPortName;											// local serial port name currently open
 	std::string remotePortName;											// remote serial port currently open
 
+	friend class SOEReactor;
+	friend class SOEConnection;
+
 };
 
 class SOELinkHandlerCOM : public SOELinkHandler {
@@ -188,20 +671,151 @@ public:
 	bool closeLocalPort() override;
 
 private:
-	std::unique_ptr<SerialAccess::SerialPort> localPort;				// local serial port
+	std::shared_ptr<SerialAccess::SerialPort> localPort;				// local serial port, replaced only under m_localPort with std::atomic_store, read with std::atomic_load without it
+	std::atomic<unsigned int> portLockRequests {0};					// threads waiting to lock the port, the TX thread does not wait for events meanwhile
 
 	void doSerialReception() override;
+	bool serviceSerialReception() override;
+
+	/**
+	 * Locks the local port from an other thread than the TX thread.
+	 * The TX thread keeps the port locked while it waits for events, so it is woken up and does not wait again until the lock was taken.
+	 */
+	std::unique_lock<std::mutex> lockLocalPort();
+
+	/**
+	 * Writes data from the ring buffer to the serial port and handles the flow control signals to the remote.
+	 * @return -1 if the port failed, 0 if no data was written, 1 if data was written
+	 */
+	int writeBufferedData();
+	/**
+	 * Reads data from the serial port and transmits it to the remote, unless the remote disabled the flow.
+	 * While the link is busy, data is coalesced into one frame according to the batching options.
+	 * @param batching If true, the call may block briefly to coalesce data, false when called by the reactor
+	 * @return -2 if the transmission failed, -1 if the port failed, 0 if no data was read, 1 if data was read
+	 */
+	int readSerialData(bool batching);
+	/**
+	 * Collects (and optionally waits for) serial port events and transmits COM state changes to the remote.
+	 * @param wait If true, block until an event occurred
+	 * @return -2 if the transmission failed, -1 if the port failed, 0 otherwise
+	 */
+	int processSerialEvents(bool wait);
+
+	/**
+	 * Resets the G-code pipelining state, called when the local port is opened.
+	 */
+	void resetGCode();
+	/**
+	 * Splits newly buffered network data into lines, acknowledges them to the remote as far as the queue allows
+	 * and admits acknowledged lines to the device as far as its window allows.
+	 * @return false if the acknowledgements could not be transmitted, true otherwise
+	 */
+	bool updateGCodeWindow();
+	/**
+	 * Releases written bytes from the G-code pipelining state.
+	 * @param written The number of bytes written to the serial port
+	 */
+	void gcodeWritten(unsigned long written);
+	/**
+	 * Removes the acknowledgements of the device from its output and releases the acknowledged lines from the window.
+	 * Other output is moved to the output buffer, which may be up to SOE_GCODE_HOLD_LEN bytes in front of the input.
+	 * @param input The data read from the device
+	 * @param inputLen The length of the data read
+	 * @param output The buffer to write the remaining output to
+	 * @return The length of the remaining output
+	 */
+	unsigned int filterGCodeResponses(const char* input, unsigned int inputLen, char* output);
+	/**
+	 * Transmits the pending "ok" acknowledgements to the remote, unless an line of the device is partially transmitted.
+	 * @return false if the transmission failed, true otherwise
+	 */
+	bool sendGCodeAcks();
 
 	void transmitSerialData(const char* data, unsigned int len) override;
 	void updateFlowControl(bool enableTransmit) override;
 	void updatePortState(bool dtr, bool rts) override;
+	void wakeupSerial() override;
+
+	enum GCodeResponseState {
+		GCODE_LINE_START,	// at the start of an device line, which might be an "ok"
+		GCODE_LINE_PASS,	// forwarding the rest of an device line
+		GCODE_OK_STRIP,		// dropping the spaces behind an "ok"
+		GCODE_OK_EOL		// dropping the line end behind an "ok"
+	};
+
+	// G-code pipelining state, only accessed by the thread servicing the serial port
+	std::deque<unsigned long> gcodeLines;								// lengths of the complete lines in the stream buffer not yet admitted to the device
+	std::deque<unsigned long> gcodeInFlight;							// lengths of the lines admitted to the device but not yet acknowledged by it
+	unsigned long gcodeScanned = 0;										// bytes in front of the stream buffer split into complete lines
+	unsigned long gcodeSearched = 0;									// bytes in front of the stream buffer searched for line ends
+	unsigned long gcodeAdmitted = 0;									// bytes in front of the stream buffer admitted to the device
+	unsigned long gcodeInFlightBytes = 0;								// sum of the lengths in gcodeInFlight
+	unsigned int gcodeUnacked = 0;										// lines at the end of gcodeLines not yet acknowledged to the remote
+	unsigned int gcodeUnconfirmed = 0;									// lines acknowledged to the remote but not yet by the device
+	GCodeResponseState gcodeResponseState = GCODE_LINE_START;			// position in the current device line
+	std::string gcodeResponseLine;										// start of the current device line, to detect acknowledgements
 
 };
 
 
 }
 
-#ifdef PLATFORM_WIN
+#ifdef PLATFORM_LIN
+
+namespace SerialOverEthernet {
+
+#define SOE_REACTOR_MAX_EVENTS 64												// max events handled per reactor wakeup
+
+class SOEReactor {
+
+public:
+
+	/**
+	 * Creates a new reactor and starts its event loop threads.
+	 * The reactor services the serial ports of all attached links trough epoll, instead of an dedicated TX thread per link.
+	 * @param threadCount The number of event loop threads
+	 */
+	SOEReactor(unsigned int threadCount);
+	/**
+	 * Stops the event loop threads, all links have to be detached before
+	 */
+	~SOEReactor();
+
+	/**
+	 * Registers the event handle of the links local serial port, replacing any previously registered handle.
+	 * @param handler The link to service if the handle is signaled
+	 * @param eventHandle The event handle of the local serial port
+	 * @return true if the handle was registered, false otherwise
+	 */
+	bool attach(SOELinkHandler* handler, long long int eventHandle);
+	/**
+	 * Unregisters the link, blocks until the link is no longer serviced by an event loop thread.
+	 * @param handler The link to remove
+	 */
+	void detach(SOELinkHandler* handler);
+
+private:
+
+	/**
+	 * Runs in the event loop threads
+	 */
+	void runEventLoop();
+	void rearm(SOELinkHandler* handler, long long int eventHandle);
+
+	int epollHandle;													// epoll set of all attached serial port event handles
+	int stopEventHandle;												// signaled to terminate the event loop threads
+	std::vector<std::thread> threads;									// event loop threads
+	std::mutex m_handlers;												// protect handler lists against async modification
+	std::condition_variable cv_handlers;								// waiting point for detach while an handler is serviced
+	std::map<SOELinkHandler*, long long int> handlers;					// attached handlers and their event handles
+	std::map<SOELinkHandler*, std::thread::id> servicing;				// handlers currently serviced and the servicing thread
+
+};
+
+}
+
+#endif
 
 #include <virtual_serial_port.hpp>
 
@@ -218,17 +832,17 @@ public:
 
 private:
 	std::unique_ptr<SerialAccess::VirtualSerialPort> localPort;	// local serial port
+	std::atomic<bool> txWakeup {false};							// set if new work for the TX thread arrived, checked before it blocks
 
 	void doSerialReception() override;
 
 	void transmitSerialData(const char* data, unsigned int len) override;
 	void updateFlowControl(bool enableTransmit) override;
 	void updatePortState(bool dtr, bool rts) override;
+	void wakeupSerial() override;
 
 };
 
 }
 
-#endif
-
 #endif /* SOE_CONNECTION_HPP_ */
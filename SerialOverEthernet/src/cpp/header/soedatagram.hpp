@@ -0,0 +1,221 @@
+/*
+ * soedatagram.hpp
+ *
+ * Defines the optional datagram transport for Serial Over Ethernet.
+ * It provides an reliable byte stream over UDP, which is used by the connections in place of an TCP socket.
+ * Lost datagrams are detected trough selective acknowledgements and retransmitted after about one round trip,
+ * instead of waiting for the retransmission timeout of TCP.
+ * The receiver advertises the datagrams it is able to buffer, so an slow reader stalls the sender instead of growing the queue.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#ifndef SOE_DATAGRAM_HPP_
+#define SOE_DATAGRAM_HPP_
+
+#include <netsocket.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <deque>
+#include <map>
+
+namespace SerialOverEthernet {
+
+#define SOE_UDP_MAGIC 0x5553U													// datagram identifier
+#define SOE_UDP_HEADER_LEN 29													// length of the datagram header: magic, type, sequence, acknowledgement, selective acknowledgements, receive window
+#define SOE_UDP_SEGMENT_LEN 1200U												// max stream data per datagram, below the usual path MTU so datagrams are not fragmented
+#define SOE_UDP_DATAGRAM_MAX_LEN (SOE_UDP_HEADER_LEN + SOE_UDP_SEGMENT_LEN)	// max length of an datagram
+#define SOE_UDP_WINDOW 64U														// max datagrams in flight and reorder window, limited by the selective acknowledgement bitmap
+#define SOE_UDP_RECEIVE_BUFFER (SOE_UDP_WINDOW * SOE_UDP_SEGMENT_LEN * 4)		// max in order stream data buffered until read, the receive window closes when reached
+#define SOE_UDP_INITIAL_RTO 200													// retransmission timeout in ms until the round trip time was measured
+#define SOE_UDP_MIN_RTO 10														// lower limit of the retransmission timeout in ms
+#define SOE_UDP_MAX_RTO 1000													// upper limit of the retransmission timeout in ms, also for repeated retransmissions
+#define SOE_UDP_PEER_TIMEOUT 10000												// time in ms after which an unacknowledged datagram closes the connection, or an silent remote can be replaced
+#define SOE_UDP_HELLO_INTERVAL 250												// interval in ms in which the connection request is repeated
+
+class SOEDatagramEndpoint;
+
+/**
+ * The reliability state of the stream to one remote address.
+ */
+class SOEDatagramPeer : public std::enable_shared_from_this<SOEDatagramPeer> {
+
+public:
+	SOEDatagramPeer(std::shared_ptr<SOEDatagramEndpoint> endpoint, const NetSocket::INetAddress& address, unsigned long long session);
+	~SOEDatagramPeer();
+
+	/**
+	 * Has to be called once after construction to start the retransmission thread
+	 */
+	void start();
+
+	/**
+	 * Splits the data into datagrams and transmits them, blocks while the window is full.
+	 * @return false if the peer is closed, true otherwise
+	 */
+	bool send(const char* buffer, unsigned int length);
+	/**
+	 * Blocks until the requested amount of in order stream data was received.
+	 * @return false if the peer was closed before, true otherwise
+	 */
+	bool receive(char* buffer, unsigned int length, unsigned int* received);
+
+	/**
+	 * Repeats the connection request until it is confirmed.
+	 * @param timeout The max time to wait in ms
+	 * @return true if the connection was established, false otherwise
+	 */
+	bool establish(unsigned long timeout);
+	void close();
+	bool isOpen();
+	/**
+	 * Checks if nothing was received from the remote for SOE_UDP_PEER_TIMEOUT ms, in which case an new session of the same address may replace it.
+	 * @return true if the peer is closed or timed out, false otherwise
+	 */
+	bool hasTimedOut();
+
+	/**
+	 * Handles an datagram received from the remote address, called by the reception thread of the endpoint
+	 */
+	void processDatagram(unsigned char type, unsigned long long sequence, unsigned long long acknowledged, unsigned long long selective, unsigned int window, const char* payload, unsigned int payloadLen);
+
+	const NetSocket::INetAddress& getAddress();
+	unsigned long long getSession();
+
+private:
+	typedef struct Segment {
+		std::string data;
+		std::chrono::steady_clock::time_point firstSent;
+		std::chrono::steady_clock::time_point lastSent;
+		unsigned int transmissions;
+	} Segment;
+
+	void doRetransmission();
+	void transmitSegment(unsigned long long sequence, Segment& segment);
+	void transmitAcknowledgement();
+	unsigned int receiveWindow();
+	void processAcknowledgement(unsigned long long acknowledged, unsigned long long selective, unsigned int window);
+	void updateRoundTrip(std::chrono::steady_clock::duration sample);
+	void markClosed();
+
+	std::shared_ptr<SOEDatagramEndpoint> endpoint;						// endpoint owning the UDP socket
+	NetSocket::INetAddress address;										// remote address
+	unsigned long long session;											// random session number, to detect restarted remotes
+	std::thread thread_timer;											// retransmission thread
+
+	std::mutex m_state;													// protect the stream state
+	std::condition_variable cv_send;									// waiting point for send while the window is full
+	std::condition_variable cv_receive;									// waiting point for receive while not enough data is available
+	std::condition_variable cv_timer;									// waiting point for the retransmission thread
+	bool established = false;											// if the connection request was confirmed
+	bool closed = false;												// if the stream was closed by either end
+	unsigned long long sendNext = 0;									// sequence number of the next datagram to send
+	unsigned long long sendWindowEnd = SOE_UDP_WINDOW;					// sequence number of the first datagram the remote is not able to buffer
+	std::map<unsigned long long, Segment> unacknowledged;				// datagrams in flight
+	unsigned long long receiveNext = 0;									// sequence number of the next datagram to deliver
+	std::map<unsigned long long, std::string> reorder;					// datagrams received ahead of an missing one
+	std::deque<char> received;											// in order stream data not yet read, limited by the advertised receive window
+	unsigned long long advertisedWindowEnd = SOE_UDP_WINDOW;			// end of the receive window last advertised to the remote
+	std::chrono::steady_clock::time_point lastReceived;					// time of the last datagram from the remote
+	std::chrono::steady_clock::duration smoothedRoundTrip {0};			// smoothed round trip time, zero until measured
+	std::chrono::steady_clock::duration roundTripVariation {0};			// round trip time variation
+	std::chrono::steady_clock::duration retransmissionTimeout {std::chrono::milliseconds(SOE_UDP_INITIAL_RTO)};
+
+};
+
+/**
+ * An UDP socket and its reception thread, which delivers the datagrams to the peers of their source address.
+ * An server endpoint accepts new peers, an client endpoint carries only the one it connected to.
+ */
+class SOEDatagramEndpoint : public std::enable_shared_from_this<SOEDatagramEndpoint> {
+
+public:
+	SOEDatagramEndpoint(bool serverMode);
+	~SOEDatagramEndpoint();
+
+	bool bind(const NetSocket::INetAddress& address);
+	/**
+	 * Has to be called once after bind() to start the reception thread
+	 */
+	void start();
+	void close();
+	bool isOpen();
+
+	/**
+	 * Blocks until an new remote requests an connection.
+	 * @return The new peer, or nullptr if the endpoint was closed
+	 */
+	std::shared_ptr<SOEDatagramPeer> accept();
+	/**
+	 * Creates the peer for the remote address, the connection has to be established trough the peer.
+	 */
+	std::shared_ptr<SOEDatagramPeer> connect(const NetSocket::INetAddress& address);
+	/**
+	 * Called by an peer when it was closed, an client endpoint closes together with its peer.
+	 */
+	void removePeer(SOEDatagramPeer* peer);
+
+	/**
+	 * Assembles and transmits an datagram.
+	 * @return false if the transmission failed, true otherwise
+	 */
+	bool transmit(const NetSocket::INetAddress& address, unsigned char type, unsigned long long sequence, unsigned long long acknowledged, unsigned long long selective, unsigned int window, const char* payload, unsigned int payloadLen);
+
+private:
+	void doReception();
+
+	bool serverMode;													// if new remotes are accepted
+	std::unique_ptr<NetSocket::Socket> socket;							// network UDP socket
+	std::atomic<bool> open {false};										// if the endpoint is operational
+	std::thread thread_rx;												// UDP reception thread
+	std::mutex m_socketTX;												// protect against async writes to network
+
+	std::mutex m_peers;													// protect the peer lists
+	std::condition_variable cv_accept;									// waiting point for accept
+	std::map<NetSocket::INetAddress, std::shared_ptr<SOEDatagramPeer>> peers; // peers by remote address
+	std::deque<std::shared_ptr<SOEDatagramPeer>> pending;				// new peers not yet accepted
+
+};
+
+/**
+ * Stream socket over an datagram endpoint, which can be used by the connections in place of an TCP socket.
+ * Only the functions required for stream sockets are supported.
+ */
+class SOEDatagramSocket : public NetSocket::Socket {
+
+public:
+	~SOEDatagramSocket() override;
+
+	bool getINet(NetSocket::INetAddress& address) override;
+	bool setNagle(bool enable) override;
+	bool getNagle(bool* enable) override;
+	bool listen(const NetSocket::INetAddress& address) override;
+	bool accept(NetSocket::Socket& socket) override;
+	bool setTimeouts(unsigned long rxTimeout, unsigned long txTimeout) override;
+	bool getTimeouts(unsigned long* rxTimeout, unsigned long* txTimeout) override;
+	bool connect(const NetSocket::INetAddress& address, unsigned long timeout) override;
+	bool send(const char* buffer, unsigned int length) override;
+	bool receive(char* buffer, unsigned int length, unsigned int* received) override;
+	bool bind(const NetSocket::INetAddress& address) override;
+	bool receivefrom(NetSocket::INetAddress& address, char* buffer, unsigned int length, unsigned int* received) override;
+	bool sendto(const NetSocket::INetAddress& address, const char* buffer, unsigned int length) override;
+	void close() override;
+	bool isOpen() override;
+	int type() override;
+	int lastError() override;
+
+private:
+	std::shared_ptr<SOEDatagramEndpoint> endpoint;						// endpoint of an listening or connected socket
+	std::shared_ptr<SOEDatagramPeer> peer;								// peer of an connected socket
+
+};
+
+}
+
+#endif /* SOE_DATAGRAM_HPP_ */
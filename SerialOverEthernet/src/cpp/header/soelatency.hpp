@@ -0,0 +1,102 @@
+/*
+ * soelatency.hpp
+ *
+ * Defines the latency instrumentation of the Serial Over Ethernet links.
+ * The histograms use logarithmic buckets with a fixed amount of memory, recording a value is an few atomic increments without any allocation or locking.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#ifndef SOE_LATENCY_HPP_
+#define SOE_LATENCY_HPP_
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+namespace SerialOverEthernet {
+
+#define SOE_LATENCY_SUB_BITS 3													// sub buckets per power of two as bits, 3 gives an resolution of 12.5%
+#define SOE_LATENCY_SUB_BUCKETS (1U << SOE_LATENCY_SUB_BITS)					// sub buckets per power of two
+#define SOE_LATENCY_BUCKETS ((64 - SOE_LATENCY_SUB_BITS + 1) * SOE_LATENCY_SUB_BUCKETS) // buckets required to cover all 64 bit values
+#define SOE_LATENCY_MARKS 256U													// max network packages in the stream buffer tracked for the serial write latency
+#define SOE_LATENCY_PROBE_INTERVAL 100											// min time in ms between two round trip measurements of an link
+#define SOE_LATENCY_REPORT_INTERVAL 10000UL										// default interval in ms in which the histograms are written to the report file
+
+/**
+ * An histogram of latencies in microseconds, with logarithmic buckets.
+ * Values below SOE_LATENCY_SUB_BUCKETS get their own bucket, larger ones share an bucket with values of the same highest bits.
+ */
+class SOELatencyHistogram {
+
+public:
+	/**
+	 * Records an value, safe to call concurrently to print().
+	 * @param latency The measured latency
+	 */
+	void record(std::chrono::steady_clock::duration latency);
+
+	/**
+	 * Returns the value at or below which the requested fraction of all recorded values are, rounded up to the end of its bucket.
+	 * @param percentile The fraction of values in percent
+	 * @return The value in microseconds, zero if no values were recorded
+	 */
+	unsigned long long valueAt(double percentile) const;
+	/**
+	 * Prints an summary line with count, mean, percentiles and maximum.
+	 * @param output The file to print to
+	 * @param name The name of the measured latency
+	 */
+	void print(FILE* output, const char* name) const;
+
+private:
+	static unsigned int bucketOf(unsigned long long value);
+	static unsigned long long bucketEnd(unsigned int bucket);
+
+	std::atomic<unsigned long long> buckets[SOE_LATENCY_BUCKETS] {};		// number of values per bucket
+	std::atomic<unsigned long long> count {0};								// number of values recorded
+	std::atomic<unsigned long long> sum {0};								// sum of all values recorded, for the mean
+	std::atomic<unsigned long long> max {0};								// largest value recorded
+
+};
+
+/**
+ * The latency measurements of one link.
+ */
+class SOELinkLatency {
+
+public:
+	/**
+	 * Remembers when network data was put into the stream buffer, called by the thread receiving the network data.
+	 * @param len The length of the data
+	 */
+	void dataBuffered(unsigned long len);
+	/**
+	 * Records the time since the written data was buffered, called by the thread writing to the serial port.
+	 * @param len The length of the data written
+	 */
+	void dataWritten(unsigned long len);
+
+	SOELatencyHistogram serialToNetwork;										// serial data read until its frame was transmitted
+	SOELatencyHistogram networkToSerial;										// network data received until written to the serial port
+	SOELatencyHistogram roundTrip;												// timestamp sent until its echo was received
+
+private:
+	typedef struct Mark {
+		unsigned long long end;													// position in the stream behind the package
+		std::chrono::steady_clock::time_point time;								// time the package was received
+	} Mark;
+
+	// single producer single consumer queue of the packages in the stream buffer
+	Mark marks[SOE_LATENCY_MARKS];
+	std::atomic<unsigned int> marksHead {0};									// next mark to fill, written by the network thread
+	std::atomic<unsigned int> marksTail {0};									// next mark to record, written by the serial thread
+	unsigned long long bufferedBytes = 0;										// bytes received, only accessed by the network thread
+	unsigned long long writtenBytes = 0;										// bytes written, only accessed by the serial thread
+
+};
+
+}
+
+#endif /* SOE_LATENCY_HPP_ */
@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <serial_port.hpp>
 #include <netsocket.hpp>
 #include <soeconnection.hpp>
@@ -20,10 +21,12 @@
  * Starts the main process, initializes server and client connections.
  * @param serverHostName The local address string for the host to bind its listen socket to
  * @param serverHostPort The local port string for the host to bind its listen socket to.
+ * @param reactorThreads The number of reactor threads servicing all serial ports, zero for an dedicated thread per link
+ * @param options The tuning options applied to all links
  * @param linkArgs The additional command line arguments for connections to establish on startup.
  * @return exit code of the application, usually zero for normal termination
  */
-int runMain(std::string& serverHostName, std::string& serverHostPort, std::vector<std::string>& linkArgs);
+int runMain(std::string& serverHostName, std::string& serverHostPort, unsigned int reactorThreads, const SerialOverEthernet::SOELinkOptions& options, std::vector<std::string>& linkArgs);
 
 /**
  * Interprets start argument flags for connections to create.
@@ -32,21 +35,69 @@ int runMain(std::string& serverHostName, std::string& serverHostPort, std::vecto
 void interpretFlags(const std::vector<std::string>& args);
 
 /**
- * Creates a new connection handler for the supplied client socket.
- * The newly created manager handles deletion of the dynamically allocated socket.
- * @param unmanagedSocket The dynamically created client socket, must be connected already
+ * Prints the latency histograms of all links.
+ * @param output The file to print to
+ */
+void printLatencyReport(FILE* output);
+/**
+ * Starts the thread which prints the latency histograms on SIGUSR1 (linux only) and writes them periodically to the report file, if one is configured.
+ * Has to be called before any other thread is started.
+ */
+void startLatencyReports();
+/**
+ * Formats the counters of all links in the Prometheus text format.
+ * @return The formatted statistics
+ */
+std::string formatStats();
+/**
+ * Opens the statistics port on the loopback address and starts the thread serving the statistics to HTTP requests.
+ * @return true if the port was opened, false otherwise
+ */
+bool startStatsServer();
+/**
+ * Creates an new unconnected socket of the network transport selected by the options.
+ * @return The dynamically created socket
+ */
+NetSocket::Socket* newTransportSocket();
+/**
+ * Creates a new network connection for the supplied socket, which carries the links to one remote host.
+ * The newly created connection handles deletion of the dynamically allocated socket, it has to be started by the caller.
+ * @param unmanagedSocket The dynamically created socket, must be connected already
  * @param socketHostName The remote host name, used for log entries related to this connection
  * @param socketHostPort The remote host port, used for log entries related to this connection
+ * @param serverMode If true, an connection handler is created for each channel the remote opens
+ * @return The newly created connection
+ */
+std::shared_ptr<SerialOverEthernet::SOEConnection> createNetworkConnection(NetSocket::Socket* unmanagedSocket, std::string socketHostName, std::string socketHostPort, bool serverMode);
+/**
+ * Creates a new connection handler for an channel of the supplied network connection.
+ * @param connection The network connection to carry the link
+ * @param channel The channel of the link on the connection
  * @param virtualMode The virtual port mode, creates an virtual port instead of claiming an existing one
  * @return An pointer to the newly created connection handler, or an nullptr if the creation failed
  */
-SerialOverEthernet::SOELinkHandler* createConnectionHandler(NetSocket::Socket* unmanagedSocket, std::string socketHostName, std::string socketHostPort, bool virtualMode);
+SerialOverEthernet::SOELinkHandler* createConnectionHandler(std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel, bool virtualMode);
 /**
  * Check all currently available connection handler for closed connections, and properly shutdown and delte them.
  */
 void cleanupDeadConnectionHandlers();
 /**
- * Attempts to establish an connection to the specified host and configures the remote ports with the supplied configurations.
+ * Opens and configures the remote and the local port of an newly created connection handler, shuts it down on failure.
+ * @return true if the link was set up successfully, false otherwise
+ */
+bool setupLink(SerialOverEthernet::SOELinkHandler* handler, std::string& remoteSerial, std::string& localSerial, SerialAccess::SerialPortConfiguration& remoteConfig, SerialAccess::SerialPortConfiguration& localConfig);
+/**
+ * Returns an connection to the specified host with an free channel, sharing the connection of earlier links to it if the remote supports channels.
+ * New connections are started, but the frame limit is not negotiated yet.
+ * @param remoteHost The remote server host address to connect to
+ * @param remotePort The remote server host port to connect to
+ * @param channel Set to the channel allocated for the link
+ * @return The connection, or nullptr if the host could not be reached
+ */
+std::shared_ptr<SerialOverEthernet::SOEConnection> connectRemoteHost(std::string& remoteHost, std::string& remotePort, int& channel);
+/**
+ * Attempts to establish an link to the specified host, sharing the connection of earlier links to it if the remote supports channels.
+ * Configures the remote ports with the supplied configurations.
  * @param remoteHost The remote server host address to connect to
  * @param remotePort The remote server host port to connect to
  * @param remoteSerial The remote server serial port path
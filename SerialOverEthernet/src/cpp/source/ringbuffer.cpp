@@ -8,55 +8,170 @@
 #include "ringbuffer.hpp"
 #include <cstring>
 
+#ifdef PLATFORM_LIN
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+static char* mapMirroredBuffer(unsigned long int size)
+{
+	int memfd = memfd_create("ringbuffer", MFD_CLOEXEC);
+	if (memfd == -1) return nullptr;
+	if (ftruncate(memfd, size) == -1) {
+		close(memfd);
+		return nullptr;
+	}
+
+	// reserve address space for both mappings, then map the same pages into both halves
+	char* buffer = (char*) mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		close(memfd);
+		return nullptr;
+	}
+	if (mmap(buffer, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED ||
+		mmap(buffer + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED) {
+		munmap(buffer, size * 2);
+		close(memfd);
+		return nullptr;
+	}
+
+	// the mappings keep the memory alive
+	close(memfd);
+	return buffer;
+}
+
+#endif
+
 Ringbuffer::Ringbuffer(unsigned long int size)
 {
 	this->size = size;
-	this->buffer = new char[size * 2];
-	this->writeIndex = this->readIndex = this->bufferEndIndex = 0;
+	this->buffer = nullptr;
+#ifdef PLATFORM_LIN
+	// mappings have to be page aligned, round the capacity up
+	unsigned long int pageSize = (unsigned long int) sysconf(_SC_PAGESIZE);
+	unsigned long int mirroredSize = (size + pageSize - 1) / pageSize * pageSize;
+	this->buffer = mapMirroredBuffer(mirroredSize);
+	if (this->buffer != nullptr)
+		this->size = mirroredSize;
+#endif
+	this->mirrored = this->buffer != nullptr;
+	if (!this->mirrored)
+		this->buffer = new char[size];
+	this->writeIndex = this->readIndex = 0;
 }
 
 Ringbuffer::~Ringbuffer()
 {
+#ifdef PLATFORM_LIN
+	if (this->mirrored) {
+		munmap(this->buffer, this->size * 2);
+		return;
+	}
+#endif
 	delete[] this->buffer;
 }
 
-unsigned long int Ringbuffer::free()
+unsigned long int Ringbuffer::capacity() const
+{
+	return this->size;
+}
+
+unsigned long int Ringbuffer::free() const
 {
-	return	this->writeIndex < this->readIndex ?
-			(this->readIndex - this->writeIndex) - 1 :
-			this->readIndex + (this->size - this->writeIndex - 1);
+	// the indices only ever increase, so their difference is the amount of buffered data
+	unsigned long long int readIndex = this->readIndex.load(std::memory_order_acquire);
+	unsigned long long int writeIndex = this->writeIndex.load(std::memory_order_relaxed);
+	return this->size - (unsigned long int) (writeIndex - readIndex);
 }
 
 unsigned long int Ringbuffer::push(const char* data, unsigned long int length)
 {
-	unsigned int free = this->free();
+	// copy in up to two parts, the second one if the data wraps around the buffer end, an mirrored buffer needs only one
+	unsigned long int transfered = 0;
+	while (transfered < length) {
+		unsigned long int available = this->writeAvailable();
+		if (available == 0) break;
+		unsigned long int transfer = length - transfered < available ? length - transfered : available;
+		std::memcpy(this->writeStart(), data + transfered, transfer);
+		this->pushWrite(transfer);
+		transfered += transfer;
+	}
+	return transfered;
+}
 
-	unsigned int transfer = free < length ? free : length;
-	std::memcpy(this->buffer + this->writeIndex, data, transfer);
+char* Ringbuffer::writeStart()
+{
+	return this->buffer + this->writeIndex.load(std::memory_order_relaxed) % this->size;
+}
 
-	unsigned long int endOfBuffer = this->writeIndex + transfer;
-	if (endOfBuffer > this->bufferEndIndex) this->bufferEndIndex = endOfBuffer;
-	this->writeIndex = endOfBuffer % this->size;
+unsigned long int Ringbuffer::writeAvailable() const
+{
+	unsigned long int free = this->free();
+	if (this->mirrored) return free;
+	unsigned long int toEnd = this->size - (unsigned long int) (this->writeIndex.load(std::memory_order_relaxed) % this->size);
+	return free < toEnd ? free : toEnd;
+}
 
-	return transfer;
+void Ringbuffer::pushWrite(unsigned long int length)
+{
+	// publish the written data to the consumer
+	this->writeIndex.store(this->writeIndex.load(std::memory_order_relaxed) + length, std::memory_order_release);
 }
 
-const char* Ringbuffer::dataStart() const
+unsigned long int Ringbuffer::dataBuffered() const
 {
-	return this->buffer + this->readIndex;
+	unsigned long long int writeIndex = this->writeIndex.load(std::memory_order_acquire);
+	unsigned long long int readIndex = this->readIndex.load(std::memory_order_relaxed);
+	return (unsigned long int) (writeIndex - readIndex);
 }
 
 unsigned long int Ringbuffer::dataAvailable() const
 {
-	return this->readIndex <= this->writeIndex ?
-			this->writeIndex - this->readIndex :
-			this->bufferEndIndex - this->readIndex;
+	unsigned long int buffered = this->dataBuffered();
+	if (this->mirrored) return buffered;
+	unsigned long int toEnd = this->size - (unsigned long int) (this->readIndex.load(std::memory_order_relaxed) % this->size);
+	return buffered < toEnd ? buffered : toEnd;
+}
+
+const char* Ringbuffer::dataStart() const
+{
+	return this->buffer + this->readIndex.load(std::memory_order_relaxed) % this->size;
 }
 
 void Ringbuffer::pushRead(unsigned long int length)
 {
-	if (this->readIndex + length > this->size) {
-		this->bufferEndIndex = this->writeIndex;
+	// release the space to the producer
+	this->readIndex.store(this->readIndex.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+long long int Ringbuffer::find(char value, unsigned long int offset) const
+{
+	// search in up to two parts, the second one if the data wraps around the buffer end, an mirrored buffer needs only one
+	unsigned long int buffered = this->dataBuffered();
+	unsigned long long int readIndex = this->readIndex.load(std::memory_order_relaxed);
+	while (offset < buffered) {
+		unsigned long int position = (unsigned long int) ((readIndex + offset) % this->size);
+		unsigned long int length = buffered - offset;
+		if (!this->mirrored && length > this->size - position) length = this->size - position;
+		const char* match = (const char*) std::memchr(this->buffer + position, value, length);
+		if (match != nullptr) return offset + (match - (this->buffer + position));
+		offset += length;
+	}
+	return -1;
+}
+
+unsigned long int Ringbuffer::peek(char* buffer, unsigned long int length, unsigned long int offset) const
+{
+	// copy in up to two parts, the second one if the data wraps around the buffer end, an mirrored buffer needs only one
+	unsigned long int buffered = this->dataBuffered();
+	unsigned long long int readIndex = this->readIndex.load(std::memory_order_relaxed);
+	unsigned long int copied = 0;
+	while (copied < length && offset + copied < buffered) {
+		unsigned long int position = (unsigned long int) ((readIndex + offset + copied) % this->size);
+		unsigned long int part = length - copied < buffered - offset - copied ? length - copied : buffered - offset - copied;
+		if (!this->mirrored && part > this->size - position) part = this->size - position;
+		std::memcpy(buffer + copied, this->buffer + position, part);
+		copied += part;
 	}
-	this->readIndex = (this->readIndex + length) % this->size;
+	return copied;
 }
@@ -15,9 +15,20 @@
 #define STRINGIZE(x) #x
 #define ASSTRING(x) STRINGIZE(x)
 
+#include <thread>
 #include "soemain.hpp"
 #include "dbgprintf.h"
 
+typedef struct LinkArgs {
+	std::string remoteHost;
+	std::string remotePort;
+	std::string remoteSerial;
+	std::string localSerial;
+	SerialAccess::SerialPortConfiguration remoteConfig;
+	SerialAccess::SerialPortConfiguration localConfig;
+	bool virtualMode;
+} LinkArgs;
+
 void interpretFlags(const std::vector<std::string>& args) {
 
 	// parse arguments for connections
@@ -29,6 +40,7 @@ void interpretFlags(const std::vector<std::string>& args) {
 	SerialAccess::SerialPortConfiguration localConfig = SerialAccess::DEFAULT_PORT_CONFIGURATION;
 	bool virtualMode = false;
 	bool link = false;
+	std::vector<LinkArgs> links;
 
 	for (auto flag = args.begin(); flag != args.end(); flag++) {
 
@@ -41,7 +53,7 @@ void interpretFlags(const std::vector<std::string>& args) {
 				}
 				link = false;
 
-				linkRemotePort(remoteHost, remotePort, remoteSerial, localSerial, localConfig, remoteConfig, virtualMode);
+				links.push_back({ remoteHost, remotePort, remoteSerial, localSerial, remoteConfig, localConfig, virtualMode });
 				virtualMode = false;
 			}
 		}
@@ -97,6 +109,9 @@ void interpretFlags(const std::vector<std::string>& args) {
 
 		if (*flag == "-virtual") {
 			virtualMode = true;
+		} else if (*flag == "-llowlatency" || *flag == "-rlowlatency" || *flag == "-lowlatency") {
+			if (*flag != "-llowlatency") remoteConfig.lowLatency = true;
+			if (*flag != "-rlowlatency") localConfig.lowLatency = true;
 		} else if (*flag == "-link") {
 			link = true;
 		}
@@ -105,11 +120,20 @@ void interpretFlags(const std::vector<std::string>& args) {
 	if (link) {
 		if (remoteHost.empty() || remotePort.empty() || remoteSerial.empty() || localSerial.empty()) {
 			printf("[!] not enough arguments for connection\n");
-			return;
+		} else {
+			links.push_back({ remoteHost, remotePort, remoteSerial, localSerial, remoteConfig, localConfig, virtualMode });
 		}
+	}
 
-		linkRemotePort(remoteHost, remotePort, remoteSerial, localSerial, remoteConfig, localConfig, virtualMode);
+	// establish all links concurrently, so that the handshake round trips do not add up
+	std::vector<std::thread> linkThreads;
+	for (LinkArgs& linkArgs : links) {
+		linkThreads.emplace_back([&linkArgs]() {
+			linkRemotePort(linkArgs.remoteHost, linkArgs.remotePort, linkArgs.remoteSerial, linkArgs.localSerial, linkArgs.remoteConfig, linkArgs.localConfig, linkArgs.virtualMode);
+		});
 	}
+	for (std::thread& linkThread : linkThreads)
+		linkThread.join();
 }
 
 int mainCPP(std::string& exec, std::vector<std::string>& args) {
@@ -125,17 +149,33 @@ int mainCPP(std::string& exec, std::vector<std::string>& args) {
 		printf("options:\n");
 		printf(" -addr [local IP]\n");
 		printf(" -port [local network port]\n");
+		printf(" -reactor [threads] : service all serial ports from a fixed number of threads (linux only)\n");
+		printf(" -batchus [microseconds] : coalesce serial data of busy links for up to this time into one frame\n");
+		printf(" -batchbytes [bytes] : send the frame without further coalescing after this amount of serial data\n");
+		printf(" -buffer [bytes] : capacity of the buffer for network data waiting to be written to serial, defaults to %lu, fast ports can use up to %lu for frames of a quarter of it\n", SOE_TCP_STREAM_BUFFER_LEN, SOE_TCP_FRAME_MAX_LEN * 4);
+		printf(" -highwater [percent] : buffer level above which the remote stops transmitting, the rest has to hold data in flight\n");
+		printf(" -lowwater [percent] : buffer level at which the remote resumes transmitting\n");
+		printf(" -gcode [mode] : ok|chars, acknowledge G-code lines for the serial ports of this instance and keep the device buffer full\n");
+		printf(" -gcodewindow [lines|bytes] : lines (ok) or bytes (chars) the device can buffer, defaults to %u lines or %u bytes\n", SOE_GCODE_DEFAULT_LINES, SOE_GCODE_DEFAULT_BYTES);
+		printf(" -gcodequeue [lines] : max lines acknowledged ahead of the device\n");
+		printf(" -latency : measure the latencies of all links, print the histograms on SIGUSR1 (linux only)\n");
+		printf(" -latencyfile [file] : measure the latencies of all links and write the histograms periodically to the file\n");
+		printf(" -latencyinterval [milliseconds] : interval in which the histograms are written to the file\n");
+		printf(" -stats [local network port] : serve the counters of all links in Prometheus format over HTTP on the loopback address\n");
+		printf(" -transport [protocol] : tcp|udp, network transport for the server and all links, udp recovers lost data faster\n");
+		printf(" -resumetimeout [milliseconds] : time links wait for an lost connection to be resumed without data loss, 0 disables, defaults to %lu\n", SOE_RESUME_TIMEOUT);
 		printf("link options:\n");
 		printf(" -addr [remote IP]\n");
 		printf(" -port [remote network port]\n");
 		printf(" -rser [remote serial port]\n");
 		printf(" -lser [serial port]\n");
-		printf(" -virtual\n");
+		printf(" -virtual : create a virtual port instead of opening one (linux: -lser is the path of the pty symlink)\n");
 		printf(" -(l|r|)baud [serial baud]\n");
 		printf(" -(l|r|)bits [data bits]\n");
 		printf(" -(l|r|)flowctrl [flow control] : none|rtscts|dsrdtr\n");
 		printf(" -(l|r|)stops [stop bits] : one|one-half|two\n");
 		printf(" -(l|r|)parity [parity] : none|even|odd|mark|space\n");
+		printf(" -(l|r|)lowlatency : reduce the receive latency of USB serial adapters (linux only, might require root)\n");
 		printf(" (l - local only | r - remote only | both)\n");
 		printf("serial over ethernet version: " ASSTRING(BUILD_VERSION) "\n");
 		return 1;
@@ -144,6 +184,8 @@ int mainCPP(std::string& exec, std::vector<std::string>& args) {
 	// default configuration
 	std::string serverHostPort = std::to_string(SOE_TCP_DEFAULT_SOE_PORT);
 	std::string serverHostName = ""; // empty means create no server
+	unsigned int reactorThreads = 0; // zero means an dedicated thread per link
+	SerialOverEthernet::SOELinkOptions linkOptions = SerialOverEthernet::DEFAULT_LINK_OPTIONS;
 
 	// parse arguments for network connection
 	auto flag = args.begin();
@@ -154,17 +196,83 @@ int mainCPP(std::string& exec, std::vector<std::string>& args) {
 				serverHostName = *++flag;
 			} else if (*flag == "-port") {
 				serverHostPort = *++flag;
+			} else if (*flag == "-reactor") {
+				reactorThreads = stoul(*++flag);
+			} else if (*flag == "-batchus") {
+				linkOptions.batchTime = stoul(*++flag);
+			} else if (*flag == "-batchbytes") {
+				linkOptions.batchBytes = stoul(*++flag);
+			} else if (*flag == "-buffer") {
+				linkOptions.bufferSize = stoul(*++flag);
+			} else if (*flag == "-highwater") {
+				linkOptions.highWatermark = stoul(*++flag);
+			} else if (*flag == "-lowwater") {
+				linkOptions.lowWatermark = stoul(*++flag);
+			} else if (*flag == "-gcode") {
+				std::string mode = *++flag;
+				if (mode == "ok") {
+					linkOptions.gcodeMode = SOE_GCODE_OK_COUNTING;
+				} else if (mode == "chars") {
+					linkOptions.gcodeMode = SOE_GCODE_CHAR_COUNTING;
+				} else {
+					printf("[!] invalid G-code mode: %s\n", mode.c_str());
+					return 1;
+				}
+			} else if (*flag == "-gcodewindow") {
+				linkOptions.gcodeWindow = stoul(*++flag);
+			} else if (*flag == "-gcodequeue") {
+				linkOptions.gcodeQueue = stoul(*++flag);
+			} else if (*flag == "-latencyfile") {
+				linkOptions.latency = true;
+				linkOptions.latencyFile = *++flag;
+			} else if (*flag == "-latencyinterval") {
+				linkOptions.latencyInterval = stoul(*++flag);
+			} else if (*flag == "-stats") {
+				linkOptions.statsPort = *++flag;
+			} else if (*flag == "-resumetimeout") {
+				linkOptions.resumeTimeout = stoul(*++flag);
+			} else if (*flag == "-transport") {
+				std::string transport = *++flag;
+				if (transport == "tcp") {
+					linkOptions.transport = SOE_TRANSPORT_TCP;
+				} else if (transport == "udp") {
+					linkOptions.transport = SOE_TRANSPORT_UDP;
+				} else {
+					printf("[!] invalid transport: %s\n", transport.c_str());
+					return 1;
+				}
 			}
 		}
 		// flags without arguments
 		if (*flag == "-link") {
 			break; // end of server arguments
+		} else if (*flag == "-latency") {
+			linkOptions.latency = true;
 		}
 	}
 	if (flag != args.begin())
 		args.erase(args.begin(), flag - 1);
 
-	return runMain(serverHostName, serverHostPort, args);
+	if (linkOptions.lowWatermark >= linkOptions.highWatermark || linkOptions.highWatermark > 100) {
+		printf("[!] invalid watermarks, the low watermark has to be below the high watermark, which can not exceed 100%%\n");
+		return 1;
+	}
+	if (linkOptions.bufferSize < SOE_TCP_FRAME_DEFAULT_LEN * 2) {
+		printf("[!] invalid buffer size, has to hold at least %lu bytes\n", SOE_TCP_FRAME_DEFAULT_LEN * 2);
+		return 1;
+	}
+
+	if (linkOptions.latencyInterval == 0) {
+		printf("[!] invalid latency report interval, has to be at least one millisecond\n");
+		return 1;
+	}
+
+	if (linkOptions.gcodeMode != SOE_GCODE_OFF && linkOptions.gcodeQueue == 0) {
+		printf("[!] invalid G-code queue, has to allow at least one line\n");
+		return 1;
+	}
+
+	return runMain(serverHostName, serverHostPort, reactorThreads, linkOptions, args);
 }
 
 int main(int argc, const char** argv) {
@@ -0,0 +1,314 @@
+/*
+ * soeconnection.cpp
+ *
+ * Handles an single Serial over Ethernet/IP network connection.
+ * The connection owns the socket and the reception thread, the links of the serial ports are carried as channels on it.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#include <string>
+#include <string.h>
+#include <algorithm>
+#include "soeconnection.hpp"
+#include "dbgprintf.h"
+
+std::mutex SerialOverEthernet::SOEConnection::m_deferredReleases;
+std::vector<std::shared_ptr<SerialOverEthernet::SOEConnection>> SerialOverEthernet::SOEConnection::deferredReleases;
+
+SerialOverEthernet::SOEConnection::SOEConnection(NetSocket::Socket* socket, const std::string& hostName, const std::string& hostPort, unsigned long bufferSize, std::function<SOELinkHandler*(std::shared_ptr<SOEConnection>, unsigned char)> onNewChannel, std::function<bool(std::shared_ptr<SOEConnection>, unsigned char, unsigned long long, unsigned long long)> onResumeChannel) {
+	this->remoteHostName = hostName;
+	this->remoteHostPort = hostPort;
+	this->bufferSize = bufferSize;
+	this->onNewChannel = onNewChannel;
+	this->onResumeChannel = onResumeChannel;
+	this->socket.reset(socket);
+	this->socket->setTimeouts(0, 0);
+	this->socket->setNagle(false);
+}
+
+SerialOverEthernet::SOEConnection::~SOEConnection() {
+	shutdown();
+	// the reception thread never releases the last reference, see deferRelease()
+	if (this->thread_rx.joinable()) {
+		dbgprintf("[DBG] joining RX thread ...\n");
+		this->thread_rx.join();
+		dbgprintf("[DBG] joined\n");
+	}
+	dbgprintf("[DBG] transmitted %llu frames with %llu socket sends\n", this->txFrames, this->txSends);
+}
+
+void SerialOverEthernet::SOEConnection::releaseDeferred() {
+	// the references are dropped outside of the lock, the destructors join reception threads which might be waiting for it
+	std::vector<std::shared_ptr<SOEConnection>> released;
+	std::lock_guard<std::mutex> lock(m_deferredReleases);
+	released.swap(deferredReleases);
+}
+
+void SerialOverEthernet::SOEConnection::deferRelease(std::shared_ptr<SOEConnection> connection) {
+	std::lock_guard<std::mutex> lock(m_deferredReleases);
+	deferredReleases.push_back(connection);
+}
+
+void SerialOverEthernet::SOEConnection::start() {
+	this->thread_rx = std::thread([this]() -> void {
+		this->doNetworkReception();
+	});
+}
+
+void SerialOverEthernet::SOEConnection::shutdown() {
+	this->socket->close();
+}
+
+bool SerialOverEthernet::SOEConnection::isAlive() {
+	return this->socket->isOpen();
+}
+
+int SerialOverEthernet::SOEConnection::allocateChannel() {
+	int allocated = -1;
+	{
+		std::lock_guard<std::mutex> lock(this->m_channels);
+
+		// the first link always uses channel zero, additional ones require an remote which supports channels
+		if (!this->channels.empty() && !this->remoteChannels) return -1;
+		for (unsigned int channel = 0; channel < SOE_TCP_MAX_CHANNELS; channel++) {
+			if (this->channels.find((unsigned char) channel) != this->channels.end()) continue;
+			this->channels[(unsigned char) channel] = nullptr;
+			allocated = (int) channel;
+			break;
+		}
+	}
+	if (allocated < 0) return -1;
+
+	// links set up concurrently must not close the connection while this channel is not yet attached
+	std::lock_guard<std::mutex> lock(this->m_openChannels);
+	this->openChannels.push_back((unsigned char) allocated);
+	return allocated;
+}
+
+void SerialOverEthernet::SOEConnection::attach(unsigned char channel, SOELinkHandler* handler) {
+	{
+		std::lock_guard<std::mutex> lock(this->m_channels);
+		this->channels[channel] = handler;
+	}
+	std::lock_guard<std::mutex> lock(this->m_openChannels);
+	if (std::find(this->openChannels.begin(), this->openChannels.end(), channel) == this->openChannels.end())
+		this->openChannels.push_back(channel);
+}
+
+void SerialOverEthernet::SOEConnection::detach(unsigned char channel, SOELinkHandler* handler) {
+	// waits for an package currently delivered to the link, the channel might already be used by an new link
+	std::lock_guard<std::mutex> lock(this->m_channels);
+	auto entry = this->channels.find(channel);
+	if (entry != this->channels.end() && entry->second == handler)
+		this->channels.erase(entry);
+}
+
+void SerialOverEthernet::SOEConnection::releaseChannel(unsigned char channel) {
+	std::lock_guard<std::mutex> lock(this->m_openChannels);
+	this->openChannels.erase(std::remove(this->openChannels.begin(), this->openChannels.end(), channel), this->openChannels.end());
+
+	// older implementations only know one link per connection, which ends with the socket
+	if (this->openChannels.empty() || !this->remoteChannels) {
+		dbgprintf("[DBG] last channel closed, closing connection\n");
+		// an remote which supports resuming would otherwise wait for the link to be resumed
+		if (this->remoteResume && isAlive() && !sendCloseChannel(channel)) {
+			dbgprintf("[DBG] unable to send channel close\n");
+		}
+		shutdown();
+		return;
+	}
+
+	if (isAlive() && !sendCloseChannel(channel)) {
+		dbgprintf("[DBG] unable to send channel close\n");
+	}
+}
+
+bool SerialOverEthernet::SOEConnection::negotiateFrameLimit() {
+	if (this->frameLimitSent.exchange(true)) return true;
+	dbgprintf("[DBG] negotiate max frame length: %lu\n", SOE_TCP_FRAME_MAX_LEN);
+	return sendFrameLimit();
+}
+
+bool SerialOverEthernet::SOEConnection::awaitFrameLimit() {
+	if (!negotiateFrameLimit()) return false;
+	std::unique_lock<std::mutex> lock(this->m_remoteAnswer);
+	return this->cv_remoteAnswer.wait_for(lock, std::chrono::milliseconds(SOE_TCP_HANDSHAKE_TIMEOUT), [this]() {
+		return this->remoteAnswered || !isAlive();
+	}) && this->remoteAnswered;
+}
+
+unsigned int SerialOverEthernet::SOEConnection::frameLimit() {
+	return this->txFrameLimit;
+}
+
+bool SerialOverEthernet::SOEConnection::supportsTimestamps() {
+	return this->remoteTimestamps;
+}
+
+bool SerialOverEthernet::SOEConnection::supportsResume() {
+	return this->remoteResume;
+}
+
+bool SerialOverEthernet::SOEConnection::supportsRequestIds() {
+	return this->remoteRequestIds;
+}
+
+const std::string& SerialOverEthernet::SOEConnection::getHostName() {
+	return this->remoteHostName;
+}
+
+const std::string& SerialOverEthernet::SOEConnection::getHostPort() {
+	return this->remoteHostPort;
+}
+
+void SerialOverEthernet::SOEConnection::doNetworkReception() {
+
+	char packageFrame[SOE_TCP_FRAME_MAX_LEN] {0};
+	unsigned int headerLen = 0;
+
+	while (isAlive()) {
+
+		if (!this->socket->receive(packageFrame, SOE_TCP_HEADER_LEN, &headerLen)) {
+			dbgprintf("[DBG] client socket closed\n");
+			break;
+		}
+
+		// check for header
+		if (headerLen < SOE_TCP_HEADER_LEN) {
+			printf("[!] frame error, receivied incomplete frame header\n");
+			break;
+		}
+
+		// check protocol identifier, frames of additional channels use their own identifier
+		bool identOriginal = true, identChannel = true;
+		for (unsigned char i = 0; i < SOE_TCP_PROTO_IDENT_LEN; i++) {
+			identOriginal &= packageFrame[i] == (char) ((SOE_TCP_PROTO_IDENT >> i * 8) & 0xFF);
+			identChannel &= packageFrame[i] == (char) ((SOE_TCP_PROTO_IDENT_CHANNEL >> i * 8) & 0xFF);
+		}
+		if (!identOriginal && !identChannel) {
+			printf("[!] frame error, received package with unknown identifier: %.*s\n", SOE_TCP_PROTO_IDENT_LEN, packageFrame);
+			break;
+		}
+
+		// read package len
+		unsigned int payloadLen = 0;
+		for (unsigned char i = 0; i < SOE_TCP_FRAME_LEN_BYTES; i++)
+			payloadLen |= (((unsigned char) packageFrame[SOE_TCP_PROTO_IDENT_LEN + i]) << (i * 8));
+
+		// read channel number
+		unsigned char channel = 0;
+		if (identChannel) {
+			unsigned int channelLen = 0;
+			if (!this->socket->receive(packageFrame + headerLen, 1, &channelLen) || channelLen < 1) {
+				printf("[!] frame error, receivied incomplete frame header\n");
+				break;
+			}
+			channel = (unsigned char) packageFrame[headerLen++];
+		}
+
+		if (payloadLen > SOE_TCP_FRAME_MAX_LEN - headerLen) {
+			printf("[!] frame error, received package with oversize payload: %u\n", payloadLen);
+			break;
+		}
+
+		// read remaining payload
+		unsigned int received = 0;
+		while (received < payloadLen && isAlive()) {
+			unsigned int receivedPart = 0;
+			if (!this->socket->receive(packageFrame + headerLen + received, payloadLen - received, &receivedPart)) {
+				printf("[DBG] client socket payload RX returned with error code: %d\n", this->socket->lastError());
+			}
+			received += receivedPart;
+		}
+
+		// attempt to process the package
+		if (!processPackage(channel, packageFrame + headerLen, payloadLen)) {
+			printf("[!] frame error, package response failed\n");
+			break;
+		}
+
+		// the first package is the answer to the frame limit, or an error of an older implementation
+		if (!this->remoteAnswered) {
+			std::lock_guard<std::mutex> lock(this->m_remoteAnswer);
+			this->remoteAnswered = true;
+			this->cv_remoteAnswer.notify_all();
+		}
+
+	}
+
+	dbgprintf("[DBG] client socket RX terminated, shutting down ...\n");
+	shutdown();
+	{
+		std::lock_guard<std::mutex> lock(this->m_remoteAnswer);
+		this->cv_remoteAnswer.notify_all();
+	}
+
+	// terminate all links carried by this connection, or let them wait to be resumed
+	std::lock_guard<std::mutex> lock(this->m_channels);
+	for (auto& entry : this->channels)
+		if (entry.second != nullptr) entry.second->connectionLost(this);
+
+}
+
+bool SerialOverEthernet::SOEConnection::deliverPackage(unsigned char channel, const char* package, unsigned int packageLen, bool openChannel) {
+
+	std::unique_lock<std::mutex> lock(this->m_channels);
+	auto entry = this->channels.find(channel);
+	SOELinkHandler* handler = entry != this->channels.end() ? entry->second : nullptr;
+
+	// the remote opens an new channel, or reuses the one of an closed link
+	if ((handler == nullptr || !handler->isAlive()) && openChannel && this->onNewChannel) {
+		lock.unlock();
+		dbgprintf("[DBG] create link for channel: %u\n", channel);
+		std::shared_ptr<SOEConnection> connection = shared_from_this();
+		handler = this->onNewChannel(connection, channel);
+		deferRelease(connection);
+		lock.lock();
+	}
+
+	// packages still in flight when the link was closed are dropped
+	if (handler == nullptr || !handler->isAlive()) {
+		dbgprintf("[DBG] dropped package for closed channel: %u\n", channel);
+		return true;
+	}
+
+	if (!handler->processPackage(package, packageLen)) {
+		// an failed link does not affect the other channels, unless it is the only one
+		printf("[!] frame error, package response failed on channel: %u\n", channel);
+		handler->shutdown();
+	}
+	return true;
+
+}
+
+bool SerialOverEthernet::SOEConnection::transmitFrame(char* frame, unsigned int packageLen, unsigned char channel, unsigned int* sends) {
+
+	// channel zero uses the original header, so that single links work with older implementations
+	unsigned int headerLen = channel == 0 ? SOE_TCP_HEADER_LEN : SOE_TCP_CHANNEL_HEADER_LEN;
+	unsigned int ident = channel == 0 ? SOE_TCP_PROTO_IDENT : SOE_TCP_PROTO_IDENT_CHANNEL;
+	char* header = frame + SOE_TCP_CHANNEL_HEADER_LEN - headerLen;
+
+	// assemble frame header in front of the package
+	for (unsigned char i = 0; i < SOE_TCP_PROTO_IDENT_LEN; i++)
+		header[i] = (ident >> i * 8) & 0xFF;
+	for (unsigned char i = 0; i < SOE_TCP_FRAME_LEN_BYTES; i++)
+		header[SOE_TCP_PROTO_IDENT_LEN + i] = (packageLen >> i * 8) & 0xFF;
+	if (channel != 0)
+		header[SOE_TCP_HEADER_LEN] = (char) channel;
+
+	// acquire mutex for transmission
+	std::unique_lock<std::mutex> lock(this->m_socketTX);
+
+	// transmit header and payload with one call, so that they end up in the same TCP segment
+	this->txSends++;
+	if (sends != nullptr) (*sends)++;
+	if (!this->socket->send(header, headerLen + packageLen)) {
+		printf("[!] transmission error, unable to transmit frame\n");
+		return false;
+	}
+	this->txFrames++;
+
+	return true;
+}
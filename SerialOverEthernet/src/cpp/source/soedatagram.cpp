@@ -0,0 +1,649 @@
+/*
+ * soedatagram.cpp
+ *
+ * Implements the optional datagram transport.
+ * Every datagram acknowledges the stream received so far, and the 64 datagrams behind it selectively.
+ * An datagram is retransmitted as soon as one sent after it was acknowledged, or when its retransmission timeout expires.
+ * The acknowledgements also carry the receive window, while it is closed the sender probes it in case the update opening it gets lost.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#include <string.h>
+#include <random>
+#include <algorithm>
+#include "soedatagram.hpp"
+#include "soeconnection.hpp"
+#include "dbgprintf.h"
+
+#define SOE_UDP_TYPE_DATA 0x1
+#define SOE_UDP_TYPE_ACK 0x2
+#define SOE_UDP_TYPE_HELLO 0x3
+#define SOE_UDP_TYPE_HELLO_ACK 0x4
+#define SOE_UDP_TYPE_CLOSE 0x5
+#define SOE_UDP_TYPE_PROBE 0x6
+
+static void writeNumber(char* buffer, unsigned long long value) {
+	for (unsigned char i = 0; i < 8; i++)
+		buffer[i] = (value >> i * 8) & 0xFF;
+}
+
+static unsigned long long readNumber(const char* buffer) {
+	unsigned long long value = 0;
+	for (unsigned char i = 0; i < 8; i++)
+		value |= ((unsigned long long) (unsigned char) buffer[i]) << (i * 8);
+	return value;
+}
+
+// SOEDatagramPeer
+
+SerialOverEthernet::SOEDatagramPeer::SOEDatagramPeer(std::shared_ptr<SOEDatagramEndpoint> endpoint, const NetSocket::INetAddress& address, unsigned long long session) {
+	this->endpoint = endpoint;
+	this->address = address;
+	this->session = session;
+	this->lastReceived = std::chrono::steady_clock::now();
+}
+
+SerialOverEthernet::SOEDatagramPeer::~SOEDatagramPeer() {
+	// the retransmission thread holds an reference until it terminates, so it might be the one releasing the peer
+	if (this->thread_timer.joinable() && this->thread_timer.get_id() == std::this_thread::get_id()) {
+		this->thread_timer.detach();
+	} else if (this->thread_timer.joinable()) {
+		this->thread_timer.join();
+	}
+}
+
+void SerialOverEthernet::SOEDatagramPeer::start() {
+	std::shared_ptr<SOEDatagramPeer> self = shared_from_this();
+	this->thread_timer = std::thread([self]() -> void {
+		self->doRetransmission();
+	});
+}
+
+bool SerialOverEthernet::SOEDatagramPeer::send(const char* buffer, unsigned int length) {
+	std::unique_lock<std::mutex> lock(this->m_state);
+
+	while (length > 0) {
+		this->cv_send.wait(lock, [this]() {
+			return this->closed || (this->unacknowledged.size() < SOE_UDP_WINDOW && this->sendNext < this->sendWindowEnd);
+		});
+		if (this->closed) return false;
+
+		// each datagram is transmitted immediately, there is no coalescing of small writes
+		unsigned int segmentLen = std::min(length, SOE_UDP_SEGMENT_LEN);
+		Segment& segment = this->unacknowledged[this->sendNext];
+		segment.data.assign(buffer, segmentLen);
+		segment.firstSent = std::chrono::steady_clock::now();
+		segment.transmissions = 0;
+		transmitSegment(this->sendNext++, segment);
+
+		buffer += segmentLen;
+		length -= segmentLen;
+	}
+
+	// the retransmission thread might be waiting without deadline
+	this->cv_timer.notify_one();
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramPeer::receive(char* buffer, unsigned int length, unsigned int* received) {
+	std::unique_lock<std::mutex> lock(this->m_state);
+
+	// deliver complete requests only, like an blocking stream socket with MSG_WAITALL
+	this->cv_receive.wait(lock, [this, length]() {
+		return this->closed || this->received.size() >= length;
+	});
+	if (this->received.size() < length) {
+		*received = 0;
+		return false;
+	}
+
+	std::copy(this->received.begin(), this->received.begin() + length, buffer);
+	this->received.erase(this->received.begin(), this->received.begin() + length);
+	*received = length;
+
+	// reopen the window of the remote once an noticeable part of it is available again
+	if (this->receiveNext + receiveWindow() >= this->advertisedWindowEnd + SOE_UDP_WINDOW / 4) transmitAcknowledgement();
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramPeer::establish(unsigned long timeout) {
+	std::unique_lock<std::mutex> lock(this->m_state);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	while (!this->established && !this->closed && std::chrono::steady_clock::now() < deadline) {
+		this->endpoint->transmit(this->address, SOE_UDP_TYPE_HELLO, this->session, 0, 0, 0, nullptr, 0);
+		this->cv_receive.wait_for(lock, std::chrono::milliseconds(SOE_UDP_HELLO_INTERVAL));
+	}
+	return this->established && !this->closed;
+}
+
+void SerialOverEthernet::SOEDatagramPeer::close() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_state);
+		if (this->closed) return;
+		// best effort, the remote runs into its timeout if this gets lost
+		this->endpoint->transmit(this->address, SOE_UDP_TYPE_CLOSE, this->session, 0, 0, 0, nullptr, 0);
+	}
+	markClosed();
+}
+
+void SerialOverEthernet::SOEDatagramPeer::markClosed() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_state);
+		this->closed = true;
+	}
+	this->cv_send.notify_all();
+	this->cv_receive.notify_all();
+	this->cv_timer.notify_all();
+	this->endpoint->removePeer(this);
+}
+
+bool SerialOverEthernet::SOEDatagramPeer::isOpen() {
+	std::lock_guard<std::mutex> lock(this->m_state);
+	return !this->closed;
+}
+
+bool SerialOverEthernet::SOEDatagramPeer::hasTimedOut() {
+	std::lock_guard<std::mutex> lock(this->m_state);
+	return this->closed || std::chrono::steady_clock::now() - this->lastReceived > std::chrono::milliseconds(SOE_UDP_PEER_TIMEOUT);
+}
+
+const NetSocket::INetAddress& SerialOverEthernet::SOEDatagramPeer::getAddress() {
+	return this->address;
+}
+
+unsigned long long SerialOverEthernet::SOEDatagramPeer::getSession() {
+	return this->session;
+}
+
+void SerialOverEthernet::SOEDatagramPeer::transmitSegment(unsigned long long sequence, Segment& segment) {
+	segment.lastSent = std::chrono::steady_clock::now();
+	segment.transmissions++;
+
+	// every datagram carries the acknowledgements of the opposite direction
+	unsigned long long selective = 0;
+	for (auto& entry : this->reorder)
+		selective |= 1ULL << (entry.first - this->receiveNext - 1);
+	unsigned int window = receiveWindow();
+	this->advertisedWindowEnd = this->receiveNext + window;
+	this->endpoint->transmit(this->address, SOE_UDP_TYPE_DATA, sequence, this->receiveNext, selective, window, segment.data.data(), (unsigned int) segment.data.length());
+}
+
+void SerialOverEthernet::SOEDatagramPeer::transmitAcknowledgement() {
+	unsigned long long selective = 0;
+	for (auto& entry : this->reorder)
+		selective |= 1ULL << (entry.first - this->receiveNext - 1);
+	unsigned int window = receiveWindow();
+	this->advertisedWindowEnd = this->receiveNext + window;
+	this->endpoint->transmit(this->address, SOE_UDP_TYPE_ACK, 0, this->receiveNext, selective, window, nullptr, 0);
+}
+
+unsigned int SerialOverEthernet::SOEDatagramPeer::receiveWindow() {
+	// the datagrams in the reorder map are part of the window already, so its end never moves backwards
+	if (this->received.size() >= SOE_UDP_RECEIVE_BUFFER) return 0;
+	return std::min<unsigned int>((SOE_UDP_RECEIVE_BUFFER - this->received.size()) / SOE_UDP_SEGMENT_LEN, SOE_UDP_WINDOW);
+}
+
+void SerialOverEthernet::SOEDatagramPeer::processDatagram(unsigned char type, unsigned long long sequence, unsigned long long acknowledged, unsigned long long selective, unsigned int window, const char* payload, unsigned int payloadLen) {
+
+	if (type == SOE_UDP_TYPE_CLOSE) {
+		dbgprintf("[DBG] datagram stream closed by remote\n");
+		markClosed();
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(this->m_state);
+	this->lastReceived = std::chrono::steady_clock::now();
+
+	if (type == SOE_UDP_TYPE_HELLO_ACK) {
+		this->established = true;
+		this->cv_receive.notify_all();
+		return;
+	}
+
+	if (type != SOE_UDP_TYPE_DATA && type != SOE_UDP_TYPE_ACK && type != SOE_UDP_TYPE_PROBE) return;
+	this->established = true;
+	processAcknowledgement(acknowledged, selective, window);
+	if (type == SOE_UDP_TYPE_PROBE) {
+		// the remote waits for the receive window to open
+		transmitAcknowledgement();
+		return;
+	}
+	if (type != SOE_UDP_TYPE_DATA) return;
+
+	// store the datagram if it is within the receive window, duplicates of delivered ones are only acknowledged again
+	// the remote never sends beyond the advertised window, since its end never moves backwards
+	if (sequence >= this->receiveNext && sequence < this->receiveNext + receiveWindow()) {
+		if (sequence > this->receiveNext) {
+			dbgprintf("[DBG] datagram received out of order: %llu, expected %llu\n", sequence, this->receiveNext);
+		}
+		this->reorder.emplace(sequence, std::string(payload, payloadLen));
+
+		// deliver all datagrams which are now in order
+		bool delivered = false;
+		for (auto entry = this->reorder.begin(); entry != this->reorder.end() && entry->first == this->receiveNext; entry = this->reorder.erase(entry)) {
+			this->received.insert(this->received.end(), entry->second.begin(), entry->second.end());
+			this->receiveNext++;
+			delivered = true;
+		}
+		if (delivered) this->cv_receive.notify_all();
+	}
+
+	// acknowledge immediately, the remote detects losses by the acknowledgements
+	transmitAcknowledgement();
+
+}
+
+void SerialOverEthernet::SOEDatagramPeer::processAcknowledgement(unsigned long long acknowledged, unsigned long long selective, unsigned int window) {
+
+	// acknowledgements might arrive out of order, the end of the window never moves backwards
+	if (acknowledged + window > this->sendWindowEnd) {
+		this->sendWindowEnd = acknowledged + window;
+		this->cv_send.notify_all();
+		this->cv_timer.notify_one();
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point latestArrived;
+	bool anyArrived = false;
+
+	// release the datagrams the remote received, datagrams which were retransmitted do not give an valid round trip sample
+	for (auto entry = this->unacknowledged.begin(); entry != this->unacknowledged.end();) {
+		unsigned long long sequence = entry->first;
+		bool arrived = sequence < acknowledged || (sequence > acknowledged && sequence - acknowledged - 1 < 64 && (selective >> (sequence - acknowledged - 1)) & 1);
+		if (!arrived) {
+			entry++;
+			continue;
+		}
+		if (entry->second.transmissions == 1)
+			updateRoundTrip(now - entry->second.lastSent);
+		if (!anyArrived || entry->second.lastSent > latestArrived)
+			latestArrived = entry->second.lastSent;
+		anyArrived = true;
+		entry = this->unacknowledged.erase(entry);
+	}
+	if (!anyArrived) return;
+	this->cv_send.notify_all();
+
+	// an datagram is lost if one sent noticeably after it arrived, retransmit it right away instead of waiting for the timeout
+	auto reorderAllowance = this->smoothedRoundTrip / 8;
+	for (auto& entry : this->unacknowledged) {
+		if (entry.second.lastSent + reorderAllowance >= latestArrived) continue;
+		dbgprintf("[DBG] datagram lost, retransmit: %llu\n", entry.first);
+		transmitSegment(entry.first, entry.second);
+	}
+	this->cv_timer.notify_one();
+
+}
+
+void SerialOverEthernet::SOEDatagramPeer::updateRoundTrip(std::chrono::steady_clock::duration sample) {
+
+	// smoothed round trip time and variation as for TCP, but with much lower limits for the timeout
+	if (this->smoothedRoundTrip.count() == 0) {
+		this->smoothedRoundTrip = sample;
+		this->roundTripVariation = sample / 2;
+	} else {
+		auto deviation = this->smoothedRoundTrip > sample ? this->smoothedRoundTrip - sample : sample - this->smoothedRoundTrip;
+		this->roundTripVariation = (this->roundTripVariation * 3 + deviation) / 4;
+		this->smoothedRoundTrip = (this->smoothedRoundTrip * 7 + sample) / 8;
+	}
+
+	auto timeout = this->smoothedRoundTrip + std::max<std::chrono::steady_clock::duration>(this->roundTripVariation * 4, std::chrono::milliseconds(1));
+	this->retransmissionTimeout = std::min<std::chrono::steady_clock::duration>(std::max<std::chrono::steady_clock::duration>(timeout, std::chrono::milliseconds(SOE_UDP_MIN_RTO)), std::chrono::milliseconds(SOE_UDP_MAX_RTO));
+
+}
+
+void SerialOverEthernet::SOEDatagramPeer::doRetransmission() {
+
+	std::unique_lock<std::mutex> lock(this->m_state);
+
+	while (!this->closed) {
+
+		if (this->unacknowledged.empty() && this->sendNext < this->sendWindowEnd) {
+			this->cv_timer.wait(lock);
+			continue;
+		}
+
+		// the receive window of the remote is closed, probe it until it opens
+		if (this->unacknowledged.empty()) {
+			if (this->cv_timer.wait_for(lock, std::chrono::milliseconds(SOE_UDP_MAX_RTO)) == std::cv_status::no_timeout) continue;
+			if (this->closed || !this->unacknowledged.empty() || this->sendNext < this->sendWindowEnd) continue;
+			if (std::chrono::steady_clock::now() - this->lastReceived > std::chrono::milliseconds(SOE_UDP_PEER_TIMEOUT)) {
+				printf("[!] receive window not opened for %u ms, closing connection\n", SOE_UDP_PEER_TIMEOUT);
+				lock.unlock();
+				close();
+				return;
+			}
+			this->endpoint->transmit(this->address, SOE_UDP_TYPE_PROBE, 0, this->receiveNext, 0, receiveWindow(), nullptr, 0);
+			continue;
+		}
+
+		// find the next expiring datagram, the timeout doubles with every retransmission of an datagram
+		auto now = std::chrono::steady_clock::now();
+		auto deadline = std::chrono::steady_clock::time_point::max();
+		unsigned long long expired = 0;
+		bool anyExpired = false;
+		for (auto& entry : this->unacknowledged) {
+			if (now - entry.second.firstSent > std::chrono::milliseconds(SOE_UDP_PEER_TIMEOUT)) {
+				printf("[!] datagram not acknowledged for %u ms, closing connection\n", SOE_UDP_PEER_TIMEOUT);
+				lock.unlock();
+				close();
+				return;
+			}
+			auto timeout = std::min<std::chrono::steady_clock::duration>(this->retransmissionTimeout * (1 << std::min(entry.second.transmissions - 1, 6U)), std::chrono::milliseconds(SOE_UDP_MAX_RTO));
+			auto expiry = entry.second.lastSent + timeout;
+			if (expiry <= now && !anyExpired) {
+				expired = entry.first;
+				anyExpired = true;
+			}
+			if (expiry < deadline) deadline = expiry;
+		}
+
+		if (anyExpired) {
+			dbgprintf("[DBG] datagram timed out, retransmit: %llu\n", expired);
+			transmitSegment(expired, this->unacknowledged[expired]);
+			continue;
+		}
+
+		this->cv_timer.wait_until(lock, deadline);
+
+	}
+
+}
+
+// SOEDatagramEndpoint
+
+SerialOverEthernet::SOEDatagramEndpoint::SOEDatagramEndpoint(bool serverMode) {
+	this->serverMode = serverMode;
+	this->socket.reset(NetSocket::newSocket());
+}
+
+SerialOverEthernet::SOEDatagramEndpoint::~SOEDatagramEndpoint() {
+	close();
+	// the reception thread holds an reference until it terminates, so it might be the one releasing the endpoint
+	if (this->thread_rx.joinable() && this->thread_rx.get_id() == std::this_thread::get_id()) {
+		this->thread_rx.detach();
+	} else if (this->thread_rx.joinable()) {
+		this->thread_rx.join();
+	}
+}
+
+bool SerialOverEthernet::SOEDatagramEndpoint::bind(const NetSocket::INetAddress& address) {
+	if (!this->socket->bind(address)) return false;
+	this->open = true;
+	return true;
+}
+
+void SerialOverEthernet::SOEDatagramEndpoint::start() {
+	std::shared_ptr<SOEDatagramEndpoint> self = shared_from_this();
+	this->thread_rx = std::thread([self]() -> void {
+		self->doReception();
+	});
+}
+
+void SerialOverEthernet::SOEDatagramEndpoint::close() {
+	if (!this->open.exchange(false)) return;
+	this->socket->close();
+	this->cv_accept.notify_all();
+}
+
+bool SerialOverEthernet::SOEDatagramEndpoint::isOpen() {
+	return this->open;
+}
+
+std::shared_ptr<SerialOverEthernet::SOEDatagramPeer> SerialOverEthernet::SOEDatagramEndpoint::accept() {
+	std::unique_lock<std::mutex> lock(this->m_peers);
+	this->cv_accept.wait(lock, [this]() {
+		return !this->pending.empty() || !this->open;
+	});
+	if (this->pending.empty()) return nullptr;
+	std::shared_ptr<SOEDatagramPeer> peer = this->pending.front();
+	this->pending.pop_front();
+	return peer;
+}
+
+std::shared_ptr<SerialOverEthernet::SOEDatagramPeer> SerialOverEthernet::SOEDatagramEndpoint::connect(const NetSocket::INetAddress& address) {
+	std::random_device random;
+	unsigned long long session = ((unsigned long long) random() << 32) | random();
+
+	std::shared_ptr<SOEDatagramPeer> peer = std::make_shared<SOEDatagramPeer>(shared_from_this(), address, session);
+	{
+		std::lock_guard<std::mutex> lock(this->m_peers);
+		this->peers[address] = peer;
+	}
+	peer->start();
+	return peer;
+}
+
+void SerialOverEthernet::SOEDatagramEndpoint::removePeer(SOEDatagramPeer* peer) {
+	std::shared_ptr<SOEDatagramPeer> removed; // released after the lock, it might be the last reference
+	{
+		std::lock_guard<std::mutex> lock(this->m_peers);
+		auto entry = this->peers.find(peer->getAddress());
+		if (entry != this->peers.end() && entry->second.get() == peer) {
+			removed = entry->second;
+			this->peers.erase(entry);
+		}
+	}
+	if (!this->serverMode) close();
+}
+
+bool SerialOverEthernet::SOEDatagramEndpoint::transmit(const NetSocket::INetAddress& address, unsigned char type, unsigned long long sequence, unsigned long long acknowledged, unsigned long long selective, unsigned int window, const char* payload, unsigned int payloadLen) {
+	char datagram[SOE_UDP_DATAGRAM_MAX_LEN];
+	datagram[0] = SOE_UDP_MAGIC & 0xFF;
+	datagram[1] = (SOE_UDP_MAGIC >> 8) & 0xFF;
+	datagram[2] = type;
+	writeNumber(datagram + 3, sequence);
+	writeNumber(datagram + 11, acknowledged);
+	writeNumber(datagram + 19, selective);
+	datagram[27] = window & 0xFF;
+	datagram[28] = (window >> 8) & 0xFF;
+	if (payloadLen > 0) memcpy(datagram + SOE_UDP_HEADER_LEN, payload, payloadLen);
+
+	std::lock_guard<std::mutex> lock(this->m_socketTX);
+	return this->socket->sendto(address, datagram, SOE_UDP_HEADER_LEN + payloadLen);
+}
+
+void SerialOverEthernet::SOEDatagramEndpoint::doReception() {
+
+	char datagram[SOE_UDP_DATAGRAM_MAX_LEN];
+
+	while (isOpen()) {
+
+		NetSocket::INetAddress sender;
+		unsigned int datagramLen = 0;
+		if (!this->socket->receivefrom(sender, datagram, SOE_UDP_DATAGRAM_MAX_LEN, &datagramLen)) {
+			// errors of earlier transmissions are reported here as well, only an closed socket ends the reception
+			if (!isOpen()) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// check header
+		if (datagramLen < SOE_UDP_HEADER_LEN || datagram[0] != (char) (SOE_UDP_MAGIC & 0xFF) || datagram[1] != (char) ((SOE_UDP_MAGIC >> 8) & 0xFF)) {
+			dbgprintf("[DBG] dropped invalid datagram\n");
+			continue;
+		}
+		unsigned char type = (unsigned char) datagram[2];
+		unsigned long long sequence = readNumber(datagram + 3);
+		unsigned long long acknowledged = readNumber(datagram + 11);
+		unsigned long long selective = readNumber(datagram + 19);
+		unsigned int window = (unsigned char) datagram[27] | ((unsigned int) (unsigned char) datagram[28] << 8);
+
+		std::shared_ptr<SOEDatagramPeer> peer;
+		std::shared_ptr<SOEDatagramPeer> replaced;
+		{
+			std::lock_guard<std::mutex> lock(this->m_peers);
+			auto entry = this->peers.find(sender);
+			if (entry != this->peers.end()) peer = entry->second;
+
+			// connection requests create an new peer, unless it is an repeated request of an existing one
+			// an new session of the same address replaces the old one only after that timed out, the remote repeats its request until then
+			if (type == SOE_UDP_TYPE_HELLO && this->serverMode && (peer == nullptr || peer->getSession() != sequence)) {
+				if (peer != nullptr && !peer->hasTimedOut()) {
+					dbgprintf("[DBG] connection request of an new session while the old one is active, ignored\n");
+					continue;
+				}
+				replaced = peer;
+				peer = std::make_shared<SOEDatagramPeer>(shared_from_this(), sender, sequence);
+				peer->start();
+				this->peers[sender] = peer;
+				this->pending.push_back(peer);
+				this->cv_accept.notify_one();
+			}
+		}
+
+		// the remote was restarted, the old stream ends
+		if (replaced != nullptr) replaced->close();
+
+		if (type == SOE_UDP_TYPE_HELLO) {
+			if (peer != nullptr) transmit(sender, SOE_UDP_TYPE_HELLO_ACK, sequence, 0, 0, 0, nullptr, 0);
+			continue;
+		}
+
+		if (peer == nullptr) {
+			// tell remotes of streams which no longer exist to give up
+			if (type != SOE_UDP_TYPE_CLOSE) transmit(sender, SOE_UDP_TYPE_CLOSE, 0, 0, 0, 0, nullptr, 0);
+			continue;
+		}
+
+		peer->processDatagram(type, sequence, acknowledged, selective, window, datagram + SOE_UDP_HEADER_LEN, datagramLen - SOE_UDP_HEADER_LEN);
+
+	}
+
+	dbgprintf("[DBG] datagram reception terminated\n");
+
+	// close all remaining streams
+	std::map<NetSocket::INetAddress, std::shared_ptr<SOEDatagramPeer>> remaining;
+	{
+		std::lock_guard<std::mutex> lock(this->m_peers);
+		remaining = this->peers;
+	}
+	for (auto& entry : remaining)
+		entry.second->close();
+
+}
+
+// SOEDatagramSocket
+
+SerialOverEthernet::SOEDatagramSocket::~SOEDatagramSocket() {
+	close();
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::getINet(NetSocket::INetAddress& address) {
+	if (this->peer == nullptr) return false;
+	address = this->peer->getAddress();
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::setNagle(bool /*enable*/) {
+	return true; // datagrams are never delayed
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::getNagle(bool* enable) {
+	*enable = false;
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::listen(const NetSocket::INetAddress& address) {
+	this->endpoint = std::make_shared<SOEDatagramEndpoint>(true);
+	if (!this->endpoint->bind(address)) {
+		this->endpoint.reset();
+		return false;
+	}
+	this->endpoint->start();
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::accept(NetSocket::Socket& socket) {
+	SOEDatagramSocket* datagramSocket = dynamic_cast<SOEDatagramSocket*>(&socket);
+	if (datagramSocket == nullptr || this->endpoint == nullptr) return false;
+	std::shared_ptr<SOEDatagramPeer> peer = this->endpoint->accept();
+	if (peer == nullptr) return false;
+	datagramSocket->endpoint = this->endpoint;
+	datagramSocket->peer = peer;
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::setTimeouts(unsigned long rxTimeout, unsigned long txTimeout) {
+	return rxTimeout == 0 && txTimeout == 0; // only blocking operation is supported
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::getTimeouts(unsigned long* rxTimeout, unsigned long* txTimeout) {
+	*rxTimeout = *txTimeout = 0;
+	return true;
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::connect(const NetSocket::INetAddress& address, unsigned long timeout) {
+
+	// bind to an random local port of the same address family
+	std::string remoteHost;
+	unsigned int remotePort;
+	std::vector<NetSocket::INetAddress> localAddresses;
+	if (!address.tostr(remoteHost, &remotePort) || !NetSocket::resolveInet(remoteHost.find(':') != std::string::npos ? "::" : "0.0.0.0", "0", false, localAddresses) || localAddresses.empty())
+		return false;
+
+	this->endpoint = std::make_shared<SOEDatagramEndpoint>(false);
+	if (!this->endpoint->bind(localAddresses[0])) {
+		this->endpoint.reset();
+		return false;
+	}
+	this->endpoint->start();
+
+	this->peer = this->endpoint->connect(address);
+	if (!this->peer->establish(timeout)) {
+		close();
+		return false;
+	}
+	return true;
+
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::send(const char* buffer, unsigned int length) {
+	return this->peer != nullptr && this->peer->send(buffer, length);
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::receive(char* buffer, unsigned int length, unsigned int* received) {
+	if (this->peer == nullptr) {
+		*received = 0;
+		return false;
+	}
+	return this->peer->receive(buffer, length, received);
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::bind(const NetSocket::INetAddress& /*address*/) {
+	return false; // the datagrams are handled by the endpoint
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::receivefrom(NetSocket::INetAddress& /*address*/, char* /*buffer*/, unsigned int /*length*/, unsigned int* received) {
+	*received = 0;
+	return false; // the datagrams are handled by the endpoint
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::sendto(const NetSocket::INetAddress& /*address*/, const char* /*buffer*/, unsigned int /*length*/) {
+	return false; // the datagrams are handled by the endpoint
+}
+
+void SerialOverEthernet::SOEDatagramSocket::close() {
+	// an accepted stream leaves the endpoint of the listening socket open
+	if (this->peer != nullptr) {
+		this->peer->close();
+	} else if (this->endpoint != nullptr) {
+		this->endpoint->close();
+	}
+}
+
+bool SerialOverEthernet::SOEDatagramSocket::isOpen() {
+	if (this->peer != nullptr) return this->peer->isOpen();
+	return this->endpoint != nullptr && this->endpoint->isOpen();
+}
+
+int SerialOverEthernet::SOEDatagramSocket::type() {
+	return SOE_TRANSPORT_UDP;
+}
+
+int SerialOverEthernet::SOEDatagramSocket::lastError() {
+	return 0;
+}
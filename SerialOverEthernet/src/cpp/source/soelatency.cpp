@@ -0,0 +1,91 @@
+/*
+ * soelatency.cpp
+ *
+ * Implements the latency histograms of the Serial over Ethernet/IP links.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#include "soelatency.hpp"
+
+unsigned int SerialOverEthernet::SOELatencyHistogram::bucketOf(unsigned long long value) {
+	if (value < SOE_LATENCY_SUB_BUCKETS) return (unsigned int) value;
+	unsigned int highestBit = 0;
+	for (unsigned long long rest = value >> 1; rest != 0; rest >>= 1)
+		highestBit++;
+	// one row of sub buckets per power of two, selected by the bits behind the highest one
+	unsigned int shift = highestBit - SOE_LATENCY_SUB_BITS;
+	return (highestBit - SOE_LATENCY_SUB_BITS + 1) * SOE_LATENCY_SUB_BUCKETS + (unsigned int) ((value >> shift) & (SOE_LATENCY_SUB_BUCKETS - 1));
+}
+
+unsigned long long SerialOverEthernet::SOELatencyHistogram::bucketEnd(unsigned int bucket) {
+	if (bucket < SOE_LATENCY_SUB_BUCKETS) return bucket;
+	unsigned int shift = bucket / SOE_LATENCY_SUB_BUCKETS - 1;
+	unsigned long long start = (unsigned long long) (SOE_LATENCY_SUB_BUCKETS + bucket % SOE_LATENCY_SUB_BUCKETS) << shift;
+	return start + ((1ULL << shift) - 1);
+}
+
+void SerialOverEthernet::SOELatencyHistogram::record(std::chrono::steady_clock::duration latency) {
+	long long micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+	unsigned long long value = micros > 0 ? (unsigned long long) micros : 0;
+
+	this->buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+	this->count.fetch_add(1, std::memory_order_relaxed);
+	this->sum.fetch_add(value, std::memory_order_relaxed);
+	unsigned long long currentMax = this->max.load(std::memory_order_relaxed);
+	while (value > currentMax && !this->max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed));
+}
+
+unsigned long long SerialOverEthernet::SOELatencyHistogram::valueAt(double percentile) const {
+	unsigned long long total = this->count.load(std::memory_order_relaxed);
+	if (total == 0) return 0;
+	unsigned long long threshold = (unsigned long long) (total * percentile / 100.0 + 0.5);
+	if (threshold < 1) threshold = 1;
+
+	unsigned long long counted = 0;
+	for (unsigned int bucket = 0; bucket < SOE_LATENCY_BUCKETS; bucket++) {
+		counted += this->buckets[bucket].load(std::memory_order_relaxed);
+		if (counted >= threshold) {
+			// the bucket end might be above the largest value actually recorded
+			unsigned long long value = bucketEnd(bucket);
+			unsigned long long currentMax = this->max.load(std::memory_order_relaxed);
+			return value < currentMax ? value : currentMax;
+		}
+	}
+	return this->max.load(std::memory_order_relaxed);
+}
+
+void SerialOverEthernet::SOELatencyHistogram::print(FILE* output, const char* name) const {
+	unsigned long long total = this->count.load(std::memory_order_relaxed);
+	unsigned long long mean = total > 0 ? this->sum.load(std::memory_order_relaxed) / total : 0;
+	fprintf(output, "  %-18s count %llu, mean %llu us, p50 %llu us, p90 %llu us, p99 %llu us, p99.9 %llu us, max %llu us\n",
+			name, total, mean, valueAt(50.0), valueAt(90.0), valueAt(99.0), valueAt(99.9), this->max.load(std::memory_order_relaxed));
+}
+
+void SerialOverEthernet::SOELinkLatency::dataBuffered(unsigned long len) {
+	this->bufferedBytes += len;
+
+	// if all marks are in use, the data is measured together with the next package, which under reports its latency
+	unsigned int head = this->marksHead.load(std::memory_order_relaxed);
+	if (head - this->marksTail.load(std::memory_order_acquire) >= SOE_LATENCY_MARKS) return;
+	Mark& mark = this->marks[head % SOE_LATENCY_MARKS];
+	mark.end = this->bufferedBytes;
+	mark.time = std::chrono::steady_clock::now();
+	this->marksHead.store(head + 1, std::memory_order_release);
+}
+
+void SerialOverEthernet::SOELinkLatency::dataWritten(unsigned long len) {
+	this->writtenBytes += len;
+
+	// record all packages which were written completely
+	auto now = std::chrono::steady_clock::now();
+	unsigned int tail = this->marksTail.load(std::memory_order_relaxed);
+	unsigned int head = this->marksHead.load(std::memory_order_acquire);
+	for (; tail != head; tail++) {
+		Mark& mark = this->marks[tail % SOE_LATENCY_MARKS];
+		if (mark.end > this->writtenBytes) break;
+		this->networkToSerial.record(now - mark.time);
+	}
+	this->marksTail.store(tail, std::memory_order_release);
+}
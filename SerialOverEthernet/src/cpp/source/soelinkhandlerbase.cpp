@@ -9,48 +9,78 @@
  */
 
 #include <string>
+#include <string.h>
+#include <random>
+#include <algorithm>
 #include "soeconnection.hpp"
 #include "dbgprintf.h"
 
-SerialOverEthernet::SOELinkHandler::SOELinkHandler(NetSocket::Socket* socket, std::string& hostName, std::string& hostPort, std::function<void(SOELinkHandler*)> onDeath) {
+SerialOverEthernet::SOELinkHandler::SOELinkHandler(std::shared_ptr<SOEConnection> connection, unsigned char channel, std::function<void(SOELinkHandler*)> onDeath) {
 	this->onDeath = onDeath;
-	this->remoteHostName = hostName;
-	this->remoteHostPort = hostPort;
-	this->socket.reset(socket);
-	this->socket->setTimeouts(0, 0);
-	this->socket->setNagle(false);
+	this->connection = connection;
+	this->channel = channel;
+	this->serialFrame.reset(new char[SOE_TCP_FRAME_MAX_LEN]);
+	this->serialData.reset(new Ringbuffer(this->options.bufferSize));
 }
 
 SerialOverEthernet::SOELinkHandler::~SOELinkHandler() {}
 
-void SerialOverEthernet::SOELinkHandler::start() {
-	this->thread_rx = std::thread([this]() -> void {
-		this->doNetworkReception();
-	});
-	this->thread_tx = std::thread([this]() -> void {
-		this->doSerialReception();
-	});
+void SerialOverEthernet::SOELinkHandler::start(SOEReactor* reactor) {
+	this->reactor = reactor;
+	// packages are received by the connection, which delivers them to the link of their channel
+	unsigned char channel;
+	getConnection(&channel)->attach(channel, this);
+	// in reactor mode, the serial port is serviced by the reactor threads
+	if (this->reactor == nullptr) {
+		this->thread_tx = std::thread([this]() -> void {
+			this->doSerialReception();
+		});
+	}
+}
+
+void SerialOverEthernet::SOELinkHandler::setOptions(const SOELinkOptions& options) {
+	if (options.bufferSize != this->options.bufferSize)
+		this->serialData.reset(new Ringbuffer(options.bufferSize));
+	this->options = options;
 }
 
 void SerialOverEthernet::SOELinkHandler::stop() {
 	shutdown();
-	dbgprintf("[DBG] joining RX thread ...\n");
-	this->thread_rx.join();
-	dbgprintf("[DBG] joined\n");
-	dbgprintf("[DBG] joining TX thread ...\n");
-	this->thread_tx.join();
-	dbgprintf("[DBG] joined\n");
+	unsigned char channel;
+	std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+	connection->detach(channel, this);
+	if (this->thread_tx.joinable()) {
+		dbgprintf("[DBG] joining TX thread ...\n");
+		this->thread_tx.join();
+		dbgprintf("[DBG] joined\n");
+	}
+	if (this->thread_resume.joinable()) {
+		dbgprintf("[DBG] joining resume thread ...\n");
+		this->thread_resume.join();
+		dbgprintf("[DBG] joined\n");
+	}
+#ifdef PLATFORM_LIN
+	if (this->reactor != nullptr)
+		this->reactor->detach(this);
+#endif
 }
 
 bool SerialOverEthernet::SOELinkHandler::shutdown() {
-	if (isAlive()) {
-		printf("[i] link shutting down: %s <-> %s @ %s/%s\n", this->localPortName.c_str(), this->remotePortName.c_str(), this->remoteHostName.c_str(), this->remoteHostPort.c_str());
+	if (!this->closed.exchange(true)) {
+		unsigned char channel;
+		std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+		printf("[i] link shutting down: %s <-> %s @ %s/%s (channel %u)\n", this->localPortName.c_str(), this->remotePortName.c_str(), connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
 		closeLocalPort();
-		this->socket->close();
-		this->remoteReturn = false;
-		this->cv_remoteReturn.notify_all();
+		connection->releaseChannel(channel);
+		failRequests();
 		this->cv_openLocalPort.notify_all();
+		{
+			std::lock_guard<std::mutex> lock(this->m_resume);
+			this->cv_resume.notify_all();
+		}
 		this->onDeath(this);
+		dbgprintf("[DBG] transmitted %llu serial bytes in %llu frames\n", this->stats.txSerialBytes.load(), this->stats.txSerialFrames.load());
+		dbgprintf("[DBG] toggled remote flow control %llu times\n", this->stats.flowControlToggles.load());
 		dbgprintf("[DBG] client handler terminated\n");
 		return true;
 	}
@@ -58,62 +88,364 @@ bool SerialOverEthernet::SOELinkHandler::shutdown() {
 }
 
 bool SerialOverEthernet::SOELinkHandler::isAlive() {
-	return this->socket->isOpen();
+	// an resumable link stays alive while it waits for its lost connection to be resumed
+	return !this->closed && (this->session != 0 || getConnection()->isAlive());
 }
 
-bool SerialOverEthernet::SOELinkHandler::openRemotePort(const std::string& remoteSerial) {
-	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
-	this->remotePortName = remoteSerial;
-	dbgprintf("[DBG] opening remote port: %s\n", this->remotePortName.c_str());
-	if (!sendRemoteOpen(remoteSerial)) {
-		printf("[!] failed to send open request for remote port: %s\n", this->remotePortName.c_str());
+int SerialOverEthernet::SOELinkHandler::requestSession() {
+	if (this->options.resumeTimeout == 0 || !getConnection()->supportsResume()) return -1;
+
+	std::random_device random;
+	unsigned long long session = ((unsigned long long) random() << 32) | random();
+	if (session == 0) session = 1;
+
+	{
+		// the data transmitted while waiting for the response has to be kept already
+		std::lock_guard<std::mutex> lock(this->m_replay);
+		this->replayData.reset(new Ringbuffer(SOE_RESUME_BUFFER_LEN));
+		this->replayStart = this->txSequence;
+		this->session = session;
+	}
+	dbgprintf("[DBG] starting resumable session: %016llx\n", session);
+	int request = transmitRequest([this, session](int request) { return sendSession(session, request); });
+	if (request < 0) {
+		printf("[!] failed to send session to remote\n");
+		std::lock_guard<std::mutex> lock(this->m_replay);
+		this->session = 0;
+		this->replayData.reset();
+	}
+	return request;
+}
+
+void SerialOverEthernet::SOELinkHandler::awaitSession(int request) {
+	if (this->session == 0) return;
+	if (awaitRequest(request) == 1) return;
+	printf("[i] remote does not accept resumable session, link ends with the connection\n");
+	std::lock_guard<std::mutex> lock(this->m_replay);
+	this->session = 0;
+	this->replayData.reset();
+}
+
+void SerialOverEthernet::SOELinkHandler::setReconnect(std::function<bool(SOELinkHandler*)> reconnect) {
+	this->reconnect = reconnect;
+}
+
+unsigned long long SerialOverEthernet::SOELinkHandler::getSession() {
+	return this->session;
+}
+
+void SerialOverEthernet::SOELinkHandler::connectionLost(SOEConnection* lostConnection) {
+	// the link might already be resumed on an new connection
+	if (getConnection().get() != lostConnection) return;
+
+	if (this->session == 0 || this->closed) {
+		shutdown();
+		return;
+	}
+
+	// an resume attempt waiting for its response on this connection failed
+	failRequests();
+	if (this->detached.exchange(true)) return;
+
+	printf("[i] connection lost, waiting for link to be resumed: %s <-> %s @ %s/%s\n", this->localPortName.c_str(), this->remotePortName.c_str(), lostConnection->getHostName().c_str(), lostConnection->getHostPort().c_str());
+
+	// the previous resume thread is done once the link was resumed
+	if (this->thread_resume.joinable())
+		this->thread_resume.join();
+	this->thread_resume = std::thread([this]() -> void {
+		this->doResume();
+	});
+}
+
+void SerialOverEthernet::SOELinkHandler::doResume() {
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->options.resumeTimeout);
+
+	if (this->reconnect) {
+		// attempt new connections with increasing delay, until one is resumed or the timeout expires
+		unsigned long backoff = SOE_RESUME_BACKOFF_MIN;
+		while (this->detached && !this->closed) {
+			if (this->reconnect(this)) break;
+			if (std::chrono::steady_clock::now() + std::chrono::milliseconds(backoff) >= deadline) break;
+			dbgprintf("[DBG] resume failed, next attempt in %lu ms\n", backoff);
+			std::unique_lock<std::mutex> lock(this->m_resume);
+			this->cv_resume.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return (bool) this->closed; });
+			backoff = backoff * 2 < SOE_RESUME_BACKOFF_MAX ? backoff * 2 : SOE_RESUME_BACKOFF_MAX;
+		}
+	} else {
+		// wait for the remote to resume the link on an new connection
+		std::unique_lock<std::mutex> lock(this->m_resume);
+		this->cv_resume.wait_until(lock, deadline, [this]() { return !this->detached || this->closed; });
+	}
+
+	if (this->detached && !this->closed) {
+		printf("[!] unable to resume link within timeout: %s <-> %s\n", this->localPortName.c_str(), this->remotePortName.c_str());
+		shutdown();
+	}
+
+}
+
+bool SerialOverEthernet::SOELinkHandler::resumeSession(std::shared_ptr<SOEConnection> connection, unsigned char channel) {
+
+	attachConnection(connection, channel);
+
+	// the remote answers with the data it received, and transmits the data this end did not receive again
+	dbgprintf("[DBG] resuming session on channel %u: %016llx\n", channel, this->session.load());
+	int request = -1;
+	if (connection->negotiateFrameLimit())
+		request = transmitRequest([this](int) { return sendResume(); });
+	if (request < 0) {
+		printf("[!] failed to send resume request to remote\n");
+		connection->shutdown();
+		return false;
+	}
+	int result = awaitRequest(request);
+	if (result < 0) {
+		printf("[!] handshake timed out, failed to resume link\n");
+		connection->shutdown();
 		return false;
 	}
-	if (this->cv_remoteReturn.wait_for(lock, std::chrono::milliseconds(SOE_TCP_HANDSHAKE_TIMEOUT)) == std::cv_status::timeout) {
-		printf("[!] handshake timed out, failed to open port: %s\n", this->remotePortName.c_str());
+	if (result == 0) {
+		// rejected sessions are never accepted again, if the connection was lost the next attempt might succeed
+		if (connection->isAlive()) {
+			printf("[!] remote rejected session, link can not be resumed\n");
+			shutdown();
+		}
 		return false;
 	}
-	return this->remoteReturn;
+
+	unsigned long long remoteReceived;
+	{
+		std::lock_guard<std::mutex> lock(this->m_remoteReturn);
+		remoteReceived = this->resumeReceived;
+	}
+	return replaySession(remoteReceived);
+
+}
+
+bool SerialOverEthernet::SOELinkHandler::acceptSession(std::shared_ptr<SOEConnection> connection, unsigned char channel, unsigned long long remoteReceived) {
+
+	// the lost connection might not be detected yet, the link must not transmit on the new connection before the response
+	{
+		std::lock_guard<std::mutex> lock(this->m_replay);
+		this->detached = true;
+	}
+	std::shared_ptr<SOEConnection> previous = getConnection();
+	attachConnection(connection, channel);
+	if (previous != connection) previous->shutdown();
+
+	printf("[i] resuming link: %s <-> %s @ %s/%s (channel %u)\n", this->localPortName.c_str(), this->remotePortName.c_str(), connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
+	if (!sendResume()) {
+		printf("[!] failed to send resume response to remote\n");
+		return false;
+	}
+	return replaySession(remoteReceived);
+
+}
+
+void SerialOverEthernet::SOELinkHandler::attachConnection(std::shared_ptr<SOEConnection> connection, unsigned char channel) {
+	std::shared_ptr<SOEConnection> previous;
+	unsigned char previousChannel;
+	{
+		std::lock_guard<std::mutex> lock(this->m_connection);
+		previous = this->connection;
+		previousChannel = this->channel;
+		this->connection = connection;
+		this->channel = channel;
+	}
+	if (previous != connection || previousChannel != channel)
+		previous->detach(previousChannel, this);
+	connection->attach(channel, this);
+}
+
+void SerialOverEthernet::SOELinkHandler::trimReplayData() {
+	unsigned long long acknowledged = this->txAcknowledged.load();
+	if (acknowledged <= this->replayStart) return;
+	unsigned long long release = acknowledged - this->replayStart;
+	if (release > this->replayData->dataBuffered()) release = this->replayData->dataBuffered();
+	this->replayData->pushRead((unsigned long) release);
+	this->replayStart += release;
+}
+
+bool SerialOverEthernet::SOELinkHandler::isSerialReadEnabled() {
+	if (!this->flowEnable || this->detached) return false;
+	if (this->session == 0) return true;
+
+	// set before checking, so that an acknowledgement arriving in between wakes the serial port
+	this->replayBlocked = true;
+	std::lock_guard<std::mutex> lock(this->m_replay);
+	if (this->replayData != nullptr) {
+		trimReplayData();
+		if (this->replayData->free() < SOE_RESUME_READ_SPACE) return false;
+	}
+	this->replayBlocked = false;
+	return true;
+}
+
+const SerialOverEthernet::SOELinkStats& SerialOverEthernet::SOELinkHandler::getStats() {
+	return this->stats;
+}
+
+const Ringbuffer& SerialOverEthernet::SOELinkHandler::getStreamBuffer() {
+	return *this->serialData;
+}
+
+std::shared_ptr<SerialOverEthernet::SOEConnection> SerialOverEthernet::SOELinkHandler::getConnection(unsigned char* channel) {
+	std::lock_guard<std::mutex> lock(this->m_connection);
+	if (channel != nullptr) *channel = this->channel;
+	return this->connection;
+}
+
+unsigned char SerialOverEthernet::SOELinkHandler::getChannel() {
+	std::lock_guard<std::mutex> lock(this->m_connection);
+	return this->channel;
+}
+
+const std::string& SerialOverEthernet::SOELinkHandler::getLocalPortName() {
+	return this->localPortName;
+}
+
+const std::string& SerialOverEthernet::SOELinkHandler::getRemotePortName() {
+	return this->remotePortName;
+}
+
+void SerialOverEthernet::SOELinkHandler::printLatency(FILE* output) {
+	if (!this->options.latency) return;
+	unsigned char channel;
+	std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+	fprintf(output, "[i] latency of link: %s <-> %s @ %s/%s (channel %u)\n", this->localPortName.c_str(), this->remotePortName.c_str(), connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
+	this->latency.serialToNetwork.print(output, "serial -> network");
+	this->latency.networkToSerial.print(output, "network -> serial");
+	this->latency.roundTrip.print(output, "network round trip");
+}
+
+bool SerialOverEthernet::SOELinkHandler::openRemotePort(const std::string& remoteSerial) {
+	int result = awaitRequest(requestRemoteOpen(remoteSerial));
+	if (result < 0)
+		printf("[!] handshake timed out, failed to open port: %s\n", remoteSerial.c_str());
+	return result == 1;
 }
 
 bool SerialOverEthernet::SOELinkHandler::closeRemotePort() {
 	if (this->remotePortName.empty()) return true;
-	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
 	dbgprintf("[DBG] close remote port: %s\n", this->remotePortName.c_str());
-	if (!sendRemoteClose()) {
+	int request = transmitRequest([this](int request) { return sendRemoteClose(request); });
+	if (request < 0) {
 		printf("[!] failed to send close request for remote port: %s\n", this->remotePortName.c_str());
 		return false;
 	}
-	if (this->cv_remoteReturn.wait_for(lock, std::chrono::milliseconds(SOE_TCP_HANDSHAKE_TIMEOUT)) == std::cv_status::timeout) {
+	int result = awaitRequest(request);
+	if (result < 0)
 		printf("[!] handshake timed out, failed to close port: %s\n", this->remotePortName.c_str());
-		return false;
-	}
-	return this->remoteReturn;
+	return result == 1;
 }
 
 bool SerialOverEthernet::SOELinkHandler::setRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig) {
-	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
+	int result = awaitRequest(requestRemoteConfig(remoteConfig));
+	if (result < 0)
+		printf("[!] handshake timed out, failed to change configuration: %s\n", this->remotePortName.c_str());
+	return result == 1;
+}
+
+int SerialOverEthernet::SOELinkHandler::requestRemoteOpen(const std::string& remoteSerial) {
+	this->remotePortName = remoteSerial;
+	// announce the local frame limit, the remote answers with its own, older implementations answer with an error and keep the default
+	if (!getConnection()->negotiateFrameLimit()) {
+		printf("[!] failed to send frame limit to remote\n");
+		return -1;
+	}
+	dbgprintf("[DBG] opening remote port: %s\n", remoteSerial.c_str());
+	int request = transmitRequest([this, &remoteSerial](int request) { return sendRemoteOpen(remoteSerial, request); });
+	if (request < 0)
+		printf("[!] failed to send open request for remote port: %s\n", remoteSerial.c_str());
+	return request;
+}
+
+int SerialOverEthernet::SOELinkHandler::requestRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteConfig, bool awaited) {
 	dbgprintf("[DBG] changing remote port configuration: %s\n", this->remotePortName.c_str());
-	if (!sendRemoteConfig(remoteConfig)) {
+	int request = transmitRequest([this, &remoteConfig](int request) { return sendRemoteConfig(remoteConfig, request); }, awaited);
+	if (request < 0)
 		printf("[!] failed to send configuration request for remote port: %s\n", this->remotePortName.c_str());
-		return false;
+	return request;
+}
+
+int SerialOverEthernet::SOELinkHandler::transmitRequest(const std::function<bool(int)>& transmit, bool awaited) {
+	std::lock_guard<std::mutex> lock(this->m_remoteReturn);
+	int request = this->nextRequest++;
+	this->requests[request] = awaited ? -1 : -2;
+	this->requestOrder.push_back(request);
+	if (transmit(request)) return request;
+	this->requests.erase(request);
+	this->requestOrder.pop_back();
+	return -1;
+}
+
+int SerialOverEthernet::SOELinkHandler::awaitRequest(int request) {
+	if (request < 0) return 0;
+	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
+	this->cv_remoteReturn.wait_for(lock, std::chrono::milliseconds(SOE_TCP_HANDSHAKE_TIMEOUT), [this, request]() {
+		return this->requests[request] != -1;
+	});
+	int result = this->requests[request];
+	this->requests.erase(request);
+	if (result == -1) {
+		// an late confirm without id would otherwise be matched to the next request
+		this->requestOrder.erase(std::remove(this->requestOrder.begin(), this->requestOrder.end(), request), this->requestOrder.end());
 	}
-	if (this->cv_remoteReturn.wait_for(lock, std::chrono::milliseconds(SOE_TCP_HANDSHAKE_TIMEOUT)) == std::cv_status::timeout) {
-		printf("[!] handshake timed out, failed to change configuration: %s\n", this->remotePortName.c_str());
-		return false;
+	return result;
+}
+
+void SerialOverEthernet::SOELinkHandler::completeRequest(int request, bool result) {
+	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
+	if (request < 0) {
+		if (this->requestOrder.empty()) return;
+		request = this->requestOrder.front();
+	}
+	this->requestOrder.erase(std::remove(this->requestOrder.begin(), this->requestOrder.end(), request), this->requestOrder.end());
+
+	// the request might have timed out already
+	auto entry = this->requests.find(request);
+	if (entry == this->requests.end()) return;
+	if (entry->second == -2) {
+		this->requests.erase(entry);
+		return;
+	}
+	entry->second = result ? 1 : 0;
+	lock.unlock();
+	this->cv_remoteReturn.notify_all();
+}
+
+void SerialOverEthernet::SOELinkHandler::failRequests() {
+	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
+	for (int request : this->requestOrder) {
+		auto entry = this->requests.find(request);
+		if (entry == this->requests.end()) continue;
+		if (entry->second == -2)
+			this->requests.erase(entry);
+		else
+			entry->second = 0;
 	}
-	return this->remoteReturn;
+	this->requestOrder.clear();
+	lock.unlock();
+	this->cv_remoteReturn.notify_all();
 }
 
 void SerialOverEthernet::SOELinkHandler::transmitSerialData(const char* data, unsigned int len) {
 
 	// copy new data to ring buffer
-	unsigned long transfered = this->serialData.push(data, len);
+	unsigned long transfered = this->serialData->push(data, len);
+	if (this->options.latency) this->latency.dataBuffered(transfered);
 	if (transfered < len) {
 		printf("[!] reception buffer overflow, flow control failed!\n");
+		this->stats.serialErrors++;
 		return;
 	}
 
+	// only this thread fills the buffer, so the fill level can not rise in between
+	unsigned long long buffered = this->serialData->dataBuffered();
+	if (buffered > this->stats.bufferHighWater.load(std::memory_order_relaxed))
+		this->stats.bufferHighWater.store(buffered, std::memory_order_relaxed);
+
 }
 
 void SerialOverEthernet::SOELinkHandler::updateFlowControl(bool enableTransmit) {
@@ -123,81 +455,68 @@ void SerialOverEthernet::SOELinkHandler::updateFlowControl(bool enableTransmit)
 
 }
 
-void SerialOverEthernet::SOELinkHandler::doNetworkReception() {
-
-	char packageFrame[SOE_TCP_FRAME_MAX_LEN] {0};
-	unsigned int headerLen = 0;
-
-	while (isAlive()) {
-
-		if (!this->socket->receive(packageFrame, SOE_TCP_HEADER_LEN, &headerLen)) {
-			dbgprintf("[DBG] client socket closed\n");
-			break;
-		}
-
-		// check for header
-		if (headerLen < SOE_TCP_HEADER_LEN) {
-			printf("[!] frame error, receivied incomplete frame header\n");
-			break;
-		}
-
-		// check protocol identifier
-		for (unsigned char i = 0; i < SOE_TCP_PROTO_IDENT_LEN; i++)
-			if (packageFrame[i] != ((SOE_TCP_PROTO_IDENT >> i * 8) & 0xFF)) {
-				printf("[!] frame error, received package with unknown identifier: %*.s\n", SOE_TCP_PROTO_IDENT_LEN, packageFrame);
-				break;
-			}
-
-		// read package len
-		unsigned int payloadLen = 0;
-		for (unsigned char i = 0; i < SOE_TCP_FRAME_LEN_BYTES; i++)
-			payloadLen |= (((unsigned char) packageFrame[SOE_TCP_PROTO_IDENT_LEN + i]) << (i * 8));
-		if (payloadLen > SOE_TCP_FRAME_MAX_LEN - SOE_TCP_HEADER_LEN) {
-			printf("[!] frame error, received package with oversize payload: %u\n", payloadLen);
-			break;
-		}
-
-		// read remaining payload
-		unsigned int received = 0;
-		while (received < payloadLen && isAlive()) {
-			if (!this->socket->receive(packageFrame + headerLen, payloadLen, &received)) {
-				printf("[DBG] client socket payload RX returned with error code: %d\n", this->socket->lastError());
-			}
-		}
-
-		// attempt to process the package
-		if (!processPackage(packageFrame + headerLen, payloadLen)) {
-			printf("[!] frame error, package response failed\n");
-			break;
-		}
-
+void SerialOverEthernet::SOELinkHandler::updateRemoteFlowControl() {
+
+	// toggle between the watermarks only, so that the flow is not switched on every few bytes
+	unsigned long long buffered = this->serialData->dataBuffered();
+	unsigned long long capacity = this->serialData->capacity();
+	if (this->remoteFlowEnable && buffered > capacity * this->options.highWatermark / 100) {
+		printf("[i] send flow control to remote: txenbl = false\n");
+		sendFlowControl(this->remoteFlowEnable = false);
+		this->stats.flowControlToggles++;
+	} else if (!this->remoteFlowEnable && buffered <= capacity * this->options.lowWatermark / 100) {
+		printf("[i] send flow control to remote: txenbl = true\n");
+		sendFlowControl(this->remoteFlowEnable = true);
+		this->stats.flowControlToggles++;
 	}
 
-	dbgprintf("[DBG] client socket RX terminated, shutting down ...\n");
-	shutdown();
-
 }
 
 bool SerialOverEthernet::SOELinkHandler::transmitPackage(const char* package, unsigned int packageLen) {
+	return transmitPackage(&package, &packageLen, 1);
+}
 
-	// assemble frame header
-	char frameHeader[SOE_TCP_HEADER_LEN] {0};
-	for (unsigned char i = 0; i < SOE_TCP_PROTO_IDENT_LEN; i++)
-		frameHeader[i] = (SOE_TCP_PROTO_IDENT >> i * 8) & 0xFF;
-	for (unsigned char i = 0; i < SOE_TCP_FRAME_LEN_BYTES; i++)
-		frameHeader[SOE_TCP_PROTO_IDENT_LEN + i] = (packageLen >> i * 8) & 0xFF;
-
-	// acquire mutex for transmission
-	std::unique_lock<std::mutex> lock(this->m_socketTX);
+bool SerialOverEthernet::SOELinkHandler::transmitPackage(const char* const* segments, const unsigned int* segmentLens, unsigned int segmentCount) {
 
-	if (!this->socket->send(frameHeader, SOE_TCP_HEADER_LEN)) {
-		printf("[!] transmission error, unable to transmit frame header\n");
+	unsigned int packageLen = 0;
+	for (unsigned int i = 0; i < segmentCount; i++)
+		packageLen += segmentLens[i];
+	if (packageLen > getConnection()->frameLimit() - SOE_TCP_CHANNEL_HEADER_LEN) {
+		printf("[!] transmission error, package exceeds max frame length: %u\n", packageLen);
 		return false;
 	}
-	if (!this->socket->send(package, packageLen)) {
-		printf("[!] transmission error, unable to transmit package payload\n");
-		return false;
+
+	// gather payload segments behind the header, the socket has no vectored send
+	// control packages fit on the stack, only larger packages need an buffer of their size
+	char smallFrame[SOE_TCP_CHANNEL_HEADER_LEN + SOE_TCP_FRAME_DEFAULT_LEN];
+	std::unique_ptr<char[]> largeFrame;
+	char* frame = smallFrame;
+	if (packageLen > SOE_TCP_FRAME_DEFAULT_LEN) {
+		largeFrame.reset(new char[SOE_TCP_CHANNEL_HEADER_LEN + packageLen]);
+		frame = largeFrame.get();
+	}
+	unsigned int frameLen = SOE_TCP_CHANNEL_HEADER_LEN;
+	for (unsigned int i = 0; i < segmentCount; i++) {
+		memcpy(frame + frameLen, segments[i], segmentLens[i]);
+		frameLen += segmentLens[i];
 	}
 
-	return true;
+	return transmitFrame(frame, packageLen);
+}
+
+bool SerialOverEthernet::SOELinkHandler::transmitFrame(char* frame, unsigned int packageLen) {
+	// while the link waits to be resumed, packages are dropped, serial data is kept for the replay
+	if (this->detached) return true;
+	unsigned char channel;
+	std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+	// an lost connection of an resumable link is handled by connectionLost()
+	return transmitFrame(*connection, frame, packageLen, channel) || this->session != 0;
+}
+
+bool SerialOverEthernet::SOELinkHandler::transmitFrame(SOEConnection& connection, char* frame, unsigned int packageLen, unsigned char channel) {
+	unsigned int sends = 0;
+	bool transmitted = connection.transmitFrame(frame, packageLen, channel, &sends);
+	if (transmitted) this->stats.txFrames++;
+	this->stats.txSends += sends;
+	return transmitted;
 }
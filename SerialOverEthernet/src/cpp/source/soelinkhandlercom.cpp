@@ -9,13 +9,23 @@
  */
 
 #include <string>
+#include <algorithm>
 #include "soeconnection.hpp"
 #include "dbgprintf.h"
 
+std::unique_lock<std::mutex> SerialOverEthernet::SOELinkHandlerCOM::lockLocalPort() {
+	this->portLockRequests++;
+	std::shared_ptr<SerialAccess::SerialPort> port = std::atomic_load(&this->localPort);
+	if (port != 0) port->wakeup();
+	std::unique_lock<std::mutex> lock(this->m_localPort);
+	this->portLockRequests--;
+	return lock;
+}
+
 bool SerialOverEthernet::SOELinkHandlerCOM::openLocalPort(const std::string& localSerial) {
 	closeLocalPort();
-	std::unique_lock<std::mutex> lock(this->m_localPort);
-	this->localPort.reset(SerialAccess::newSerialPortS(localSerial));
+	std::unique_lock<std::mutex> lock = lockLocalPort();
+	std::atomic_store(&this->localPort, std::shared_ptr<SerialAccess::SerialPort>(SerialAccess::newSerialPortS(localSerial)));
 	this->localPortName = localSerial;
 	dbgprintf("[DBG] opening local port: %s\n", this->localPortName.c_str());
 	bool opened = this->localPort->openPort();
@@ -25,154 +35,230 @@ bool SerialOverEthernet::SOELinkHandlerCOM::openLocalPort(const std::string& loc
 			this->localPort->closePort();
 			return false;
 		}
+		// the device starts with an empty window
+		resetGCode();
+#ifdef PLATFORM_LIN
+		if (this->reactor != nullptr) {
+			if (!this->reactor->attach(this, this->localPort->getEventHandle())) {
+				this->localPort->closePort();
+				return false;
+			}
+			// trigger an initial service call, data might already be buffered
+			this->localPort->wakeup();
+		}
+#endif
 		this->cv_openLocalPort.notify_all();
 	}
 	return opened;
 }
 
 bool SerialOverEthernet::SOELinkHandlerCOM::closeLocalPort() {
-	if (this->localPort == 0 || !this->localPort->isOpen()) return true;
-	std::unique_lock<std::mutex> lock(this->m_localPort);
+	std::shared_ptr<SerialAccess::SerialPort> port = std::atomic_load(&this->localPort);
+	if (port == 0 || !port->isOpen()) return true;
+#ifdef PLATFORM_LIN
+	// has to happen before locking the port, the reactor might currently service it
+	if (this->reactor != nullptr)
+		this->reactor->detach(this);
+#endif
+	std::unique_lock<std::mutex> lock = lockLocalPort();
 	this->localPort->closePort();
 	dbgprintf("[DBG] local port closed: %s\n", this->localPortName.c_str());
 	return true;
 }
 
 bool SerialOverEthernet::SOELinkHandlerCOM::setLocalConfig(const SerialAccess::SerialPortConfiguration& localConfig) {
-	if (this->localPort == 0 || !this->localPort->isOpen()) return false;
-	std::lock_guard<std::mutex> lock(this->m_localPort);
+	std::shared_ptr<SerialAccess::SerialPort> port = std::atomic_load(&this->localPort);
+	if (port == 0 || !port->isOpen()) return false;
+	std::unique_lock<std::mutex> lock = lockLocalPort();
 	dbgprintf("[DBG] changing local port configuration: %s (baud %lu)\n", this->localPortName.c_str(), localConfig.baudRate);
-	return this->localPort->setConfig(localConfig);
+	if (!this->localPort->setConfig(localConfig)) return false;
+
+	// low latency mode is best effort, report if the driver did not accept it
+	if (localConfig.lowLatency) {
+		SerialAccess::SerialPortConfiguration appliedConfig;
+		if (this->localPort->getConfig(appliedConfig) && appliedConfig.lowLatency)
+			printf("[i] low latency mode active: %s\n", this->localPortName.c_str());
+		else
+			printf("[!] low latency mode not supported or not permitted: %s\n", this->localPortName.c_str());
+	}
+	return true;
 }
 
-void SerialOverEthernet::SOELinkHandlerCOM::doSerialReception() {
+int SerialOverEthernet::SOELinkHandlerCOM::writeBufferedData() {
 
-	char serialData[SOE_SERIAL_BUFFER_LEN] {0};
+	// get how many bytes are available for transmission
+	unsigned long availableBytes = this->serialData->dataAvailable();
+	int result = 0;
 
-	while (isAlive()) {
+	// with G-code pipelining, only the lines admitted to the device are written
+	if (this->options.gcodeMode != SOE_GCODE_OFF) {
+		if (!updateGCodeWindow()) return -1;
+		if (availableBytes > this->gcodeAdmitted) availableBytes = this->gcodeAdmitted;
+	}
 
-		// check if port closed unexpectedly
-		if (this->localPort != 0 && !this->localPort->isOpen()) {
-			printf("[!] lost connection to local serial port, closing connection\n");
-			shutdown();
+	// if data available (or pending)
+	if (availableBytes > 0) {
+
+		// start transfer or (if already pending) check status of last transfer
+		long long int written = this->localPort->writeBytes(this->serialData->dataStart(), availableBytes, false);
+		if (written < -1) {
+			this->stats.serialErrors++;
+			return -1; // when port closed / timed out
 		}
 
-		// check if port open, wait if not
-		if (this->localPort == 0 || !this->localPort->isOpen()) {
-			std::unique_lock<std::mutex> lock(this->m_localPort);
-			this->cv_openLocalPort.wait(lock, [this]() {
-				return (this->localPort != 0 && this->localPort->isOpen()) || !isAlive();
-			});
-			if (!isAlive()) break;
+		if (written < 0) {
+			dbgprintf("[DBG] pending data: [serial] <- |network| : >%.*s<\n", availableBytes, this->serialData->dataStart());
+		} else {
+			dbgprintf("[DBG] stream data: [serial] <- |network| : >%.*s<\n", written, this->serialData->dataStart());
+
+			// increment read position in buffer
+			this->serialData->pushRead(written);
+			if (this->options.gcodeMode != SOE_GCODE_OFF) gcodeWritten(written);
+			if (this->options.latency) this->latency.dataWritten(written);
+			result = 1; // data was written, its likely there is more to do
 		}
 
-		bool nothingToDo = this->serialData.dataAvailable() == 0;
+	}
 
-		// try to write data from ring buffer to serial
-		{
-			// get how many bytes are available for transmission
-			unsigned long availableBytes = this->serialData.dataAvailable();
-
-			// if data available (or pending)
-			if (availableBytes > 0) {
-
-				// start transfer or (if already pending) check status of last transfer
-				long long int written = this->localPort->writeBytes(this->serialData.dataStart(), availableBytes, false);
-				if (written < -1) {
-					continue; // when port closed / timed out
-				}
-
-				if (written < 0) {
-					dbgprintf("[DBG] pending data: [serial] <- |network| : >%.*s<\n", availableBytes, this->serialData.dataStart());
-
-					// the transmission buffer is to 75% full, send flow control signal
-					if (availableBytes > (SOE_TCP_STREAM_BUFFER_LEN / 4 * 3) && this->remoteFlowEnable) {
-						printf("[i] send flow control to remote: txenbl = false\n");
-						sendFlowControl(this->remoteFlowEnable = false);
-					}
-					nothingToDo = true; // we need to wait for the data to be transmitted
-				} else {
-					dbgprintf("[DBG] stream data: [serial] <- |network| : >%.*s<\n", written, this->serialData.dataStart());
-
-					// increment read position in buffer
-					this->serialData.pushRead(written);
-
-					nothingToDo = false; // data was written, its likely there is more to do
-				}
-
-			} else {
-				// if flow was disabled, reactivate now
-				if (!this->remoteFlowEnable) {
-					printf("[i] send flow control to remote: txenbl = true\n");
-					sendFlowControl(this->remoteFlowEnable = true);
-				}
-			}
+	// stop or resume the remote transmissions depending on the buffer fill level
+	updateRemoteFlowControl();
+	return result;
+
+}
+
+int SerialOverEthernet::SOELinkHandlerCOM::readSerialData(bool batching) {
+
+	// try to read data from serial, unless the remote end disabled transmission of more data trough flow control or the link waits to be resumed
+	if (!isSerialReadEnabled()) return 0;
+
+	// read directly behind the space reserved for the frame header, so the data does not have to be copied for transmission
+	// with G-code pipelining, the data is read a few bytes further behind, so that held back bytes of the last read can be put in front of it
+	unsigned int holdSpace = this->options.gcodeMode != SOE_GCODE_OFF ? SOE_GCODE_HOLD_LEN : 0;
+	unsigned int frameLimit = serialFrameLimit() - holdSpace;
+	char* serialData = this->serialFrame.get() + SOE_SERIAL_FRAME_HEADROOM + holdSpace;
+	long long int read = this->localPort->readBytes(serialData, frameLimit, false);
 
+	if (read < -1) {
+		this->stats.serialErrors++;
+		return -1; // when port closed / timed out
+	}
+
+	// the completion of an pending read ends the next event wait, so there is no need to check again
+
+	if (read <= 0) return 0;
+	auto readTime = std::chrono::steady_clock::now();
+
+	// if the link is busy, coalesce more data into this frame while it keeps arriving, an idle link sends immediately
+	if (batching && isSerialBatching()) {
+		unsigned int batchBytes = this->options.batchBytes == 0 || this->options.batchBytes > frameLimit ? frameLimit : this->options.batchBytes;
+		auto batchEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(this->options.batchTime);
+		auto batchSlice = std::chrono::microseconds(this->options.batchTime / 4 + 1);
+		while (read < batchBytes) {
+			auto now = std::chrono::steady_clock::now();
+			if (now >= batchEnd) break;
+			std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(batchEnd - now, batchSlice));
+
+			// the port is configured to return immediately, so reads do not remain pending on the frame buffer
+			long long int readMore = this->localPort->readBytes(serialData + read, batchBytes - read, false);
+			if (readMore <= 0) break; // data stopped arriving
+			read += readMore;
 		}
+	}
 
-		// try to read data from serial, unless the remote end disabled transmission of more data trough flow control
-		if (this->flowEnable) {
+	if (holdSpace > 0) {
+		// remove the acknowledgements of the device, the lines they release are admitted on the next write
+		serialData = this->serialFrame.get() + SOE_SERIAL_FRAME_HEADROOM;
+		read = filterGCodeResponses(serialData + holdSpace, (unsigned int) read, serialData);
+		if (read == 0) return 1;
+	}
 
-			long long int read = this->localPort->readBytes(serialData, SOE_SERIAL_BUFFER_LEN, false);
+	dbgprintf("[DBG] stream data: |serial| -> [network] : >%.*s<\n", (unsigned int) read, serialData);
 
-			if (read < -1) {
-				continue; // when port closed / timed out
-			}
+	// send data to remote
+	if (!sendSerialData(this->serialFrame.get(), (unsigned int) read)) {
+		printf("[!] frame error, unable to transmit serial data\n");
+		return -2;
+	}
+	if (this->options.latency) {
+		this->latency.serialToNetwork.record(std::chrono::steady_clock::now() - readTime);
+		// measure the round trip time while serial data is transmitted
+		if (!sendTimestamp()) return -2;
+	}
 
-			if (read < 0) {
-				// if the read did not complete, wait for a brief moment and check status again, it might just need a few CPU cycles
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				read = this->localPort->readBytes(serialData, SOE_SERIAL_BUFFER_LEN, false);
-			}
+	// acknowledgements held back during an partially transmitted line can be sent now, if the line is complete
+	if (holdSpace > 0 && !sendGCodeAcks()) return -2;
 
-			if (read > 0) {
+	return 1; // data was read, its likely there is more to do
+
+}
 
-				dbgprintf("[DBG] stream data: |serial| -> [network] : >%.*s<\n", (unsigned int) read, serialData);
+int SerialOverEthernet::SOELinkHandlerCOM::processSerialEvents(bool wait) {
 
-				// send data to remote
-				if (!sendSerialData(serialData, (unsigned int) read)) {
-					printf("[!] frame error, unable to transmit serial data\n");
-					break;
-				}
+	// check for COM state event and (if requested) wait until the port can be read or the pending data can be written
+	bool comStateChanged = true;
+	bool dataReceived = isSerialReadEnabled();
+	bool dataTransmitted = this->options.gcodeMode != SOE_GCODE_OFF ? this->gcodeAdmitted > 0 : this->serialData->dataAvailable() > 0;
+	if (!this->localPort->waitForEvents(comStateChanged, dataReceived, dataTransmitted, wait)) {
+		return -1; // when port closed / timed out / wait aborted
+	}
 
-				nothingToDo = false; // data was read, its likely there is more to do
+	if (comStateChanged || this->portStateLost.exchange(false)) {
+		// notify remote port about changed COM state
+		bool dsrState, ctsState;
+		if (!this->localPort->getPortState(dsrState, ctsState)) {
+			return -1; // when port closed
+		}
 
-			}
+		dbgprintf("[DBG] stream port state: |serial| -> [network]\n");
 
+		if (!sendPortState(dsrState, ctsState)) {
+			printf("[!] frame error, unable to transmit serial port state\n");
+			return -2;
 		}
+	}
 
-		// halt after some cycles with no work
-		if (nothingToDo) {
-			this->txHaltCycles++;
-		} else {
-			this->txHaltCycles = 0;
+	return 0;
+
+}
+
+void SerialOverEthernet::SOELinkHandlerCOM::doSerialReception() {
+
+	while (isAlive()) {
+
+		// the port is only used while locked, like the reactor does, so that other threads can not close it during an operation
+		if (this->portLockRequests > 0) std::this_thread::yield();
+		std::unique_lock<std::mutex> lock(this->m_localPort);
+
+		// check if port closed unexpectedly
+		if (this->localPort != 0 && !this->localPort->isOpen()) {
+			printf("[!] lost connection to local serial port, closing connection\n");
+			lock.unlock();
+			shutdown();
+			continue;
 		}
-		bool doHalt = this->txHaltCycles > SOE_TX_HALT_CYCLE_LIMIT;
-
-		// check for COM state event and (if no thing else to do) wait for more data
-		bool comStateChanged = true;
-		bool dataReceived = true;
-		bool dataTransmitted = !this->remoteFlowEnable;
-		if (!this->localPort->waitForEvents(comStateChanged, dataReceived, dataTransmitted, doHalt)) {
-			if (doHalt) this->txHaltCycles = 0;
-			continue; // when port closed / timed out / wait aborted
+
+		// check if port open, wait if not
+		if (this->localPort == 0) {
+			this->cv_openLocalPort.wait(lock, [this]() {
+				return this->localPort != 0 || !isAlive();
+			});
+			if (!isAlive()) break;
+			continue;
 		}
-		if (doHalt) this->txHaltCycles = 0;
 
-		if (comStateChanged) {
-			// notify remote port about changed COM state
-			bool dsrState, ctsState;
-			if (!this->localPort->getPortState(dsrState, ctsState)) {
-				continue; // when port closed
-			}
+		// try to write data from ring buffer to serial
+		int written = writeBufferedData();
+		if (written < 0) continue; // when port closed / timed out
 
-			dbgprintf("[DBG] stream port state: |serial| -> [network]\n");
+		// try to read data from serial
+		int read = readSerialData(true);
+		if (read == -2) break;
+		if (read < 0) continue; // when port closed / timed out
 
-			if (!sendPortState(dsrState, ctsState)) {
-				printf("[!] frame error, unable to transmit serial port state\n");
-				break;
-			}
-		}
+		// check for COM state event and (if nothing else to do) wait for the port, new network data or flow control changes
+		bool nothingToDo = written == 0 && read == 0 && this->portLockRequests == 0;
+		int events = processSerialEvents(nothingToDo);
+		if (events == -2) break;
 
 	}
 
@@ -181,15 +267,30 @@ void SerialOverEthernet::SOELinkHandlerCOM::doSerialReception() {
 
 }
 
+bool SerialOverEthernet::SOELinkHandlerCOM::serviceSerialReception() {
+
+	std::lock_guard<std::mutex> lock(this->m_localPort);
+
+	// check if port closed unexpectedly
+	if (this->localPort == 0 || !this->localPort->isOpen()) {
+		printf("[!] lost connection to local serial port, closing connection\n");
+		return false;
+	}
+
+	// same steps as the TX thread, but without any blocking wait
+	if (writeBufferedData() < 0) return this->localPort->isOpen();
+	int read = readSerialData(false);
+	if (read == -2) return false;
+	if (read < 0) return this->localPort->isOpen();
+	return processSerialEvents(false) != -2 && this->localPort->isOpen();
+
+}
+
 void SerialOverEthernet::SOELinkHandlerCOM::transmitSerialData(const char* data, unsigned int len) {
 
 	SOELinkHandler::transmitSerialData(data, len);
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
 
 }
 
@@ -199,26 +300,33 @@ void SerialOverEthernet::SOELinkHandlerCOM::updateFlowControl(bool enableTransmi
 
 	SOELinkHandler::updateFlowControl(enableTransmit);
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
 
 }
 
 void SerialOverEthernet::SOELinkHandlerCOM::updatePortState(bool dtr, bool rts) {
 
-	if (this->localPort == 0 || !this->localPort->isOpen()) return;
+	std::shared_ptr<SerialAccess::SerialPort> port = std::atomic_load(&this->localPort);
+	if (port == 0 || !port->isOpen()) return;
 
-	if (!this->localPort->setManualPortState(dtr, rts)) {
-		printf("[!] unable to apply port state from remote!\n");
+	{
+		// the TX thread or the reactor might use the port at the same time
+		std::unique_lock<std::mutex> lock = lockLocalPort();
+		if (!this->localPort->setManualPortState(dtr, rts)) {
+			printf("[!] unable to apply port state from remote!\n");
+			this->stats.serialErrors++;
+		}
 	}
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
+
+}
+
+void SerialOverEthernet::SOELinkHandlerCOM::wakeupSerial() {
+
+	// kick the TX thread (or reactor) out of waiting state, or keep it from entering it if it is about to
+	// called without the port lock, so the port is read atomically, openLocalPort might replace it meanwhile
+	std::shared_ptr<SerialAccess::SerialPort> port = std::atomic_load(&this->localPort);
+	if (port != 0) port->wakeup();
 
 }
@@ -0,0 +1,188 @@
+/*
+ * soelinkhandlergcode.cpp
+ *
+ * Implements the optional G-code pipelining of serial port links.
+ * Lines received from the remote are acknowledged immediately as long as the queue allows,
+ * while the device is fed trough an window by counting its "ok" responses or the bytes in its receive buffer.
+ * The "ok" responses of the device are removed from its output, since the remote already received one per line.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "soeconnection.hpp"
+#include "dbgprintf.h"
+
+void SerialOverEthernet::SOELinkHandlerCOM::resetGCode() {
+	this->gcodeLines.clear();
+	this->gcodeInFlight.clear();
+	this->gcodeScanned = this->gcodeSearched = this->gcodeAdmitted = this->gcodeInFlightBytes = 0;
+	this->gcodeUnacked = this->gcodeUnconfirmed = 0;
+	this->gcodeResponseState = GCODE_LINE_START;
+	this->gcodeResponseLine.clear();
+}
+
+bool SerialOverEthernet::SOELinkHandlerCOM::updateGCodeWindow() {
+
+	// split the newly received data into lines, only complete lines are acknowledged and admitted to the device
+	unsigned long buffered = this->serialData->dataBuffered();
+	while (true) {
+		long long int lineEnd = this->serialData->find('\n', this->gcodeSearched);
+		if (lineEnd < 0) {
+			// the search covered at least the data buffered before it started
+			this->gcodeSearched = buffered;
+			break;
+		}
+		this->gcodeLines.push_back((unsigned long) lineEnd + 1 - this->gcodeScanned);
+		this->gcodeScanned = this->gcodeSearched = (unsigned long) lineEnd + 1;
+		this->gcodeUnacked++;
+	}
+
+	// acknowledge the lines to the remote ahead of the device, so that it keeps sending while they wait here
+	if (!sendGCodeAcks()) return false;
+
+	// admit acknowledged lines as long as the device has room for them
+	unsigned int window = this->options.gcodeWindow;
+	if (window == 0) window = this->options.gcodeMode == SOE_GCODE_CHAR_COUNTING ? SOE_GCODE_DEFAULT_BYTES : SOE_GCODE_DEFAULT_LINES;
+	while (this->gcodeLines.size() > this->gcodeUnacked) {
+		unsigned long lineLen = this->gcodeLines.front();
+		if (this->options.gcodeMode == SOE_GCODE_CHAR_COUNTING) {
+			// an line longer than the receive buffer can only be written while the device is idle
+			if (!this->gcodeInFlight.empty() && this->gcodeInFlightBytes + lineLen > window) break;
+		} else {
+			if (this->gcodeInFlight.size() >= window) break;
+		}
+		this->gcodeLines.pop_front();
+		this->gcodeInFlight.push_back(lineLen);
+		this->gcodeInFlightBytes += lineLen;
+		this->gcodeAdmitted += lineLen;
+	}
+
+	// an incomplete line is passed trough unwindowed while the device is idle or if it fills the whole buffer,
+	// otherwise an last line without line end or an line longer than the buffer would never be admitted
+	// the rest of the line is still counted as an line once its end arrives, which the device confirms with one response
+	unsigned long partialLen = this->gcodeSearched - this->gcodeScanned;
+	if (partialLen > 0 && this->gcodeLines.empty() && (this->gcodeInFlight.empty() || this->serialData->free() == 0)) {
+		this->gcodeAdmitted += partialLen;
+		this->gcodeScanned = this->gcodeSearched;
+	}
+
+	return true;
+
+}
+
+void SerialOverEthernet::SOELinkHandlerCOM::gcodeWritten(unsigned long written) {
+	this->gcodeAdmitted -= written;
+	this->gcodeScanned -= written;
+	this->gcodeSearched -= written;
+}
+
+unsigned int SerialOverEthernet::SOELinkHandlerCOM::filterGCodeResponses(const char* input, unsigned int inputLen, char* output) {
+
+	// release the oldest line in the window, the remote was already acknowledged when it was received
+	auto confirmLine = [this]() {
+		this->gcodeInFlightBytes -= this->gcodeInFlight.front();
+		this->gcodeInFlight.pop_front();
+		if (this->gcodeUnconfirmed > 0) this->gcodeUnconfirmed--;
+	};
+
+	unsigned int outputLen = 0;
+	for (unsigned int i = 0; i < inputLen; i++) {
+		char c = input[i];
+
+		switch (this->gcodeResponseState) {
+		case GCODE_OK_EOL:
+			if (c == '\n') {
+				this->gcodeResponseState = GCODE_LINE_START;
+				continue;
+			}
+			// the line was only terminated by an carriage return, this already is the next line
+			this->gcodeResponseState = GCODE_LINE_START;
+			[[fallthrough]];
+		case GCODE_LINE_START:
+			this->gcodeResponseLine.push_back(c);
+			if (this->gcodeResponseLine.size() <= 2 && c != '\r' && c != '\n' && this->gcodeResponseLine.compare(0, std::string::npos, "ok", this->gcodeResponseLine.size()) == 0)
+				continue; // hold back, this might still become an "ok"
+			if (this->gcodeResponseLine.compare(0, 2, "ok") == 0 && !this->gcodeInFlight.empty()) {
+				confirmLine();
+				this->gcodeResponseLine.clear();
+				if (c == '\r') {
+					this->gcodeResponseState = GCODE_OK_EOL;
+				} else if (c == ' ') {
+					this->gcodeResponseState = GCODE_OK_STRIP;
+				} else if (c != '\n') {
+					output[outputLen++] = c;
+					this->gcodeResponseState = GCODE_LINE_PASS;
+				}
+				continue;
+			}
+			// not an acknowledgement (or none was expected), forward the held back bytes
+			memcpy(output + outputLen, this->gcodeResponseLine.data(), this->gcodeResponseLine.size());
+			outputLen += this->gcodeResponseLine.size();
+			this->gcodeResponseState = GCODE_LINE_PASS;
+			break;
+		case GCODE_OK_STRIP:
+			// additional data behind the "ok" (like temperatures) is forwarded without it
+			if (c == ' ') continue;
+			if (c == '\r') {
+				this->gcodeResponseState = GCODE_OK_EOL;
+				continue;
+			}
+			if (c == '\n') {
+				this->gcodeResponseState = GCODE_LINE_START;
+				continue;
+			}
+			this->gcodeResponseState = GCODE_LINE_PASS;
+			[[fallthrough]];
+		case GCODE_LINE_PASS:
+			output[outputLen++] = c;
+			if (this->gcodeResponseLine.size() < 8) this->gcodeResponseLine.push_back(c);
+			break;
+		}
+
+		if (c == '\n') {
+			// with character counting, an error also releases the line from the receive buffer of the device
+			if (this->options.gcodeMode == SOE_GCODE_CHAR_COUNTING && this->gcodeResponseLine.compare(0, 6, "error:") == 0 && !this->gcodeInFlight.empty())
+				confirmLine();
+			this->gcodeResponseLine.clear();
+			this->gcodeResponseState = GCODE_LINE_START;
+		}
+	}
+
+	return outputLen;
+
+}
+
+bool SerialOverEthernet::SOELinkHandlerCOM::sendGCodeAcks() {
+
+	// acknowledgements can not be inserted into an device line which is partially transmitted
+	if (this->gcodeResponseState != GCODE_LINE_START) return true;
+
+	unsigned int queue = this->options.gcodeQueue > 0 ? this->options.gcodeQueue : 1;
+	unsigned int ackCount = this->gcodeUnconfirmed >= queue ? 0 : std::min(this->gcodeUnacked, queue - this->gcodeUnconfirmed);
+
+	// the acknowledgements are transmitted as serial data, trough the frame buffer which is not in use outside of readSerialData()
+	unsigned int frameLimit = serialFrameLimit();
+	char* serialData = this->serialFrame.get() + SOE_SERIAL_FRAME_HEADROOM;
+	while (ackCount > 0) {
+		unsigned int len = 0;
+		for (; ackCount > 0 && len + 3 <= frameLimit; ackCount--) {
+			memcpy(serialData + len, "ok\n", 3);
+			len += 3;
+			this->gcodeUnacked--;
+			this->gcodeUnconfirmed++;
+		}
+
+		dbgprintf("[DBG] stream data: |gcode| -> [network] : %u acknowledgements\n", len / 3);
+
+		if (!sendSerialData(this->serialFrame.get(), len)) {
+			printf("[!] frame error, unable to transmit G-code acknowledgements\n");
+			return false;
+		}
+	}
+
+	return true;
+
+}
@@ -8,8 +8,6 @@
  *      Author: Marvin Koehler (M_Marvin)
  */
 
-#ifdef PLATFORM_WIN
-
 #include <string>
 #include "soeconnection.hpp"
 #include "dbgprintf.h"
@@ -42,7 +40,9 @@ bool SerialOverEthernet::SOELinkHandlerVCOM::setLocalConfig(const SerialAccess::
 
 void SerialOverEthernet::SOELinkHandlerVCOM::doSerialReception() {
 
-	char serialData[SOE_SERIAL_BUFFER_LEN] {0};
+	// read directly behind the space reserved for the frame header, so the data does not have to be copied for transmission
+	char serialFrame[SOE_TCP_FRAME_MAX_LEN];
+	char* serialData = serialFrame + SOE_SERIAL_FRAME_HEADROOM;
 
 	while (isAlive()) {
 
@@ -55,102 +55,89 @@ void SerialOverEthernet::SOELinkHandlerVCOM::doSerialReception() {
 			if (!isAlive()) break;
 		}
 
-		bool nothingToDo = this->serialData.dataAvailable() == 0;
+		bool nothingToDo = this->serialData->dataAvailable() == 0;
 
 		// try to write data from ring buffer to serial
 		{
 			// get how many bytes are available for transmission
-			unsigned long availableBytes = this->serialData.dataAvailable();
+			unsigned long availableBytes = this->serialData->dataAvailable();
 
 			// if data available (or pending)
 			if (availableBytes > 0) {
 
 				// start transfer or (if already pending) check status of last transfer
-				long long int written = this->localPort->writeBytes(this->serialData.dataStart(), availableBytes, false);
+				long long int written = this->localPort->writeBytes(this->serialData->dataStart(), availableBytes, false);
 				if (written < -1) {
+					this->stats.serialErrors++;
 					continue; // when port closed / timed out
 				}
 
 				if (written < 0) {
-					dbgprintf("[DBG] pending data: [serial] <- |network| : read segment: %lu bytes, free buffer: %lu bytes\n", availableBytes, this->serialData.free());
-
-					// the transmission buffer is to 75% full, send flow control signal
-					if (this->serialData.free() < (SOE_TCP_STREAM_BUFFER_LEN / 4) && this->remoteFlowEnable) {
-						printf("[i] send flow control to remote: txenbl = false\n");
-						sendFlowControl(this->remoteFlowEnable = false);
-					}
+					dbgprintf("[DBG] pending data: [serial] <- |network| : read segment: %lu bytes, free buffer: %lu bytes\n", availableBytes, this->serialData->free());
 
 					nothingToDo = true; // we need to wait for the data to be transmitted
 				} else {
-					dbgprintf("[DBG] stream data: [serial] <- |network| : >%.*s<\n", written, this->serialData.dataStart());
+					dbgprintf("[DBG] stream data: [serial] <- |network| : >%.*s<\n", written, this->serialData->dataStart());
 
 					// increment read position in buffer
-					this->serialData.pushRead(written);
+					this->serialData->pushRead(written);
+					if (this->options.latency) this->latency.dataWritten(written);
 
 					nothingToDo = false;
 				}
 
-			} else {
-				// if flow was disabled, reactivate now
-				if (!this->remoteFlowEnable) {
-					printf("[i] send flow control to remote: txenbl = true\n");
-					sendFlowControl(this->remoteFlowEnable = true);
-				}
 			}
 
+			// stop or resume the remote transmissions depending on the buffer fill level
+			updateRemoteFlowControl();
+
 		}
 
-		// try to read data from serial, unless the remote end disabled transmission of more data trough flow control
-		if (this->flowEnable) {
+		// try to read data from serial, unless the remote end disabled transmission of more data trough flow control or the link waits to be resumed
+		if (isSerialReadEnabled()) {
 
-			long long int read = this->localPort->readBytes(serialData, SOE_SERIAL_BUFFER_LEN, false);
+			long long int read = this->localPort->readBytes(serialData, serialFrameLimit(), false);
 
 			if (read < -1) {
+				this->stats.serialErrors++;
 				continue; // when port closed / timed out
 			}
 
-			if (read < 0) {
-				// if the read did not complete, wait for a brief moment and check status again, it might just need a few CPU cycles
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				read = this->localPort->readBytes(serialData, SOE_SERIAL_BUFFER_LEN, false);
-			}
+			// the completion of an pending read ends the next event wait, so there is no need to check again
 
 			if (read > 0) {
+				auto readTime = std::chrono::steady_clock::now();
 
 				dbgprintf("[DBG] stream data: |serial| -> [network] : >%.*s<\n", (unsigned int) read, serialData);
 
 				// send data to remote
-				if (!sendSerialData(serialData, (unsigned int) read)) {
+				if (!sendSerialData(serialFrame, (unsigned int) read)) {
 					printf("[!] frame error, unable to transmit serial data\n");
 					break;
 				}
+				if (this->options.latency) {
+					this->latency.serialToNetwork.record(std::chrono::steady_clock::now() - readTime);
+					// measure the round trip time while serial data is transmitted
+					if (!sendTimestamp()) break;
+				}
 
 				nothingToDo = false;
 			}
 
 		}
 
-		// halt after some cycles with no work
-		if (nothingToDo) {
-			this->txHaltCycles++;
-		} else {
-			this->txHaltCycles = 0;
-		}
-		bool doHalt = this->txHaltCycles > SOE_TX_HALT_CYCLE_LIMIT;
-
-		// check for COM state event and (if no thing else to do) wait for more data
+		// check for COM state event and (if nothing else to do) wait for the port, new network data or flow control changes
 		bool configChanged = true;
 		bool timeoutChanged = false;
 		bool comStateChanged = true;
-		bool dataReceived = true;
-		bool dataTransmitted = !this->remoteFlowEnable;
-		if (!this->localPort->waitForEvents(configChanged, timeoutChanged, comStateChanged, dataReceived, dataTransmitted, doHalt)) {
-			if (doHalt) this->txHaltCycles = 0;
+		bool dataReceived = isSerialReadEnabled();
+		bool dataTransmitted = this->serialData->dataAvailable() > 0;
+		if (nothingToDo && this->txWakeup.exchange(false)) nothingToDo = false;
+		if (!this->localPort->waitForEvents(configChanged, timeoutChanged, comStateChanged, dataReceived, dataTransmitted, nothingToDo)) {
 			continue; // when port closed / timed out / wait aborted
 		}
-		if (doHalt) this->txHaltCycles = 0;
 
-		if (comStateChanged) {
+		if (comStateChanged || this->portStateLost.exchange(false)) {
 			// notify remote port about changed COM state
 			bool dsrState, ctsState;
 			if (!this->localPort->getPortState(dsrState, ctsState)) {
@@ -179,7 +166,7 @@ void SerialOverEthernet::SOELinkHandlerVCOM::doSerialReception() {
 
 			dbgprintf("[DBG] stream port config: |serial| -> [network] (baud %u)\n", config.baudRate);
 
-			if (!sendRemoteConfig(config)) {
+			if (transmitRequest([this, &config](int request) { return sendRemoteConfig(config, request); }, false) < 0) {
 				printf("[!] frame error, unable to transmit serial configuration\n");
 				break;
 			}
@@ -196,11 +183,7 @@ void SerialOverEthernet::SOELinkHandlerVCOM::transmitSerialData(const char* data
 
 	SOELinkHandler::transmitSerialData(data, len);
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
 
 }
 
@@ -210,11 +193,7 @@ void SerialOverEthernet::SOELinkHandlerVCOM::updateFlowControl(bool enableTransm
 
 	SOELinkHandler::updateFlowControl(enableTransmit);
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
 
 }
 
@@ -224,14 +203,17 @@ void SerialOverEthernet::SOELinkHandlerVCOM::updatePortState(bool dtr, bool rts)
 
 	if (!this->localPort->setManualPortState(dtr, rts)) {
 		printf("[!] unable to apply port state from remote!\n");
+		this->stats.serialErrors++;
 	}
 
-	// kick the TX thread out of waiting state if it was waiting
-	if (this->txHaltCycles) {
-		this->txHaltCycles = 0;
-		this->localPort->abortWait();
-	}
+	wakeupSerial();
 
 }
 
-#endif
+void SerialOverEthernet::SOELinkHandlerVCOM::wakeupSerial() {
+
+	// kick the TX thread out of waiting state, or keep it from entering it if it is about to
+	this->txWakeup = true;
+	if (this->localPort != 0) this->localPort->abortWait();
+
+}
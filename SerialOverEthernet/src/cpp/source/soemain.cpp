@@ -10,56 +10,334 @@
 
 #include <iostream>
 #include <algorithm>
+#include <map>
 #include "soemain.hpp"
+#include "soedatagram.hpp"
 #include "dbgprintf.h"
 
+#ifdef PLATFORM_LIN
+#include <signal.h>
+#endif
+
 static std::mutex m_clientConnections;
 static std::condition_variable cv_clientConnections;
 static std::vector<SerialOverEthernet::SOELinkHandler*> clientConnections;
+static std::vector<std::shared_ptr<SerialOverEthernet::SOEConnection>> networkConnections;
+static std::map<std::string, std::weak_ptr<SerialOverEthernet::SOEConnection>> linkedHosts;
+static std::map<std::string, std::mutex> m_linkedHosts;
+static SerialOverEthernet::SOEReactor* reactor = nullptr;
+static SerialOverEthernet::SOELinkOptions linkOptions = SerialOverEthernet::DEFAULT_LINK_OPTIONS;
 
 void cleanupDeadConnectionHandlers() {
+	std::vector<SerialOverEthernet::SOELinkHandler*> deadHandlers;
+	std::vector<std::shared_ptr<SerialOverEthernet::SOEConnection>> deadConnections;
+	{
+		std::lock_guard<std::mutex> lock(m_clientConnections);
+		clientConnections.erase(std::remove_if(clientConnections.begin(), clientConnections.end(), [&deadHandlers](SerialOverEthernet::SOELinkHandler* managedHandler){
+			if (!managedHandler->isAlive()) {
+				deadHandlers.push_back(managedHandler);
+				return true;
+			}
+			return false;
+		}), clientConnections.end());
+		networkConnections.erase(std::remove_if(networkConnections.begin(), networkConnections.end(), [&deadConnections](std::shared_ptr<SerialOverEthernet::SOEConnection>& connection){
+			if (!connection->isAlive()) {
+				deadConnections.push_back(connection);
+				return true;
+			}
+			return false;
+		}), networkConnections.end());
+	}
+
+	// the reception thread of an connection might be about to create an new handler, so this must not happen while the list is locked
+	for (SerialOverEthernet::SOELinkHandler* managedHandler : deadHandlers) {
+		managedHandler->stop();
+		delete managedHandler;
+	}
+	SerialOverEthernet::SOEConnection::releaseDeferred();
+}
+
+void printLatencyReport(FILE* output) {
 	std::lock_guard<std::mutex> lock(m_clientConnections);
-	clientConnections.erase(std::remove_if(clientConnections.begin(), clientConnections.end(), [](SerialOverEthernet::SOELinkHandler* managedHandler){
-		if (!managedHandler->isAlive()) {
-			managedHandler->stop();
-			delete managedHandler;
-			return true;
+	for (SerialOverEthernet::SOELinkHandler* managedHandler : clientConnections)
+		managedHandler->printLatency(output);
+}
+
+void startLatencyReports() {
+#ifdef PLATFORM_LIN
+	// the signal is only accepted by the report thread, so it has to be blocked before any other thread is started
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+	printf("[i] latency measurement enabled, send SIGUSR1 to print the histograms\n");
+#else
+	printf("[i] latency measurement enabled\n");
+#endif
+
+	std::thread([=]() -> void {
+		while (true) {
+#ifdef PLATFORM_LIN
+			timespec timeout = { (time_t) (linkOptions.latencyInterval / 1000), (long) (linkOptions.latencyInterval % 1000) * 1000000L };
+			if (sigtimedwait(&signals, nullptr, &timeout) == SIGUSR1) {
+				printLatencyReport(stdout);
+				continue;
+			}
+#else
+			std::this_thread::sleep_for(std::chrono::milliseconds(linkOptions.latencyInterval));
+#endif
+			if (linkOptions.latencyFile.empty()) continue;
+
+			// replace the report, so that the file always contains the latest histograms
+			FILE* report = fopen(linkOptions.latencyFile.c_str(), "w");
+			if (report == nullptr) {
+				printf("[!] unable to write latency report: %s\n", linkOptions.latencyFile.c_str());
+				continue;
+			}
+			printLatencyReport(report);
+			fclose(report);
 		}
-		return false;
-	}), clientConnections.end());
+	}).detach();
+}
+
+static std::string escapeLabel(const std::string& value) {
+	std::string escaped;
+	for (char c : value) {
+		if (c == '\\' || c == '"') escaped += '\\';
+		if (c == '\n') {
+			escaped += "\\n";
+			continue;
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+std::string formatStats() {
+
+	typedef struct Metric {
+		const char* name;
+		const char* type;
+		const char* help;
+		std::function<unsigned long long(SerialOverEthernet::SOELinkHandler*)> value;
+	} Metric;
+
+	static const Metric metrics[] = {
+		{ "soe_link_tx_serial_bytes_total", "counter", "Serial data bytes transmitted to the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().txSerialBytes.load(std::memory_order_relaxed); } },
+		{ "soe_link_tx_serial_frames_total", "counter", "Serial data frames transmitted to the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().txSerialFrames.load(std::memory_order_relaxed); } },
+		{ "soe_link_rx_serial_bytes_total", "counter", "Serial data bytes received from the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().rxSerialBytes.load(std::memory_order_relaxed); } },
+		{ "soe_link_rx_serial_frames_total", "counter", "Serial data frames received from the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().rxSerialFrames.load(std::memory_order_relaxed); } },
+		{ "soe_link_tx_frames_total", "counter", "Frames of any kind transmitted to the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().txFrames.load(std::memory_order_relaxed); } },
+		{ "soe_link_tx_socket_sends_total", "counter", "Socket send calls issued for the transmitted frames.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().txSends.load(std::memory_order_relaxed); } },
+		{ "soe_link_flow_control_toggles_total", "counter", "Flow control signals sent to the remote.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().flowControlToggles.load(std::memory_order_relaxed); } },
+		{ "soe_link_serial_errors_total", "counter", "Failed serial port operations and stream buffer overflows.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().serialErrors.load(std::memory_order_relaxed); } },
+		{ "soe_link_resumes_total", "counter", "Times the link was resumed on an new connection.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().resumes.load(std::memory_order_relaxed); } },
+		{ "soe_link_buffer_bytes", "gauge", "Network data waiting to be written to serial.", [](SerialOverEthernet::SOELinkHandler* link) { return (unsigned long long) link->getStreamBuffer().dataBuffered(); } },
+		{ "soe_link_buffer_high_water_bytes", "gauge", "Highest amount of network data waiting to be written to serial.", [](SerialOverEthernet::SOELinkHandler* link) { return link->getStats().bufferHighWater.load(std::memory_order_relaxed); } },
+		{ "soe_link_buffer_capacity_bytes", "gauge", "Capacity of the buffer for network data waiting to be written to serial.", [](SerialOverEthernet::SOELinkHandler* link) { return (unsigned long long) link->getStreamBuffer().capacity(); } }
+	};
+
+	std::lock_guard<std::mutex> lock(m_clientConnections);
+
+	// the labels identify the link, the counters of closed links disappear together with the link
+	std::vector<std::pair<std::string, SerialOverEthernet::SOELinkHandler*>> links;
+	for (SerialOverEthernet::SOELinkHandler* managedHandler : clientConnections) {
+		if (!managedHandler->isAlive()) continue;
+		unsigned char channel;
+		std::shared_ptr<SerialOverEthernet::SOEConnection> connection = managedHandler->getConnection(&channel);
+		std::string labels =
+				"local=\"" + escapeLabel(managedHandler->getLocalPortName()) +
+				"\",remote=\"" + escapeLabel(managedHandler->getRemotePortName()) +
+				"\",host=\"" + escapeLabel(connection->getHostName() + "/" + connection->getHostPort()) +
+				"\",channel=\"" + std::to_string(channel) + "\"";
+		links.emplace_back(labels, managedHandler);
+	}
+
+	std::string output;
+	output += "# HELP soe_links Links currently established.\n# TYPE soe_links gauge\n";
+	output += "soe_links " + std::to_string(links.size()) + "\n";
+	for (const Metric& metric : metrics) {
+		output += std::string("# HELP ") + metric.name + " " + metric.help + "\n";
+		output += std::string("# TYPE ") + metric.name + " " + metric.type + "\n";
+		for (auto& link : links)
+			output += std::string(metric.name) + "{" + link.first + "} " + std::to_string(metric.value(link.second)) + "\n";
+	}
+	return output;
+
+}
+
+bool startStatsServer() {
+
+	// the statistics are only available locally, they are not protected in any way
+	std::vector<NetSocket::INetAddress> localAddresses;
+	NetSocket::resolveInet("localhost", linkOptions.statsPort, true, localAddresses);
+
+	NetSocket::Socket* statsSocket = NetSocket::newSocket();
+	for (NetSocket::INetAddress& address : localAddresses) {
+
+		if (!statsSocket->listen(address)) continue;
+
+		std::string localAddress;
+		unsigned int localPort;
+		address.tostr(localAddress, &localPort);
+		printf("[i] serving link statistics on: %s/%d\n", localAddress.c_str(), localPort);
+
+		std::thread([statsSocket]() -> void {
+			while (statsSocket->isOpen()) {
+				std::unique_ptr<NetSocket::Socket> clientSocket(NetSocket::newSocket());
+				if (!statsSocket->accept(*clientSocket)) continue;
+				clientSocket->setTimeouts(SOE_TCP_HANDSHAKE_TIMEOUT, SOE_TCP_HANDSHAKE_TIMEOUT);
+
+				// read until the end of the request header, all requests are answered with the statistics
+				std::string request;
+				char buffer[1024];
+				while (request.find("\r\n\r\n") == std::string::npos && request.length() < sizeof(buffer) * 4) {
+					unsigned int received = 0;
+					if (!clientSocket->receive(buffer, sizeof(buffer), &received) || received == 0) break;
+					request.append(buffer, received);
+				}
+
+				std::string body = formatStats();
+				std::string response =
+						"HTTP/1.0 200 OK\r\n"
+						"Content-Type: text/plain; version=0.0.4\r\n"
+						"Content-Length: " + std::to_string(body.length()) + "\r\n"
+						"Connection: close\r\n\r\n" + body;
+				if (!clientSocket->send(response.c_str(), (unsigned int) response.length())) {
+					dbgprintf("[DBG] unable to send statistics response\n");
+				}
+				clientSocket->close();
+			}
+			delete statsSocket;
+		}).detach();
+		return true;
+
+	}
+	printf("[!] unable to open statistics port: %s\n", linkOptions.statsPort.c_str());
+	delete statsSocket;
+	return false;
+
 }
 
-SerialOverEthernet::SOELinkHandler* createConnectionHandler(NetSocket::Socket* unmanagedSocket, std::string socketHostName, std::string socketHostPort, bool virtualMode) {
+NetSocket::Socket* newTransportSocket() {
+	if (linkOptions.transport == SOE_TRANSPORT_UDP)
+		return new SerialOverEthernet::SOEDatagramSocket();
+	return NetSocket::newSocket();
+}
+
+std::shared_ptr<SerialOverEthernet::SOEConnection> createNetworkConnection(NetSocket::Socket* unmanagedSocket, std::string socketHostName, std::string socketHostPort, bool serverMode) {
 	std::lock_guard<std::mutex> lock(m_clientConnections);
-	dbgprintf("[DBG] create handler for: %s/%s\n", socketHostName.c_str(), socketHostPort.c_str());
+	dbgprintf("[DBG] create connection for: %s/%s\n", socketHostName.c_str(), socketHostPort.c_str());
+	std::function<SerialOverEthernet::SOELinkHandler*(std::shared_ptr<SerialOverEthernet::SOEConnection>, unsigned char)> onNewChannel;
+	std::function<bool(std::shared_ptr<SerialOverEthernet::SOEConnection>, unsigned char, unsigned long long, unsigned long long)> onResumeChannel;
+	if (serverMode) {
+		// the client opens the channels, each one gets an link for the requested port
+		onNewChannel = [](std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel) {
+			return createConnectionHandler(connection, channel, false);
+		};
+		// or resumes an link of an lost connection on them
+		onResumeChannel = [](std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel, unsigned long long session, unsigned long long remoteReceived) {
+			// the list stays locked, so that the link is not deleted if its resume timeout expires in between
+			std::lock_guard<std::mutex> lock(m_clientConnections);
+			for (SerialOverEthernet::SOELinkHandler* managedHandler : clientConnections) {
+				if (session != 0 && managedHandler->getSession() == session && managedHandler->isAlive())
+					return managedHandler->acceptSession(connection, channel, remoteReceived);
+			}
+			return false;
+		};
+	}
+	std::shared_ptr<SerialOverEthernet::SOEConnection> connection = std::make_shared<SerialOverEthernet::SOEConnection>(unmanagedSocket, socketHostName, socketHostPort, linkOptions.bufferSize, onNewChannel, onResumeChannel);
+	networkConnections.push_back(connection);
+	return connection;
+}
+
+SerialOverEthernet::SOELinkHandler* createConnectionHandler(std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel, bool virtualMode) {
+	std::lock_guard<std::mutex> lock(m_clientConnections);
+	dbgprintf("[DBG] create handler for: %s/%s (channel %u)\n", connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
 	SerialOverEthernet::SOELinkHandler* managedHandler;
 	if (virtualMode) {
-#ifdef PLATFORM_WIN
-		managedHandler = new SerialOverEthernet::SOELinkHandlerVCOM(unmanagedSocket, socketHostName, socketHostPort, [](SerialOverEthernet::SOELinkHandler* managedHandler) {
-			cv_clientConnections.notify_one(); // try to run the cleanup of closed handlers if not in server mode
-		});
-#else
-		printf("[!] VIRTUAL PORT MODE NOT YET SUPPORTED ON PLATFORMS OTHER THAN WINDOWS\n");
-		managedHandler = new SerialOverEthernet::SOELinkHandlerCOM(unmanagedSocket, socketHostName, socketHostPort, [](SerialOverEthernet::SOELinkHandler* managedHandler) {
+		managedHandler = new SerialOverEthernet::SOELinkHandlerVCOM(connection, channel, [](SerialOverEthernet::SOELinkHandler* /*managedHandler*/) {
 			cv_clientConnections.notify_one(); // try to run the cleanup of closed handlers if not in server mode
 		});
-#endif
 	} else {
-		managedHandler = new SerialOverEthernet::SOELinkHandlerCOM(unmanagedSocket, socketHostName, socketHostPort, [](SerialOverEthernet::SOELinkHandler* managedHandler) {
+		managedHandler = new SerialOverEthernet::SOELinkHandlerCOM(connection, channel, [](SerialOverEthernet::SOELinkHandler* /*managedHandler*/) {
 			cv_clientConnections.notify_one(); // try to run the cleanup of closed handlers if not in server mode
 		});
 	}
 	clientConnections.push_back(managedHandler);
-	managedHandler->start();
+	managedHandler->setOptions(linkOptions);
+	// virtual ports are always serviced by an dedicated thread
+	managedHandler->start(virtualMode ? nullptr : reactor);
 	return managedHandler;
 }
 
-bool linkRemotePort(std::string& remoteHost, std::string& remotePort, std::string& remoteSerial, std::string& localSerial, SerialAccess::SerialPortConfiguration& remoteConfig, SerialAccess::SerialPortConfiguration& localConfig, bool virtualMode) {
-	std::vector<NetSocket::INetAddress> addresses;
-	NetSocket::resolveInet(remoteHost, remotePort, true, addresses);
-	NetSocket::Socket* clientSocket = NetSocket::newSocket();
+bool setupLink(SerialOverEthernet::SOELinkHandler* handler, std::string& remoteSerial, std::string& localSerial, SerialAccess::SerialPortConfiguration& remoteConfig, SerialAccess::SerialPortConfiguration& localConfig) {
 
-	printf("[i] establishing link: %s <-> %s @ %s/%s\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str());
+	// send all remote requests at once, the local port is opened while they are in flight
+	int openRequest = handler->requestRemoteOpen(remoteSerial);
+	int configRequest = openRequest < 0 ? -1 : handler->requestRemoteConfig(remoteConfig);
+	int sessionRequest = configRequest < 0 ? -1 : handler->requestSession();
+	bool localOpened = handler->openLocalPort(localSerial);
+	bool localConfigured = localOpened && handler->setLocalConfig(localConfig);
+
+	// the pending remote requests fail with the link
+	if (!localOpened) {
+		printf("[!] failed to open local port: %s\n", localSerial.c_str());
+		handler->shutdown();
+		return false;
+	}
+	if (!localConfigured) {
+		printf("[!] failed to configure local port: %s\n", localSerial.c_str());
+		handler->shutdown();
+		return false;
+	}
+
+	int result = handler->awaitRequest(openRequest);
+	if (result != 1) {
+		if (result < 0)
+			printf("[!] handshake timed out, failed to open port: %s\n", remoteSerial.c_str());
+		printf("[!] failed to open remote port: %s\n", remoteSerial.c_str());
+		handler->shutdown();
+		return false;
+	}
+	result = handler->awaitRequest(configRequest);
+	if (result != 1) {
+		if (result < 0)
+			printf("[!] handshake timed out, failed to change configuration: %s\n", remoteSerial.c_str());
+		printf("[!] failed to configure remote port: %s\n", remoteSerial.c_str());
+		handler->shutdown();
+		return false;
+	}
+	handler->awaitSession(sessionRequest);
+	return true;
+}
+
+std::shared_ptr<SerialOverEthernet::SOEConnection> connectRemoteHost(std::string& remoteHost, std::string& remotePort, int& channel) {
+
+	// links to the same host share one connection, if the remote supports channels
+	std::string linkedHost = remoteHost + "/" + remotePort;
+	std::shared_ptr<SerialOverEthernet::SOEConnection> connection;
+	std::mutex* m_linkedHost;
+	{
+		std::lock_guard<std::mutex> lock(m_clientConnections);
+		auto entry = linkedHosts.find(linkedHost);
+		if (entry != linkedHosts.end()) connection = entry->second.lock();
+		m_linkedHost = &m_linkedHosts[linkedHost];
+	}
+
+	// links set up concurrently wait for the first one to connect, instead of opening an connection each
+	std::lock_guard<std::mutex> hostLock(*m_linkedHost);
+	if (connection == nullptr) {
+		std::lock_guard<std::mutex> lock(m_clientConnections);
+		auto entry = linkedHosts.find(linkedHost);
+		if (entry != linkedHosts.end()) connection = entry->second.lock();
+	}
+	channel = connection != nullptr && connection->isAlive() ? connection->allocateChannel() : -1;
+	if (channel >= 0) return connection;
+
+	std::vector<NetSocket::INetAddress> addresses;
+	NetSocket::resolveInet(remoteHost, remotePort, linkOptions.transport == SOE_TRANSPORT_TCP, addresses);
+	NetSocket::Socket* clientSocket = newTransportSocket();
 
 	for (auto address : addresses) {
 
@@ -76,46 +354,86 @@ bool linkRemotePort(std::string& remoteHost, std::string& remotePort, std::strin
 
 		dbgprintf("[DBG] connect succeded at: %s/%s\n", serverHostName.c_str(), serverHostPortStr.c_str());
 
-		// create connection handler, try to apply configurations
-		SerialOverEthernet::SOELinkHandler* handler = createConnectionHandler(clientSocket, serverHostName, serverHostPortStr, virtualMode);
-		if (!handler->openRemotePort(remoteSerial)) {
-			printf("[!] failed to open remote port: %s\n", remoteSerial.c_str());
-			handler->shutdown();
-			return false;
-		}
-		if (!handler->setRemoteConfig(remoteConfig)) {
-			printf("[!] failed to configure remote port: %s\n", remoteSerial.c_str());
-			handler->shutdown();
-			return false;
-		}
-		if (!handler->openLocalPort(localSerial)) {
-			printf("[!] failed to open local port: %s\n", localSerial.c_str());
-			handler->shutdown();
-			return false;
-		}
-		if (!handler->setLocalConfig(localConfig)) {
-			printf("[!] failed to configure local port: %s\n", localSerial.c_str());
-			handler->shutdown();
-			return false;
+		// create and start connection, the first channel is always available
+		connection = createNetworkConnection(clientSocket, serverHostName, serverHostPortStr, false);
+		channel = connection->allocateChannel();
+		connection->start();
+
+		// the frame limit answer tells if the remote supports channels, which the following links have to know
+		if (!connection->awaitFrameLimit()) {
+			dbgprintf("[DBG] no frame limit received from: %s/%s\n", serverHostName.c_str(), serverHostPortStr.c_str());
 		}
 
-		printf("[i] link established: %s <-> %s @ %s/%s (%s/%s)\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str(), serverHostName.c_str(), serverHostPortStr.c_str());
-		return true;
+		{
+			std::lock_guard<std::mutex> lock(m_clientConnections);
+			linkedHosts[linkedHost] = connection;
+		}
+		return connection;
 
 	}
 	clientSocket->close();
-	printf("[i] unable to established link: %s <-> %s @ %s/%s\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str());
-	return false;
+	delete clientSocket;
+	return nullptr;
+
 }
 
-int runMain(std::string& serverHostName, std::string& serverHostPort, std::vector<std::string>& linkArgs) {
+bool linkRemotePort(std::string& remoteHost, std::string& remotePort, std::string& remoteSerial, std::string& localSerial, SerialAccess::SerialPortConfiguration& remoteConfig, SerialAccess::SerialPortConfiguration& localConfig, bool virtualMode) {
+	printf("[i] establishing link: %s <-> %s @ %s/%s\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str());
+
+	int channel;
+	std::shared_ptr<SerialOverEthernet::SOEConnection> connection = connectRemoteHost(remoteHost, remotePort, channel);
+	if (connection == nullptr) {
+		printf("[i] unable to established link: %s <-> %s @ %s/%s\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str());
+		return false;
+	}
+
+	// after an lost connection, the link is resumed on an new connection to the same host
+	SerialOverEthernet::SOELinkHandler* handler = createConnectionHandler(connection, (unsigned char) channel, virtualMode);
+	std::string host = remoteHost, port = remotePort;
+	handler->setReconnect([host, port](SerialOverEthernet::SOELinkHandler* handler) mutable {
+		int channel;
+		std::shared_ptr<SerialOverEthernet::SOEConnection> connection = connectRemoteHost(host, port, channel);
+		return connection != nullptr && handler->resumeSession(connection, (unsigned char) channel);
+	});
+
+	// try to apply configurations
+	if (!setupLink(handler, remoteSerial, localSerial, remoteConfig, localConfig))
+		return false;
+
+	printf("[i] link established: %s <-> %s @ %s/%s (%s/%s channel %d)\n", localSerial.c_str(), remoteSerial.c_str(), remoteHost.c_str(), remotePort.c_str(), connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
+	return true;
+}
+
+int runMain(std::string& serverHostName, std::string& serverHostPort, unsigned int reactorThreads, const SerialOverEthernet::SOELinkOptions& options, std::vector<std::string>& linkArgs) {
 	
+	linkOptions = options;
+
 	// initialize networking
 	if (!NetSocket::InetInit()) {
 		printf("[!] failed to initialize network!\n");
 		return -1;
 	}
 
+	// start latency reports if requested, before any other thread is started
+	if (linkOptions.latency)
+		startLatencyReports();
+
+	// serve link statistics if requested
+	if (!linkOptions.statsPort.empty() && !startStatsServer()) {
+		NetSocket::InetCleanup();
+		return -1;
+	}
+
+	// start reactor threads if requested, which then service all links
+	if (reactorThreads > 0) {
+#ifdef PLATFORM_LIN
+		printf("[i] reactor mode, servicing serial ports from %u threads\n", reactorThreads);
+		reactor = new SerialOverEthernet::SOEReactor(reactorThreads);
+#else
+		printf("[!] REACTOR MODE NOT YET SUPPORTED ON PLATFORMS OTHER THAN LINUX\n");
+#endif
+	}
+
 	// parse additional link flags, triggering client connection handshakes and setup
 	interpretFlags(linkArgs);
 
@@ -134,10 +452,10 @@ int runMain(std::string& serverHostName, std::string& serverHostPort, std::vecto
 
 		// resolve supplied host string
 		std::vector<NetSocket::INetAddress> localAddresses;
-		NetSocket::resolveInet(serverHostName, serverHostPort, true, localAddresses);
+		NetSocket::resolveInet(serverHostName, serverHostPort, linkOptions.transport == SOE_TRANSPORT_TCP, localAddresses);
 
 		// attempt to bind to first available local host address
-		NetSocket::Socket* serverSocket = NetSocket::newSocket();
+		NetSocket::Socket* serverSocket = newTransportSocket();
 		for (NetSocket::INetAddress& address : localAddresses) {
 
 			std::string localAddress;
@@ -153,7 +471,7 @@ int runMain(std::string& serverHostName, std::string& serverHostPort, std::vecto
 					// this has to run every now and then to get rid of closed connection handlers
 					cleanupDeadConnectionHandlers();
 
-					NetSocket::Socket* clientSocket = NetSocket::newSocket();
+					NetSocket::Socket* clientSocket = newTransportSocket();
 					if (serverSocket->accept(*clientSocket)) {
 
 						std::string clientHostName = "N/A";
@@ -168,8 +486,8 @@ int runMain(std::string& serverHostName, std::string& serverHostPort, std::vecto
 
 						printf("[i] incomming connection request: %s/%s\n", clientHostName.c_str(), clientHostPort.c_str());
 
-						// create handler for connection and make new socket for next request
-						createConnectionHandler(clientSocket, clientHostName, clientHostPort, false);
+						// create connection, the handlers are created when the client opens its channels, make new socket for next request
+						createNetworkConnection(clientSocket, clientHostName, clientHostPort, true)->start();
 						continue;
 
 					}
@@ -188,6 +506,15 @@ int runMain(std::string& serverHostName, std::string& serverHostPort, std::vecto
 
 	}
 
+	// stop reactor, all links are terminated at this point
+#ifdef PLATFORM_LIN
+	if (reactor != nullptr) {
+		cleanupDeadConnectionHandlers();
+		delete reactor;
+		reactor = nullptr;
+	}
+#endif
+
 	// cleanup network and exit
 	NetSocket::InetCleanup();
 	printf("[i] client shutdown complete\n");
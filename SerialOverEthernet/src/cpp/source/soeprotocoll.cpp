@@ -20,13 +20,56 @@
 #define SOE_TCP_OPC_STREAM_SERIAL 0x40
 #define SOE_TCP_OPC_FLOW_CONTROL 0x50
 #define SOE_TCP_OPC_PORT_STATE 0x60
+#define SOE_TCP_OPC_FRAME_LIMIT 0x70
+#define SOE_TCP_OPC_CLOSE_CHANNEL 0x80
+#define SOE_TCP_OPC_TIMESTAMP 0x90
+#define SOE_TCP_OPC_TIMESTAMP_ECHO 0x91
+#define SOE_TCP_OPC_SESSION 0xA0
+#define SOE_TCP_OPC_RESUME 0xA1
+#define SOE_TCP_OPC_ACKNOWLEDGE 0xA2
+
+static void writeLongLong(char* buffer, unsigned long long value) {
+	for (unsigned char i = 0; i < 8; i++)
+		buffer[i] = (value >> (56 - i * 8)) & 0xFF;
+}
+
+static unsigned long long readLongLong(const char* buffer) {
+	unsigned long long value = 0;
+	for (unsigned char i = 0; i < 8; i++)
+		value = (value << 8) | (buffer[i] & 0xFF);
+	return value;
+}
+
+static void writeRequestId(char* buffer, int request) {
+	buffer[0] = (request >> 8) & 0xFF;
+	buffer[1] = (request >> 0) & 0xFF;
+}
+
+static int readRequestId(const char* buffer) {
+	return (buffer[0] & 0xFF) << 8 | (buffer[1] & 0xFF);
+}
+
+bool SerialOverEthernet::SOEConnection::processPackage(unsigned char channel, const char* package, unsigned int packageLen) {
+
+	if (packageLen == 0)
+		return deliverPackage(channel, package, packageLen, false);
+
+	switch ((unsigned char) package[0]) {
+	case SOE_TCP_OPC_FRAME_LIMIT:		return processFrameLimit(package, packageLen);
+	case SOE_TCP_OPC_CLOSE_CHANNEL:		return processCloseChannel(channel);
+	case SOE_TCP_OPC_OPEN_PORT:			return deliverPackage(channel, package, packageLen, true);
+	case SOE_TCP_OPC_RESUME:			return this->onResumeChannel ? processResume(channel, package, packageLen) : deliverPackage(channel, package, packageLen, false);
+	default: 							return deliverPackage(channel, package, packageLen, false);
+	}
+
+}
 
 bool SerialOverEthernet::SOELinkHandler::processPackage(const char* package, unsigned int packageLen) {
 
 	if (packageLen == 0)
 		return sendError("no package payload");
 
-	switch (package[0]) {
+	switch ((unsigned char) package[0]) {
 	case SOE_TCP_OPC_STREAM_SERIAL:		return processSerialData(package, packageLen);
 	case SOE_TCP_OPC_ERROR: 			return processError(package, packageLen);
 	case SOE_TCP_OPC_CONFIRM:			return processConfirm(package, packageLen);
@@ -35,17 +78,22 @@ bool SerialOverEthernet::SOELinkHandler::processPackage(const char* package, uns
 	case SOE_TCP_OPC_CONFIGURE_PORT: 	return processRemoteConfig(package, packageLen);
 	case SOE_TCP_OPC_FLOW_CONTROL:		return processFlowControl(package, packageLen);
 	case SOE_TCP_OPC_PORT_STATE:		return processPortState(package, packageLen);
+	case SOE_TCP_OPC_TIMESTAMP:			return processTimestamp(package, packageLen);
+	case SOE_TCP_OPC_TIMESTAMP_ECHO:	return processTimestampEcho(package, packageLen);
+	case SOE_TCP_OPC_SESSION:			return processSession(package, packageLen);
+	case SOE_TCP_OPC_RESUME:			return processResume(package, packageLen);
+	case SOE_TCP_OPC_ACKNOWLEDGE:		return processAcknowledge(package, packageLen);
 	default: 							return sendError("undefined package code: " + std::to_string(package[0]));
 	}
 
 }
 
 bool SerialOverEthernet::SOELinkHandler::sendError(const std::string& message) {
-	char package[message.length() + 1] {0};
-	package[0] = SOE_TCP_OPC_ERROR;
-	memcpy(package + 1, message.c_str(), (size_t) message.length());
+	char opcode = SOE_TCP_OPC_ERROR;
+	const char* segments[] = { &opcode, message.c_str() };
+	unsigned int segmentLens[] = { 1, (unsigned int) message.length() };
 
-	return transmitPackage(package, (unsigned int) message.length() + 1);
+	return transmitPackage(segments, segmentLens, 2);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processError(const char* package, unsigned int packageLen) {
@@ -56,30 +104,46 @@ bool SerialOverEthernet::SOELinkHandler::processError(const char* package, unsig
 	return true;
 }
 
-bool SerialOverEthernet::SOELinkHandler::sendConfirm(bool status) {
-	char package[] = { SOE_TCP_OPC_CONFIRM, status ? (char) 0x1 : (char) 0x0 };
+bool SerialOverEthernet::SOELinkHandler::sendConfirm(bool status, int request) {
+	// the id of the request is only added if the request carried one
+	char package[4] { SOE_TCP_OPC_CONFIRM, status ? (char) 0x1 : (char) 0x0 };
+	if (request < 0) return transmitPackage(package, 2);
+	writeRequestId(package + 2, request);
 
-	return transmitPackage(package, 2);
+	return transmitPackage(package, 4);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processConfirm(const char* package, unsigned int packageLen) {
 	if (packageLen < 2) return false;
-	std::unique_lock<std::mutex> lock(this->m_remoteReturn);
-	this->remoteReturn = package[1] == 0x1;
-	lock.unlock();
-	this->cv_remoteReturn.notify_all();
+
+	// confirms without id answer the oldest pending request, the remote processes them in order
+	int request = packageLen >= 4 ? readRequestId(package + 2) : -1;
+	completeRequest(request, package[1] == 0x1);
 	return true;
 }
 
-bool SerialOverEthernet::SOELinkHandler::sendRemoteOpen(const std::string& remoteSerial) {
-	char package[remoteSerial.length() + 1] {0};
-	package[0] = SOE_TCP_OPC_OPEN_PORT;
-	memcpy(package + 1, remoteSerial.c_str(), (size_t) remoteSerial.length());
+bool SerialOverEthernet::SOELinkHandler::sendRemoteOpen(const std::string& remoteSerial, int request) {
+	// the port name fills the rest of the package, so the id is put in front of it if the remote expects one
+	char header[3] { SOE_TCP_OPC_OPEN_PORT };
+	unsigned int headerLen = 1;
+	if (getConnection()->supportsRequestIds()) {
+		writeRequestId(header + 1, request);
+		headerLen = 3;
+	}
+	const char* segments[] = { header, remoteSerial.c_str() };
+	unsigned int segmentLens[] = { headerLen, (unsigned int) remoteSerial.length() };
 
-	return transmitPackage(package, (unsigned int) remoteSerial.length() + 1);
+	return transmitPackage(segments, segmentLens, 2);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processRemoteOpen(const char* package, unsigned int packageLen) {
+	int request = -1;
+	if (getConnection()->supportsRequestIds()) {
+		if (packageLen < 3) return false;
+		request = readRequestId(package + 1);
+		package += 2;
+		packageLen -= 2;
+	}
 	if (packageLen < 2) return false;
 	std::string portName(package + 1, packageLen - 1);
 
@@ -87,33 +151,37 @@ bool SerialOverEthernet::SOELinkHandler::processRemoteOpen(const char* package,
 	bool opened = openLocalPort(portName);
 	if (!opened)
 		printf("[!] unable to open port from remote: %s\n", portName.c_str());
-	if (!sendConfirm(opened)) {
+	if (!sendConfirm(opened, request)) {
 		dbgprintf("[DBG] unable to send confirm response\n");
 		return false;
 	}
 	return true;
 }
 
-bool SerialOverEthernet::SOELinkHandler::sendRemoteClose() {
-	char package = SOE_TCP_OPC_CLOSE_PORT;
+bool SerialOverEthernet::SOELinkHandler::sendRemoteClose(int request) {
+	char package[3] { SOE_TCP_OPC_CLOSE_PORT };
+	if (!getConnection()->supportsRequestIds()) return transmitPackage(package, 1);
+	writeRequestId(package + 1, request);
 
-	return transmitPackage(&package, 1);
+	return transmitPackage(package, 3);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processRemoteClose(const char* package, unsigned int packageLen) {
+	int request = packageLen >= 3 && getConnection()->supportsRequestIds() ? readRequestId(package + 1) : -1;
+
 	printf("[i] close port from remote: %s\n", this->localPortName.c_str());
 	bool closed = closeLocalPort();
 	if (!closed)
 		printf("[!] unable to close port from remote: %s\n", this->localPortName.c_str());
-	if (!sendConfirm(closed)) {
+	if (!sendConfirm(closed, request)) {
 		dbgprintf("[DBG] unable to send confirm response\n");
 		return false;
 	}
 	return true;
 }
 
-bool SerialOverEthernet::SOELinkHandler::sendRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteSerial) {
-	char package[20] {0};
+bool SerialOverEthernet::SOELinkHandler::sendRemoteConfig(const SerialAccess::SerialPortConfiguration& remoteSerial, int request) {
+	char package[23] {0};
 	package[0] = SOE_TCP_OPC_CONFIGURE_PORT;
 	package[1] = (remoteSerial.baudRate >> 24) & 0xFF;
 	package[2] = (remoteSerial.baudRate >> 16) & 0xFF;
@@ -134,8 +202,11 @@ bool SerialOverEthernet::SOELinkHandler::sendRemoteConfig(const SerialAccess::Se
 	package[17] = (remoteSerial.flowControl >> 0) & 0xFF;
 	package[18] = remoteSerial.xonChar;
 	package[19] = remoteSerial.xoffChar;
+	package[20] = remoteSerial.lowLatency ? 1 : 0; // ignored by older versions
+	if (!getConnection()->supportsRequestIds()) return transmitPackage(package, 21);
+	writeRequestId(package + 21, request);
 
-	return transmitPackage(package, 20);
+	return transmitPackage(package, 23);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processRemoteConfig(const char* package, unsigned int packageLen) {
@@ -164,33 +235,67 @@ bool SerialOverEthernet::SOELinkHandler::processRemoteConfig(const char* package
 				(package[16] & 0xFF) << 8 |
 				(package[17] & 0xFF) << 0),
 		package[18],
-		package[19]
+		package[19],
+		packageLen > 20 && package[20] != 0 // low latency
 	};
 
+	int request = packageLen >= 23 && getConnection()->supportsRequestIds() ? readRequestId(package + 21) : -1;
+
 	printf("[i] change port configuration from remote: %s (baud %lu)\n", this->localPortName.c_str(), config.baudRate);
 	bool changed = setLocalConfig(config);
 	if (!changed)
 		printf("[!] unable to change configuration from remote: %s\n", this->localPortName.c_str());
-	if (!sendConfirm(changed)) {
+	if (!sendConfirm(changed, request)) {
 		dbgprintf("[DBG] unable to send config confirm\n");
 		return false;
 	}
 	return true;
 }
 
-bool SerialOverEthernet::SOELinkHandler::sendSerialData(const char* data, unsigned int len) {
-	char package[len + 1] {0};
-	package[0] = SOE_TCP_OPC_STREAM_SERIAL;
-	memcpy(package + 1, data, len);
+bool SerialOverEthernet::SOELinkHandler::sendSerialData(char* frame, unsigned int len) {
+	frame[SOE_TCP_CHANNEL_HEADER_LEN] = SOE_TCP_OPC_STREAM_SERIAL;
+
+	this->lastSerialFrame = std::chrono::steady_clock::now();
+	this->stats.txSerialFrames++;
+	this->stats.txSerialBytes += len;
+
+	// resumable links keep the data until the remote acknowledged it, so that it can be transmitted again on an new connection
+	std::lock_guard<std::mutex> lock(this->m_replay);
+	this->txSequence += len;
+	if (this->session != 0) {
+		trimReplayData();
+		if (this->replayData->push(frame + SOE_SERIAL_FRAME_HEADROOM, len) < len) {
+			printf("[!] resume buffer overflow, link can not be resumed until the remote acknowledged the data!\n");
+			this->replayData->pushRead(this->replayData->dataBuffered());
+			this->replayStart = this->txSequence;
+		}
+		// while the connection is lost, the data is only kept for the replay
+		if (this->detached) return true;
+	}
+	return transmitFrame(frame, len + 1);
+}
 
-	return transmitPackage(package, len + 1);
+bool SerialOverEthernet::SOELinkHandler::isSerialBatching() {
+	if (this->options.batchTime == 0) return false;
+	return std::chrono::steady_clock::now() - this->lastSerialFrame < std::chrono::microseconds(this->options.batchTime);
 }
 
 bool SerialOverEthernet::SOELinkHandler::processSerialData(const char* package, unsigned int packageLen) {
 	if (packageLen < 1) return false;
 
+	this->stats.rxSerialFrames++;
+	this->stats.rxSerialBytes += packageLen - 1;
 	transmitSerialData(package + 1, packageLen - 1);
 
+	// acknowledge the received data now and then, so that the remote can release it from its resume buffer
+	unsigned long long received = this->rxSequence += packageLen - 1;
+	if (this->session != 0 && received - this->rxAcknowledged >= SOE_RESUME_ACK_LEN) {
+		this->rxAcknowledged = received;
+		if (!sendAcknowledge(received)) {
+			dbgprintf("[DBG] unable to send acknowledgement\n");
+		}
+	}
+
 	return true;
 }
 
@@ -221,3 +326,262 @@ bool SerialOverEthernet::SOELinkHandler::processPortState(const char* package, u
 
 	return true;
 }
+
+bool SerialOverEthernet::SOELinkHandler::sendTimestamp() {
+	auto now = std::chrono::steady_clock::now();
+	if (this->detached || !getConnection()->supportsTimestamps() || now - this->lastTimestamp < std::chrono::milliseconds(SOE_LATENCY_PROBE_INTERVAL))
+		return true;
+	this->lastTimestamp = now;
+
+	// the time is only compared against the local clock, so it does not matter how the remote interprets it
+	unsigned long long micros = (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+	char package[9] {0};
+	package[0] = (char) SOE_TCP_OPC_TIMESTAMP;
+	writeLongLong(package + 1, micros);
+
+	return transmitPackage(package, 9);
+}
+
+bool SerialOverEthernet::SOELinkHandler::processTimestamp(const char* package, unsigned int packageLen) {
+	if (packageLen < 9) return false;
+
+	char echo[9];
+	memcpy(echo, package, 9);
+	echo[0] = (char) SOE_TCP_OPC_TIMESTAMP_ECHO;
+
+	return transmitPackage(echo, 9);
+}
+
+bool SerialOverEthernet::SOELinkHandler::processTimestampEcho(const char* package, unsigned int packageLen) {
+	if (packageLen < 9) return false;
+	unsigned long long micros = readLongLong(package + 1);
+
+	std::chrono::steady_clock::time_point sent((std::chrono::microseconds(micros)));
+	this->latency.roundTrip.record(std::chrono::steady_clock::now() - sent);
+	return true;
+}
+
+bool SerialOverEthernet::SOELinkHandler::sendSession(unsigned long long session, int request) {
+	char package[11] {0};
+	package[0] = (char) SOE_TCP_OPC_SESSION;
+	writeLongLong(package + 1, session);
+	if (!getConnection()->supportsRequestIds()) return transmitPackage(package, 9);
+	writeRequestId(package + 9, request);
+
+	return transmitPackage(package, 11);
+}
+
+bool SerialOverEthernet::SOELinkHandler::processSession(const char* package, unsigned int packageLen) {
+	if (packageLen < 9) return false;
+	unsigned long long session = readLongLong(package + 1);
+	int request = packageLen >= 11 && getConnection()->supportsRequestIds() ? readRequestId(package + 9) : -1;
+
+	bool accepted = this->options.resumeTimeout > 0 && session != 0;
+	if (accepted) {
+		std::lock_guard<std::mutex> lock(this->m_replay);
+		this->replayData.reset(new Ringbuffer(SOE_RESUME_BUFFER_LEN));
+		this->replayStart = this->txSequence;
+		this->session = session;
+		dbgprintf("[DBG] accepted resumable session: %016llx\n", session);
+	}
+	if (!sendConfirm(accepted, request)) {
+		dbgprintf("[DBG] unable to send session confirm\n");
+		return false;
+	}
+	return true;
+}
+
+bool SerialOverEthernet::SOELinkHandler::sendResume() {
+	// the request carries the session, the response only the received data, both are sent while the link is still detached
+	char frame[SOE_TCP_CHANNEL_HEADER_LEN + 17];
+	char* package = frame + SOE_TCP_CHANNEL_HEADER_LEN;
+	package[0] = (char) SOE_TCP_OPC_RESUME;
+	writeLongLong(package + 1, this->session);
+	writeLongLong(package + 9, this->rxSequence);
+
+	unsigned char channel;
+	std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+	return transmitFrame(*connection, frame, 17, channel);
+}
+
+bool SerialOverEthernet::SOELinkHandler::processResume(const char* package, unsigned int packageLen) {
+	if (packageLen < 17) return false;
+
+	// the response to an resume request, the request itself is handled by the connection
+	{
+		std::lock_guard<std::mutex> lock(this->m_remoteReturn);
+		this->resumeReceived = readLongLong(package + 9);
+	}
+	completeRequest(-1, readLongLong(package + 1) == this->session);
+	return true;
+}
+
+bool SerialOverEthernet::SOELinkHandler::replaySession(unsigned long long remoteReceived) {
+
+	std::unique_lock<std::mutex> lock(this->m_replay);
+	unsigned long long acknowledged = this->txAcknowledged.load();
+	while (remoteReceived > acknowledged && !this->txAcknowledged.compare_exchange_weak(acknowledged, remoteReceived));
+	trimReplayData();
+
+	// the remote can not have received more than was transmitted, or less than it acknowledged
+	if (remoteReceived < this->replayStart || remoteReceived > this->txSequence) {
+		printf("[!] serial data for resume no longer available, link can not be resumed\n");
+		lock.unlock();
+		shutdown();
+		return false;
+	}
+
+	unsigned char channel;
+	std::shared_ptr<SOEConnection> connection = getConnection(&channel);
+	unsigned long long offset = remoteReceived - this->replayStart;
+	unsigned long long pending = this->txSequence - remoteReceived;
+	dbgprintf("[DBG] replay %llu serial bytes\n", pending);
+
+	// the frame buffer is sized to the negotiated frame limit once for the whole replay
+	unsigned int frameLimit = serialFrameLimit();
+	std::unique_ptr<char[]> frame(new char[SOE_SERIAL_FRAME_HEADROOM + frameLimit]);
+	frame[SOE_TCP_CHANNEL_HEADER_LEN] = SOE_TCP_OPC_STREAM_SERIAL;
+	while (pending > 0) {
+		unsigned int len = pending < frameLimit ? (unsigned int) pending : frameLimit;
+		this->replayData->peek(frame.get() + SOE_SERIAL_FRAME_HEADROOM, len, (unsigned long) offset);
+		if (!transmitFrame(*connection, frame.get(), len + 1, channel)) {
+			printf("[!] failed to replay serial data to remote\n");
+			return false;
+		}
+		offset += len;
+		pending -= len;
+	}
+
+	{
+		std::lock_guard<std::mutex> resumeLock(this->m_resume);
+		this->detached = false;
+	}
+	this->cv_resume.notify_all();
+	this->stats.resumes++;
+	printf("[i] link resumed: %s <-> %s @ %s/%s (channel %u)\n", this->localPortName.c_str(), this->remotePortName.c_str(), connection->getHostName().c_str(), connection->getHostPort().c_str(), channel);
+
+	// flow control and port state changes might have been lost with the connection
+	if (!sendFlowControl(this->remoteFlowEnable)) {
+		dbgprintf("[DBG] unable to send flow control\n");
+	}
+	this->portStateLost = true;
+	wakeupSerial();
+	return true;
+
+}
+
+bool SerialOverEthernet::SOELinkHandler::sendAcknowledge(unsigned long long received) {
+	char package[9] {0};
+	package[0] = (char) SOE_TCP_OPC_ACKNOWLEDGE;
+	writeLongLong(package + 1, received);
+
+	return transmitPackage(package, 9);
+}
+
+bool SerialOverEthernet::SOELinkHandler::processAcknowledge(const char* package, unsigned int packageLen) {
+	if (packageLen < 9) return false;
+	unsigned long long received = readLongLong(package + 1);
+
+	// acknowledgements of an previous connection might arrive after the ones of the resume response
+	unsigned long long acknowledged = this->txAcknowledged.load();
+	while (received > acknowledged && !this->txAcknowledged.compare_exchange_weak(acknowledged, received));
+
+	// the serial port might wait for space in the resume buffer
+	if (this->replayBlocked.exchange(false)) wakeupSerial();
+	return true;
+}
+
+bool SerialOverEthernet::SOEConnection::sendFrameLimit() {
+	char package[6] {0};
+	package[0] = SOE_TCP_OPC_FRAME_LIMIT;
+	unsigned int limit = localFrameLimit();
+	package[1] = (limit >> 24) & 0xFF;
+	package[2] = (limit >> 16) & 0xFF;
+	package[3] = (limit >> 8) & 0xFF;
+	package[4] = (limit >> 0) & 0xFF;
+	package[5] = SOE_TCP_PROTO_VERSION; // ignored by older versions
+
+	char frame[SOE_TCP_CHANNEL_HEADER_LEN + 6];
+	memcpy(frame + SOE_TCP_CHANNEL_HEADER_LEN, package, 6);
+	return transmitFrame(frame, 6, 0);
+}
+
+bool SerialOverEthernet::SOEConnection::processFrameLimit(const char* package, unsigned int packageLen) {
+	if (packageLen < 5) return false;
+	unsigned long remoteLimit =
+			(package[1] & 0xFF) << 24 |
+			(package[2] & 0xFF) << 16 |
+			(package[3] & 0xFF) << 8 |
+			(package[4] & 0xFF) << 0;
+
+	// use the smaller limit of both ends, but never less than the default every implementation accepts
+	unsigned long limit = remoteLimit < SOE_TCP_FRAME_MAX_LEN ? remoteLimit : SOE_TCP_FRAME_MAX_LEN;
+	if (limit < SOE_TCP_FRAME_DEFAULT_LEN) limit = SOE_TCP_FRAME_DEFAULT_LEN;
+	this->txFrameLimit = (unsigned int) limit;
+	dbgprintf("[DBG] negotiated max frame length: %lu\n", limit);
+
+	// older versions do not announce an protocol version, and do not understand channels
+	this->remoteChannels = packageLen > 5 && (unsigned char) package[5] >= 2;
+	this->remoteTimestamps = packageLen > 5 && (unsigned char) package[5] >= 3;
+	this->remoteResume = packageLen > 5 && (unsigned char) package[5] >= 4;
+	this->remoteRequestIds = packageLen > 5 && (unsigned char) package[5] >= 5;
+	dbgprintf("[DBG] remote supports channels: %s\n", this->remoteChannels ? "true" : "false");
+
+	// answer with the local limit, unless this is already the answer
+	if (!this->frameLimitSent.exchange(true)) {
+		if (!sendFrameLimit()) {
+			dbgprintf("[DBG] unable to send frame limit response\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SerialOverEthernet::SOEConnection::sendCloseChannel(unsigned char channel) {
+	char frame[SOE_TCP_CHANNEL_HEADER_LEN + 1];
+	frame[SOE_TCP_CHANNEL_HEADER_LEN] = SOE_TCP_OPC_CLOSE_CHANNEL;
+
+	return transmitFrame(frame, 1, channel);
+}
+
+bool SerialOverEthernet::SOEConnection::processResume(unsigned char channel, const char* package, unsigned int packageLen) {
+	if (packageLen < 17) return false;
+	unsigned long long session = readLongLong(package + 1);
+	unsigned long long received = readLongLong(package + 9);
+
+	dbgprintf("[DBG] resume session on channel %u: %016llx\n", channel, session);
+	std::shared_ptr<SOEConnection> connection = shared_from_this();
+	bool resumed = this->onResumeChannel(connection, channel, session, received);
+	deferRelease(connection);
+	if (resumed) return true;
+
+	// the session is unknown or expired, the remote has to give up the link
+	printf("[!] unable to resume session on channel: %u\n", channel);
+	char frame[SOE_TCP_CHANNEL_HEADER_LEN + 2];
+	frame[SOE_TCP_CHANNEL_HEADER_LEN] = SOE_TCP_OPC_CONFIRM;
+	frame[SOE_TCP_CHANNEL_HEADER_LEN + 1] = 0x0;
+	return transmitFrame(frame, 2, channel);
+}
+
+bool SerialOverEthernet::SOEConnection::processCloseChannel(unsigned char channel) {
+	std::lock_guard<std::mutex> lock(this->m_channels);
+
+	// the link might already be shut down, if both ends closed the channel at the same time
+	auto entry = this->channels.find(channel);
+	if (entry == this->channels.end() || entry->second == nullptr || !entry->second->isAlive()) return true;
+
+	printf("[i] channel closed by remote: %u\n", channel);
+	entry->second->shutdown();
+	return true;
+}
+
+unsigned int SerialOverEthernet::SOEConnection::localFrameLimit() {
+	unsigned long limit = this->bufferSize / 4;
+	if (limit > SOE_TCP_FRAME_MAX_LEN) limit = SOE_TCP_FRAME_MAX_LEN;
+	if (limit < SOE_TCP_FRAME_DEFAULT_LEN) limit = SOE_TCP_FRAME_DEFAULT_LEN;
+	return (unsigned int) limit;
+}
+
+unsigned int SerialOverEthernet::SOELinkHandler::serialFrameLimit() {
+	return getConnection()->frameLimit() - SOE_SERIAL_FRAME_HEADROOM;
+}
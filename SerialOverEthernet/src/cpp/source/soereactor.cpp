@@ -0,0 +1,150 @@
+/*
+ * soereactor.cpp
+ *
+ * Implements the optional event loop, which services the serial ports of many links from a fixed number of threads.
+ * Each attached link registers the event handle of its local serial port, which is signaled while serial events are pending.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#ifdef PLATFORM_LIN
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "soeconnection.hpp"
+#include "dbgprintf.h"
+
+SerialOverEthernet::SOEReactor::SOEReactor(unsigned int threadCount) {
+	this->epollHandle = epoll_create1(EPOLL_CLOEXEC);
+	if (this->epollHandle == -1)
+		printf("[!] failed to create reactor epoll set: %s\n", strerror(errno));
+	this->stopEventHandle = eventfd(0, EFD_NONBLOCK);
+
+	// the stop event is never cleared, so it releases all threads
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	if (epoll_ctl(this->epollHandle, EPOLL_CTL_ADD, this->stopEventHandle, &event) == -1)
+		printf("[!] failed to register reactor stop event: %s\n", strerror(errno));
+
+	if (threadCount == 0) threadCount = 1;
+	for (unsigned int i = 0; i < threadCount; i++) {
+		this->threads.emplace_back([this]() -> void {
+			this->runEventLoop();
+		});
+	}
+	dbgprintf("[DBG] reactor started with %u threads\n", threadCount);
+}
+
+SerialOverEthernet::SOEReactor::~SOEReactor() {
+	unsigned long long val = 1;
+	if (::write(this->stopEventHandle, (char*) &val, 8) == -1)
+		printf("[!] failed to signal reactor stop event: %s\n", strerror(errno));
+	for (std::thread& thread : this->threads)
+		thread.join();
+	::close(this->epollHandle);
+	::close(this->stopEventHandle);
+}
+
+bool SerialOverEthernet::SOEReactor::attach(SOELinkHandler* handler, long long int eventHandle) {
+	std::lock_guard<std::mutex> lock(this->m_handlers);
+
+	// remove the previous handle, it might still be registered if the port was replaced
+	auto previous = this->handlers.find(handler);
+	if (previous != this->handlers.end())
+		epoll_ctl(this->epollHandle, EPOLL_CTL_DEL, (int) previous->second, nullptr);
+
+	// one shot ensures the link is only serviced by one thread at a time
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = handler;
+	if (epoll_ctl(this->epollHandle, EPOLL_CTL_ADD, (int) eventHandle, &event) == -1) {
+		printf("[!] failed to register link in reactor: %s\n", strerror(errno));
+		this->handlers.erase(handler);
+		return false;
+	}
+	this->handlers[handler] = eventHandle;
+	return true;
+}
+
+void SerialOverEthernet::SOEReactor::detach(SOELinkHandler* handler) {
+	std::unique_lock<std::mutex> lock(this->m_handlers);
+
+	auto entry = this->handlers.find(handler);
+	if (entry != this->handlers.end()) {
+		// the handle might already be closed, which removes it from the set automatically
+		epoll_ctl(this->epollHandle, EPOLL_CTL_DEL, (int) entry->second, nullptr);
+		this->handlers.erase(entry);
+	}
+
+	// wait for pending service calls, unless called by the servicing thread itself
+	this->cv_handlers.wait(lock, [this, handler]() {
+		auto service = this->servicing.find(handler);
+		return service == this->servicing.end() || service->second == std::this_thread::get_id();
+	});
+}
+
+void SerialOverEthernet::SOEReactor::rearm(SOELinkHandler* handler, long long int eventHandle) {
+	struct epoll_event event;
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = handler;
+	if (epoll_ctl(this->epollHandle, EPOLL_CTL_MOD, (int) eventHandle, &event) == -1)
+		printf("[!] failed to re-arm link in reactor: %s\n", strerror(errno));
+}
+
+void SerialOverEthernet::SOEReactor::runEventLoop() {
+
+	struct epoll_event events[SOE_REACTOR_MAX_EVENTS];
+
+	while (true) {
+
+		int eventCount = epoll_wait(this->epollHandle, events, SOE_REACTOR_MAX_EVENTS, -1);
+		if (eventCount < 0) {
+			if (errno == EINTR) continue;
+			printf("[!] reactor wait failed: %s\n", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < eventCount; i++) {
+
+			// stop event
+			if (events[i].data.ptr == nullptr) {
+				dbgprintf("[DBG] reactor thread terminated\n");
+				return;
+			}
+
+			// check if the link is still attached and claim it
+			SOELinkHandler* handler = (SOELinkHandler*) events[i].data.ptr;
+			{
+				std::lock_guard<std::mutex> lock(this->m_handlers);
+				if (this->handlers.find(handler) == this->handlers.end()) continue;
+				this->servicing[handler] = std::this_thread::get_id();
+			}
+
+			bool alive = handler->serviceSerialReception();
+			if (!alive) {
+				dbgprintf("[DBG] client socket TX terminated, shutting down ...\n");
+				handler->shutdown();
+			}
+
+			// release the link and re-enable its event handle
+			{
+				std::lock_guard<std::mutex> lock(this->m_handlers);
+				this->servicing.erase(handler);
+				auto entry = this->handlers.find(handler);
+				if (alive && entry != this->handlers.end())
+					rearm(handler, entry->second);
+			}
+			this->cv_handlers.notify_all();
+
+		}
+
+	}
+
+}
+
+#endif
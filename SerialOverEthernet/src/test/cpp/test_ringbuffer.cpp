@@ -0,0 +1,206 @@
+/*
+ * test_ringbuffer.cpp
+ *
+ * Unit and stress tests of the single producer, single consumer ring buffer.
+ * Built twice, with PLATFORM_LIN for the mirrored buffer and without it for the plain one, which copies wrapping data in two parts.
+ */
+
+#include "ringbuffer.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		printf("[!] check failed: %s (%s:%d)\n", #condition, __FILE__, __LINE__); \
+		failures++; \
+	} \
+} while (0)
+
+// byte expected at an position of the test stream, 251 is prime so the pattern never lines up with the buffer capacity
+static char patternAt(unsigned long long position) {
+	return (char) (position % 251);
+}
+
+static void testEmpty() {
+	Ringbuffer buffer(1000);
+	CHECK(buffer.capacity() >= 1000);
+	CHECK(buffer.free() == buffer.capacity());
+	CHECK(buffer.dataBuffered() == 0);
+	CHECK(buffer.dataAvailable() == 0);
+	CHECK(buffer.writeAvailable() == buffer.capacity());
+	CHECK(buffer.find('a', 0) == -1);
+	char data[4];
+	CHECK(buffer.peek(data, sizeof(data), 0) == 0);
+}
+
+static void testPushFull() {
+	Ringbuffer buffer(1000);
+	unsigned long int capacity = buffer.capacity();
+	std::vector<char> data(capacity + 100, 'x');
+
+	// data beyond the capacity is not copied
+	CHECK(buffer.push(data.data(), capacity + 100) == capacity);
+	CHECK(buffer.free() == 0);
+	CHECK(buffer.writeAvailable() == 0);
+	CHECK(buffer.dataBuffered() == capacity);
+	CHECK(buffer.push(data.data(), 1) == 0);
+
+	buffer.pushRead(10);
+	CHECK(buffer.free() == 10);
+	CHECK(buffer.push(data.data(), 100) == 10);
+}
+
+static void testWrap() {
+	Ringbuffer buffer(1000);
+	unsigned long int capacity = buffer.capacity();
+	std::vector<char> data(capacity);
+	for (unsigned long int i = 0; i < capacity; i++)
+		data[i] = patternAt(i);
+
+	// move both positions close to the buffer end
+	CHECK(buffer.push(data.data(), capacity - 10) == capacity - 10);
+	buffer.pushRead(capacity - 10);
+	CHECK(buffer.dataBuffered() == 0);
+
+	// the pushed data wraps around the end
+	CHECK(buffer.push(data.data(), 100) == 100);
+	CHECK(buffer.dataBuffered() == 100);
+	CHECK(buffer.dataAvailable() == 100 || buffer.dataAvailable() == 10);
+
+	std::vector<char> copy(100);
+	CHECK(buffer.peek(copy.data(), 100, 0) == 100);
+	CHECK(memcmp(copy.data(), data.data(), 100) == 0);
+	CHECK(buffer.peek(copy.data(), 100, 50) == 50);
+	CHECK(memcmp(copy.data(), data.data() + 50, 50) == 0);
+
+	// search across the wrap position
+	CHECK(buffer.find(patternAt(5), 0) == 5);
+	CHECK(buffer.find(patternAt(20), 0) == 20);
+	CHECK(buffer.find(patternAt(20), 21) == -1);
+
+	// the consumer sees the data in at most two spans
+	unsigned long int read = 0;
+	for (int span = 0; span < 2 && read < 100; span++) {
+		unsigned long int available = buffer.dataAvailable();
+		CHECK(memcmp(buffer.dataStart(), data.data() + read, available) == 0);
+		buffer.pushRead(available);
+		read += available;
+	}
+	CHECK(read == 100);
+	CHECK(buffer.dataBuffered() == 0);
+}
+
+static void testWriteSpans() {
+	Ringbuffer buffer(1000);
+	unsigned long int capacity = buffer.capacity();
+
+	buffer.push(std::vector<char>(capacity - 10).data(), capacity - 10);
+	buffer.pushRead(capacity - 10);
+
+	// fill the free space trough the producer spans
+	unsigned long long written = 0;
+	while (buffer.writeAvailable() > 0) {
+		unsigned long int available = buffer.writeAvailable();
+		char* start = buffer.writeStart();
+		for (unsigned long int i = 0; i < available; i++)
+			start[i] = patternAt(written + i);
+		buffer.pushWrite(available);
+		written += available;
+	}
+	CHECK(written == capacity);
+	CHECK(buffer.free() == 0);
+
+	std::vector<char> copy(capacity);
+	CHECK(buffer.peek(copy.data(), capacity, 0) == capacity);
+	for (unsigned long int i = 0; i < capacity; i++) {
+		if (copy[i] == patternAt(i)) continue;
+		CHECK(copy[i] == patternAt(i));
+		break;
+	}
+}
+
+/**
+ * Streams an byte pattern from an producer thread to an consumer thread trough an small buffer.
+ * Both sides alternate between the copying and the span functions and use random lengths, so that all wrap cases occur.
+ */
+static void testStress(unsigned long int size, unsigned long long total) {
+	Ringbuffer buffer(size);
+	bool corrupted = false;
+
+	std::thread producer([&buffer, total]() {
+		std::mt19937 random(1);
+		std::vector<char> data(buffer.capacity());
+		unsigned long long written = 0;
+		while (written < total) {
+			unsigned long int length = random() % buffer.capacity() + 1;
+			if (length > total - written) length = (unsigned long int) (total - written);
+			if (random() % 2 == 0) {
+				for (unsigned long int i = 0; i < length; i++)
+					data[i] = patternAt(written + i);
+				written += buffer.push(data.data(), length);
+			} else {
+				unsigned long int available = buffer.writeAvailable();
+				if (length > available) length = available;
+				char* start = buffer.writeStart();
+				for (unsigned long int i = 0; i < length; i++)
+					start[i] = patternAt(written + i);
+				buffer.pushWrite(length);
+				written += length;
+			}
+			if (buffer.free() == 0) std::this_thread::yield();
+		}
+	});
+
+	std::mt19937 random(2);
+	std::vector<char> data(buffer.capacity());
+	unsigned long long read = 0;
+	while (read < total) {
+		unsigned long int length = random() % buffer.capacity() + 1;
+		if (random() % 2 == 0) {
+			// peek at the data before releasing it
+			length = buffer.peek(data.data(), length, 0);
+			for (unsigned long int i = 0; i < length && !corrupted; i++)
+				corrupted = data[i] != patternAt(read + i);
+			buffer.pushRead(length);
+			read += length;
+		} else {
+			unsigned long int available = buffer.dataAvailable();
+			if (length > available) length = available;
+			const char* start = buffer.dataStart();
+			for (unsigned long int i = 0; i < length && !corrupted; i++)
+				corrupted = start[i] != patternAt(read + i);
+			buffer.pushRead(length);
+			read += length;
+		}
+		if (buffer.dataBuffered() == 0) std::this_thread::yield();
+	}
+
+	producer.join();
+
+	if (corrupted) printf("[!] stress test with buffer size %lu received corrupted data\n", size);
+	CHECK(!corrupted);
+}
+
+int main() {
+	setbuf(stdout, NULL);
+
+	testEmpty();
+	testPushFull();
+	testWrap();
+	testWriteSpans();
+	testStress(1, 1000000);
+	testStress(4096, 16000000);
+	testStress(65536, 64000000);
+
+	if (failures > 0) {
+		printf("[!] %d checks failed\n", failures);
+		return 1;
+	}
+	printf("[i] all checks passed\n");
+	return 0;
+}
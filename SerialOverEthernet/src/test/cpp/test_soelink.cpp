@@ -0,0 +1,282 @@
+/*
+ * test_soelink.cpp
+ *
+ * Stress test of the links and connections, meant to be run under ThreadSanitizer.
+ * An client and an server connection are linked over the loopback interface, pseudo terminals take the place of the serial ports.
+ * Several links share the connection and stream data in both directions at once, which exercises the network reception thread
+ * pushing into the stream buffers of the links while their serial threads (or the reactor) drain them.
+ */
+
+#include "soeconnection.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+#define TEST_LINKS 3					// links sharing the connection
+#define TEST_STREAM_LEN 1000000ULL		// bytes streamed in each direction of each link
+#define TEST_TIMEOUT 120				// seconds until the streams have to be completed
+#define TEST_PORT_FIRST 27780			// first local port tried for the server
+#define TEST_PORT_LAST 27799			// last local port tried for the server
+#define TEST_BUFFER_LEN (SOE_TCP_FRAME_MAX_LEN * 4)	// stream buffer of the links, pseudo terminals are not limited by an baud rate
+
+typedef struct PseudoTerminal {
+	int master = -1;					// the test side of the port
+	int slave = -1;						// kept open, so that the master does not hang up while the link reopens the port
+	std::string name;					// the port name the link opens
+} PseudoTerminal;
+
+typedef struct Stream {
+	int source;							// master written to
+	int target;							// master read from
+	unsigned int seed;					// varies the pattern between the streams
+	std::atomic<unsigned long long> received {0};
+	std::atomic<bool> corrupted {false};
+} Stream;
+
+static std::mutex m_serverHandlers;
+static std::vector<SerialOverEthernet::SOELinkHandler*> serverHandlers;
+
+static bool openPseudoTerminal(PseudoTerminal& terminal) {
+	terminal.master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (terminal.master == -1 || grantpt(terminal.master) != 0 || unlockpt(terminal.master) != 0) return false;
+	const char* name = ptsname(terminal.master);
+	if (name == nullptr) return false;
+	terminal.name = name;
+	terminal.slave = open(name, O_RDWR | O_NOCTTY);
+	if (terminal.slave == -1) return false;
+	struct termios config;
+	if (tcgetattr(terminal.master, &config) != 0) return false;
+	cfmakeraw(&config);
+	return tcsetattr(terminal.master, TCSANOW, &config) == 0 && fcntl(terminal.master, F_SETFL, O_NONBLOCK) == 0;
+}
+
+static void closePseudoTerminal(PseudoTerminal& terminal) {
+	if (terminal.slave != -1) close(terminal.slave);
+	if (terminal.master != -1) close(terminal.master);
+}
+
+static char patternAt(unsigned int seed, unsigned long long position) {
+	return (char) ((position * 7 + seed) % 251);
+}
+
+static void writeStream(Stream& stream, std::chrono::steady_clock::time_point deadline) {
+	char data[4096];
+	unsigned long long written = 0;
+	while (written < TEST_STREAM_LEN && std::chrono::steady_clock::now() < deadline) {
+		struct pollfd pollfd = { stream.source, POLLOUT, 0 };
+		if (poll(&pollfd, 1, 100) <= 0) continue;
+		unsigned int length = TEST_STREAM_LEN - written < sizeof(data) ? (unsigned int) (TEST_STREAM_LEN - written) : sizeof(data);
+		// vary the write length, so that the frames do not line up with the pattern
+		if (length > 37) length -= (unsigned int) (written % 37);
+		for (unsigned int i = 0; i < length; i++)
+			data[i] = patternAt(stream.seed, written + i);
+		ssize_t result = write(stream.source, data, length);
+		if (result > 0) written += result;
+	}
+}
+
+static void readStream(Stream& stream, std::chrono::steady_clock::time_point deadline) {
+	char data[4096];
+	unsigned long long received = 0;
+	while (received < TEST_STREAM_LEN && std::chrono::steady_clock::now() < deadline) {
+		struct pollfd pollfd = { stream.target, POLLIN, 0 };
+		if (poll(&pollfd, 1, 100) <= 0) continue;
+		ssize_t result = read(stream.target, data, sizeof(data));
+		if (result <= 0) continue;
+		for (ssize_t i = 0; i < result; i++) {
+			if (data[i] == patternAt(stream.seed, received + i)) continue;
+			stream.corrupted = true;
+			break;
+		}
+		received += result;
+		stream.received = received;
+		if (stream.corrupted) return;
+	}
+}
+
+static SerialOverEthernet::SOELinkOptions testLinkOptions() {
+	SerialOverEthernet::SOELinkOptions options = SerialOverEthernet::DEFAULT_LINK_OPTIONS;
+	options.bufferSize = TEST_BUFFER_LEN;
+	return options;
+}
+
+static SerialOverEthernet::SOELinkHandler* createHandler(std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel, SerialOverEthernet::SOEReactor* reactor) {
+	SerialOverEthernet::SOELinkHandler* handler = new SerialOverEthernet::SOELinkHandlerCOM(connection, channel, [](SerialOverEthernet::SOELinkHandler* handler) {});
+	handler->setOptions(testLinkOptions());
+	handler->start(reactor);
+	return handler;
+}
+
+static void destroyHandler(SerialOverEthernet::SOELinkHandler* handler) {
+	handler->shutdown();
+	handler->stop();
+	delete handler;
+}
+
+/**
+ * Links TEST_LINKS pairs of pseudo terminals over one connection and streams data trough all of them in both directions.
+ * @param reactorThreads The number of reactor threads servicing the serial ports, zero for an dedicated thread per link
+ * @return true if all data arrived unchanged
+ */
+static bool testLinks(unsigned int reactorThreads) {
+	printf("[i] streaming %llu bytes per direction trough %u links, %u reactor threads\n", TEST_STREAM_LEN, TEST_LINKS, reactorThreads);
+
+	SerialOverEthernet::SOEReactor* reactor = reactorThreads > 0 ? new SerialOverEthernet::SOEReactor(reactorThreads) : nullptr;
+
+	// claim an server port on the loopback interface
+	NetSocket::Socket* listenSocket = NetSocket::newSocket();
+	std::vector<NetSocket::INetAddress> addresses;
+	NetSocket::INetAddress serverAddress;
+	bool listening = false;
+	for (unsigned int port = TEST_PORT_FIRST; port <= TEST_PORT_LAST && !listening; port++) {
+		addresses.clear();
+		if (!NetSocket::resolveInet("127.0.0.1", std::to_string(port), true, addresses) || addresses.empty()) continue;
+		serverAddress = addresses[0];
+		listening = listenSocket->listen(serverAddress);
+	}
+	if (!listening) {
+		printf("[!] unable to open server port\n");
+		delete listenSocket;
+		return false;
+	}
+
+	// the server creates the links for the channels the client opens
+	std::shared_ptr<SerialOverEthernet::SOEConnection> serverConnection;
+	std::thread acceptThread([&listenSocket, &serverConnection, reactor]() {
+		NetSocket::Socket* clientSocket = NetSocket::newSocket();
+		if (!listenSocket->accept(*clientSocket)) {
+			delete clientSocket;
+			return;
+		}
+		serverConnection = std::make_shared<SerialOverEthernet::SOEConnection>(clientSocket, "client", "0", TEST_BUFFER_LEN,
+			[reactor](std::shared_ptr<SerialOverEthernet::SOEConnection> connection, unsigned char channel) {
+				SerialOverEthernet::SOELinkHandler* handler = createHandler(connection, channel, reactor);
+				std::lock_guard<std::mutex> lock(m_serverHandlers);
+				serverHandlers.push_back(handler);
+				return handler;
+			}, nullptr);
+		serverConnection->start();
+	});
+
+	NetSocket::Socket* clientSocket = NetSocket::newSocket();
+	if (!clientSocket->connect(serverAddress, SOE_TCP_HANDSHAKE_TIMEOUT)) {
+		printf("[!] unable to connect to server port\n");
+		listenSocket->close();
+		acceptThread.join();
+		delete clientSocket;
+		delete listenSocket;
+		return false;
+	}
+	acceptThread.join();
+	std::shared_ptr<SerialOverEthernet::SOEConnection> clientConnection = std::make_shared<SerialOverEthernet::SOEConnection>(clientSocket, "server", "0", TEST_BUFFER_LEN, nullptr, nullptr);
+
+	// set up the links like the command line client does
+	bool success = true;
+	PseudoTerminal localPorts[TEST_LINKS];
+	PseudoTerminal remotePorts[TEST_LINKS];
+	std::vector<SerialOverEthernet::SOELinkHandler*> clientHandlers;
+	for (unsigned int link = 0; link < TEST_LINKS && success; link++) {
+		if (!openPseudoTerminal(localPorts[link]) || !openPseudoTerminal(remotePorts[link])) {
+			printf("[!] unable to open pseudo terminals\n");
+			success = false;
+			break;
+		}
+		int channel = clientConnection->allocateChannel();
+		if (link == 0) {
+			clientConnection->start();
+			clientConnection->awaitFrameLimit();
+		}
+		if (channel < 0) {
+			printf("[!] unable to allocate channel for link %u\n", link);
+			success = false;
+			break;
+		}
+		SerialOverEthernet::SOELinkHandler* handler = createHandler(clientConnection, (unsigned char) channel, reactor);
+		clientHandlers.push_back(handler);
+		if (!handler->openRemotePort(remotePorts[link].name) || !handler->setRemoteConfig(SerialAccess::DEFAULT_PORT_CONFIGURATION) ||
+				!handler->openLocalPort(localPorts[link].name) || !handler->setLocalConfig(SerialAccess::DEFAULT_PORT_CONFIGURATION)) {
+			printf("[!] unable to set up link %u\n", link);
+			success = false;
+		}
+	}
+
+	// stream trough all links in both directions at once
+	if (success) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TEST_TIMEOUT);
+		std::vector<std::unique_ptr<Stream>> streams;
+		std::vector<std::thread> threads;
+		for (unsigned int link = 0; link < TEST_LINKS; link++) {
+			streams.emplace_back(new Stream());
+			streams.back()->source = localPorts[link].master;
+			streams.back()->target = remotePorts[link].master;
+			streams.back()->seed = link * 2;
+			streams.emplace_back(new Stream());
+			streams.back()->source = remotePorts[link].master;
+			streams.back()->target = localPorts[link].master;
+			streams.back()->seed = link * 2 + 1;
+		}
+		for (std::unique_ptr<Stream>& stream : streams) {
+			Stream* streamPtr = stream.get();
+			threads.emplace_back([streamPtr, deadline]() { writeStream(*streamPtr, deadline); });
+			threads.emplace_back([streamPtr, deadline]() { readStream(*streamPtr, deadline); });
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		for (unsigned int stream = 0; stream < streams.size(); stream++) {
+			if (streams[stream]->corrupted) {
+				printf("[!] stream %u received corrupted data\n", stream);
+				success = false;
+			} else if (streams[stream]->received != TEST_STREAM_LEN) {
+				printf("[!] stream %u received %llu of %llu bytes\n", stream, streams[stream]->received.load(), TEST_STREAM_LEN);
+				success = false;
+			}
+		}
+	}
+
+	// tear down in the same order as the command line client
+	for (SerialOverEthernet::SOELinkHandler* handler : clientHandlers)
+		destroyHandler(handler);
+	clientConnection->shutdown();
+	if (serverConnection != nullptr) serverConnection->shutdown();
+	{
+		std::lock_guard<std::mutex> lock(m_serverHandlers);
+		for (SerialOverEthernet::SOELinkHandler* handler : serverHandlers)
+			destroyHandler(handler);
+		serverHandlers.clear();
+	}
+	clientConnection.reset();
+	serverConnection.reset();
+	SerialOverEthernet::SOEConnection::releaseDeferred();
+	delete reactor;
+	listenSocket->close();
+	delete listenSocket;
+	for (unsigned int link = 0; link < TEST_LINKS; link++) {
+		closePseudoTerminal(localPorts[link]);
+		closePseudoTerminal(remotePorts[link]);
+	}
+	return success;
+}
+
+int main() {
+	setbuf(stdout, NULL);
+
+	if (!NetSocket::InetInit()) {
+		printf("[!] failed to initialize network!\n");
+		return 1;
+	}
+
+	bool success = testLinks(0) && testLinks(2);
+
+	NetSocket::InetCleanup();
+	printf(success ? "[i] all links transmitted the data unchanged\n" : "[!] link test failed\n");
+	return success ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#ifndef SERIAL_PORT_URING_HPP_
+#define SERIAL_PORT_URING_HPP_
+
+#ifdef PLATFORM_LIN
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// 32 bit poll masks are the newest feature required
+#ifdef IORING_FEAT_POLL_32BITS
+#define SERIAL_PORT_URING_SUPPORT
+#endif
+#endif
+#endif
+
+#ifdef SERIAL_PORT_URING_SUPPORT
+
+#include <mutex>
+
+// environment variable which enables the io_uring backend if set to 1
+#define SERIAL_PORT_URING_ENV "SERIALACCESS_IO_URING"
+// capacity of the bounce buffers used for reads and writes
+#define SERIAL_PORT_URING_BUFFER_LEN 16384
+// number of submission queue entries, enough for an read and an write, each linked behind an poll, and their cancellation
+#define SERIAL_PORT_URING_ENTRIES 8
+// max time to wait for cancelled operations to complete, before the cancellation is requested again
+#define SERIAL_PORT_URING_CANCEL_TIMEOUT 100
+
+/**
+ * An minimal io_uring instance, used by SerialPortLin to run reads and writes as asynchronous operations.
+ * There is at most one read and one write in flight at a time, which matches the pending operation semantics of wait = false.
+ * The data is transferred trough registered bounce buffers, so the buffers of the caller do not have to remain valid while an operation is pending.
+ * Completions are reaped from the mapped completion queue without an system call.
+ */
+class SerialPortUring {
+
+private:
+	enum OperationState {
+		URING_IDLE,
+		URING_PENDING,
+		URING_DONE
+	};
+
+	int ringHandle;
+	unsigned int* sqHead;
+	unsigned int* sqTail;
+	unsigned int* sqMask;
+	unsigned int* sqArray;
+	unsigned int* sqFlags;
+	unsigned int sqQueued;			// entries filled but not yet published to the kernel
+	struct io_uring_sqe* sqEntries;
+	unsigned int* cqHead;
+	unsigned int* cqTail;
+	unsigned int* cqMask;
+	struct io_uring_cqe* cqEntries;
+	unsigned int* cqOverflow;
+	unsigned int cqOverflowSeen;	// completions dropped by the kernel, already reported
+	void* sqRing;
+	void* cqRing;
+	size_t sqRingLen;
+	size_t cqRingLen;
+	size_t sqEntriesLen;
+	bool fixedBuffers;
+
+	std::mutex m_ring;
+	char readBuffer[SERIAL_PORT_URING_BUFFER_LEN];
+	char writeBuffer[SERIAL_PORT_URING_BUFFER_LEN];
+	OperationState readState;
+	OperationState writeState;
+	int readResult;
+	int writeResult;
+	unsigned long readOffset;
+	int readHandle;					// port of the pending read, kept to submit it again if it was interrupted
+	int writeHandle;				// port of the pending write, kept to submit it again if it was interrupted
+	unsigned long readLength;		// requested length of the pending read
+	unsigned long writeLength;		// length of the data in the write buffer
+	bool readCancelled;				// if the cancellation of the pending read was requested
+	bool writeCancelled;			// if the cancellation of the pending write was requested
+
+	SerialPortUring();
+	bool setup();
+	struct io_uring_sqe* nextEntry();
+	bool submit();
+	bool queueRead();
+	bool queueWrite();
+	void reap();
+	bool cancelOperation(unsigned long long tag);
+
+public:
+	~SerialPortUring();
+
+	/**
+	 * Creates the io_uring instance for an port, if enabled by the environment and supported by the kernel.
+	 * @return The new instance, or nullptr if the port should fall back to poll() and read()/write()
+	 */
+	static SerialPortUring* create();
+
+	/**
+	 * Returns the ring file descriptor, which is readable while completions are waiting to be reaped.
+	 */
+	int getHandle();
+
+	/**
+	 * Returns true if neither an read is pending nor data of an completed read is left.
+	 */
+	bool isReadIdle();
+	bool isReadDone();
+	bool isWriteIdle();
+	bool isWriteDone();
+
+	/**
+	 * Submits an read into the read buffer, which completes as soon as data is available.
+	 * @param bufferCapacity The max number of bytes to read, limited to the size of the read buffer
+	 * @return false if the operation could not be submitted
+	 */
+	bool submitRead(int fd, unsigned long bufferCapacity);
+
+	/**
+	 * Copies the data of the completed read into the buffer.
+	 * Data which does not fit is kept and returned by the next call.
+	 * @return The number of bytes copied, -1 if the read is still pending, less than -1 if it failed
+	 */
+	long long int takeRead(char* buffer, unsigned long bufferCapacity);
+
+	/**
+	 * Copies as much of the data as fits into the write buffer and submits an write, which completes as soon as the transmit buffer has space.
+	 * @return false if the operation could not be submitted
+	 */
+	bool submitWrite(int fd, const char* buffer, unsigned long bufferLength);
+
+	/**
+	 * Returns the result of the completed write.
+	 * @return The number of bytes written, -1 if the write is still pending, less than -1 if it failed
+	 */
+	long long int takeWrite();
+
+	/**
+	 * Waits until an completion is available or the abort event is signaled.
+	 * @param abortHandle An eventfd which releases the wait
+	 * @param timeout The max time to wait in ms, less than zero to wait indefinitely
+	 * @return false if the wait was aborted or failed, true otherwise
+	 */
+	bool waitCompletion(int abortHandle, int timeout);
+
+	/**
+	 * Cancels the pending read or write and waits for it to complete.
+	 * Data read before the cancellation took effect is kept and returned by takeRead().
+	 */
+	void cancelRead();
+	void cancelWrite();
+
+	/**
+	 * Cancels all pending operations and discards their data, called when the port is closed.
+	 * Waits until the kernel completed all of them, since they still reference the bounce buffers.
+	 */
+	void reset();
+
+};
+
+#endif
+
+#endif
@@ -39,6 +39,7 @@ typedef struct SerialPortConfiguration {
 	SerialPortFlowControl flowControl;
 	char xonChar;
 	char xoffChar;
+	bool lowLatency; // request minimal receive latency from the driver, getConfig() reports if it is actually active
 } SerialPortConfig;
 
 static const SerialPortConfig DEFAULT_PORT_CONFIGURATION = {
@@ -48,7 +49,8 @@ static const SerialPortConfig DEFAULT_PORT_CONFIGURATION = {
 	.parity = SPC_PARITY_NONE,
 	.flowControl = SPC_FLOW_NONE,
 	.xonChar = 17,
-	.xoffChar = 19
+	.xoffChar = 19,
+	.lowLatency = false
 };
 
 static const int DEFAULT_PORT_RX_TIMEOUT = -1;
@@ -64,6 +66,7 @@ public:
 	/**
 	 * Applies the supplied configuration to the port.
 	 * The port has to be open for this to work.
+	 * The low latency mode is applied on a best effort basis and does not cause this to fail, use getConfig() to check if it took effect.
 	 * @param config The configuration struct to apply
 	 * @return true if the configuration was set, false if an error occurred
 	 */
@@ -147,6 +150,8 @@ public:
 	 *
 	 * NOTE:
 	 * If wait is false, the caller has to make sure the source buffer remains valid until the event finished.
+	 * If wait is false and the read can not complete immediately, it remains pending and the next call returns its result.
+	 * On linux, the completion of an pending read ends waitForEvents() with an data received event and signals the event handle, even if this event was not requested.
 	 * @param buffer The buffer to write the data to
 	 * @param bufferCapacity The capacity of the buffer, aka the max number of bytes to read
 	 * @return The number of bytes read, -1 if the event is still pending, a value less than -1 if an error occurred
@@ -159,6 +164,8 @@ public:
 	 *
 	 * NOTE:
 	 * If wait is false, the caller has to make sure the target buffer remains valid until the event finished.
+	 * If wait is false and the write can not complete immediately, it remains pending and the next call returns its result.
+	 * On linux, the completion of an pending write ends waitForEvents() with an data transmitted event and signals the event handle, even if this event was not requested.
 	 * @param buffer The buffer to read the data from
 	 * @param bufferLength The length of the buffer, aka the number of bytes to write
 	 * @return The number of bytes written, -1 if the event is still pending, a value less than -1 if an error occurred
@@ -208,6 +215,22 @@ public:
 	 */
 	virtual void abortWait() = 0;
 
+	/**
+	 * Releases the current wait for events operation, or the next one if no wait is in progress, can be called from any thread.
+	 * In contrast to abortWait(), the wakeup is not lost if it arrives before the wait started, and the wait returns normally without any events set.
+	 * The wakeup also signals the event handle until it is consumed by waitForEvents(), so it releases external event loops too.
+	 */
+	virtual void wakeup() = 0;
+
+	/**
+	 * Returns an native handle which is signaled while an event enabled by the last waitForEvents() call is pending.
+	 * This allows the port to be integrated into an external event loop, the events are then collected by calling waitForEvents() with wait set to false.
+	 * On linux this is an pollable file descriptor, on windows the event handle of the pending wait operation.
+	 * The handle remains owned by the port and is only guaranteed to be valid while the port is open.
+	 * @return The native event handle
+	 */
+	virtual long long int getEventHandle() = 0;
+
 };
 
 SerialPort* newSerialPort(const char* portFile);
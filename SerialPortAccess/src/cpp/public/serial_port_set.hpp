@@ -0,0 +1,73 @@
+#ifndef SERIAL_PORT_SET_HPP_
+#define SERIAL_PORT_SET_HPP_
+
+#include "serial_port.hpp"
+
+namespace SerialAccess {
+
+typedef struct SerialPortEvent {
+	SerialPort* port;
+	bool comStateChange;
+	bool dataReceived;
+	bool dataTransmitted;
+	bool portClosed;
+} SerialPortEvent;
+
+class SerialPortSet
+{
+
+public:
+	virtual ~SerialPortSet() {};
+
+	/**
+	 * Adds the port to the set, or replaces the events requested for it if it is already part of the set.
+	 * The flags have the same meaning as the arguments of SerialPort::waitForEvents().
+	 * The port has to be open, and waitForEvents() should not be called on it by anything else while it is part of the set.
+	 * The set does not take ownership of the port, it has to be removed before it is deleted.
+	 * @param port The port to add
+	 * @param comStateChange COM state (DSR, CTS) change event
+	 * @param dataReceived data received event
+	 * @param dataTransmitted transmission buffer is ready for new data
+	 * @return true if the port was added, false if an error occurred or the set is full
+	 */
+	virtual bool addPort(SerialPort* port, bool comStateChange, bool dataReceived, bool dataTransmitted) = 0;
+
+	/**
+	 * Removes the port from the set.
+	 * If the port is not part of the set, this has no affect.
+	 * @param port The port to remove
+	 */
+	virtual void removePort(SerialPort* port) = 0;
+
+	/**
+	 * Returns the number of ports currently in the set.
+	 * @return The number of ports in the set
+	 */
+	virtual unsigned int portCount() = 0;
+
+	/**
+	 * Waits until one of the ports in the set has an pending event, and collects the events of all ready ports.
+	 * The events are level triggered, an port is reported again on the next call if its condition (like unread data) persists.
+	 * Ports which where closed are reported with portClosed set and are removed from the set.
+	 *
+	 * NOTE:
+	 * The wait is also released by abortWait() of this set or of any of its ports, and by wakeup() of the ports, in which case it might return with less or no events.
+	 * @param events The array to write the events to, one entry per ready port
+	 * @param maxEvents The capacity of the events array
+	 * @param timeout The time to wait in ms, zero to return immediately, less than zero to wait indefinitely
+	 * @return The number of events written, 0 if the wait timed out or was aborted, -1 if an error occurred
+	 */
+	virtual int wait(SerialPortEvent* events, unsigned int maxEvents, int timeout) = 0;
+
+	/**
+	 * Cancels an pending wait operation.
+	 */
+	virtual void abortWait() = 0;
+
+};
+
+SerialPortSet* newSerialPortSet();
+
+}
+
+#endif
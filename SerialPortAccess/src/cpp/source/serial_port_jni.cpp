@@ -75,6 +75,7 @@ JNIEXPORT jboolean JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1setC
 	jfieldID flowControlField = FindField(env, configClass, "flowControl", "Lde/m_marvin/serialportaccess/SerialPort$SerialPortFlowControl;");
 	jfieldID xonCharField = FindField(env, configClass, "xonChar", "C");
 	jfieldID xoffCharField = FindField(env, configClass, "xoffChar", "C");
+	jfieldID lowLatencyField = FindField(env, configClass, "lowLatency", "Z");
 	jclass stopBitsClass = FindClass(env, "de/m_marvin/serialportaccess/SerialPort$SerialPortStopBits");
 	jfieldID stopBitsValueField = FindField(env, stopBitsClass, "value", "I");
 	jclass parityClass = FindClass(env, "de/m_marvin/serialportaccess/SerialPort$SerialPortParity");
@@ -97,6 +98,7 @@ JNIEXPORT jboolean JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1setC
 	configuration.flowControl = static_cast<SerialPortFlowControl>(env->GetIntField(flowControl, flowControlValueField));
 	configuration.xonChar = (char) env->GetCharField(config, xonCharField);
 	configuration.xoffChar = (char) env->GetCharField(config, xoffCharField);
+	configuration.lowLatency = env->GetBooleanField(config, lowLatencyField);
 
 	return port->setConfig(configuration);
 }
@@ -118,6 +120,7 @@ JNIEXPORT jboolean JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1getC
 	jfieldID flowControlField = FindField(env, configClass, "flowControl", "Lde/m_marvin/serialportaccess/SerialPort$SerialPortFlowControl;");
 	jfieldID xonCharField = FindField(env, configClass, "xonChar", "C");
 	jfieldID xoffCharField = FindField(env, configClass, "xoffChar", "C");
+	jfieldID lowLatencyField = FindField(env, configClass, "lowLatency", "Z");
 	jclass stopBitsClass = FindClass(env, "de/m_marvin/serialportaccess/SerialPort$SerialPortStopBits");
 	jmethodID stopBitsValueMethod = FindMethod(env, stopBitsClass, "fromValue", "(I)Lde/m_marvin/serialportaccess/SerialPort$SerialPortStopBits;");
 	jclass parityClass = FindClass(env, "de/m_marvin/serialportaccess/SerialPort$SerialPortParity");
@@ -137,6 +140,7 @@ JNIEXPORT jboolean JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1getC
 	env->SetObjectField(config, flowControlField, flowControlEnum);
 	env->SetCharField(config, xonCharField, configuration.xonChar);
 	env->SetCharField(config, xoffCharField, configuration.xoffChar);
+	env->SetBooleanField(config, lowLatencyField, (jboolean) configuration.lowLatency);
 
 	return true;
 }
@@ -263,4 +267,10 @@ JNIEXPORT void JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1abortWai
 	port->abortWait();
 }
 
+JNIEXPORT void JNICALL Java_de_m_1marvin_serialportaccess_SerialPort_n_1wakeup(JNIEnv* env, jclass clazz, jlong handle)
+{
+	SerialPort* port = (SerialPort*)handle;
+	port->wakeup();
+}
+
 #endif
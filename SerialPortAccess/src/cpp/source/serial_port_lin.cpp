@@ -1,8 +1,14 @@
 #ifdef PLATFORM_LIN
 
 #include "serial_port.hpp"
+#include "serial_port_uring.hpp"
 #include <thread>
+#include <memory>
+#include <algorithm>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <stdio.h>
 #include <string.h>
 #include <fcntl.h>
@@ -10,7 +16,11 @@
 #include <poll.h>
 #include <unistd.h>
 #include <termios.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <linux/serial.h>
 #include <sys/eventfd.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 
 void printError(const char* format) {
@@ -20,6 +30,9 @@ void printError(const char* format) {
 	printf(format, errorCode, strerror(errorCode));
 }
 
+// interval in which the modem lines are polled if the driver does not support TIOCMIWAIT
+#define PORT_STATE_POLL_INTERVAL 10
+
 int getBaudCfgValue(int baud) {
 	switch (baud) {
 	case 0: return B0; break;
@@ -94,19 +107,382 @@ int getBaudValue(unsigned int baudCfg) {
 	}
 }
 
+// kernel termios2 structure, not exposed by the glibc headers without conflicting with termios.h
+struct SerialTermios2 {
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+
+#define SERIAL_TCGETS2 _IOR('T', 0x2A, struct SerialTermios2)
+#define SERIAL_TCSETS2 _IOW('T', 0x2B, struct SerialTermios2)
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16
+#endif
+
+// receive latency timer of USB serial adapters, in ms
+#define USB_SERIAL_SYSFS_PATH "/sys/bus/usb-serial/devices/"
+#define USB_SERIAL_LOW_LATENCY 1
+
+/**
+ * State of the modem line helper thread, shared with the thread since it can outlive the port.
+ * TIOCMIWAIT can only be interrupted by an signal, which an library loaded trough JNI can not claim,
+ * so the thread is never stopped from outside, it exits after the next line change once it is no longer requested.
+ */
+typedef struct ModemWait {
+	int portHandle = -1; // duplicate of the port handle, the wait remains valid after the port was closed
+	int eventHandle = -1; // duplicate of the modem event, signaled on line changes
+	std::mutex m_state;
+	std::condition_variable cv_state; // waiting point of the polling fallback
+	bool requested = false; // if the last waitForEvents call requested modem line events
+	bool stopped = false; // set when the port was closed, the thread then exits without signaling
+	bool running = false; // if the thread is running
+	int lastState = -1; // DSR and CTS when last checked
+
+	~ModemWait() {
+		if (this->portHandle >= 0) ::close(this->portHandle);
+		if (this->eventHandle >= 0) ::close(this->eventHandle);
+	}
+} ModemWait;
+
 class SerialPortLin : public SerialAccess::SerialPort {
 
 private:
 	struct termios comPortState;
-	int comPortHandle;
+	std::atomic<int> comPortHandle; // read by threads waiting on the port while an other one closes it
 	const char* portFileName;
-	int rxTimeout = 0;
-	int rxTimeoutInterval = 0; // NOTE currently not supported by linux, value just stored
+	int rxTimeout = 0; // ms, negative to wait for at least one byte
+	int rxTimeoutInterval = 0; // ms, zero or negative to disable the inter-byte timeout
 	int txTimeout = 0;
 	struct pollfd pollfdRx[2]; // rx, evt
 	struct pollfd pollfdTx[2]; // tx, evt
-	struct pollfd pollfdWait[3]; // rx, tx, evt;
-	bool abortWaitFlag = false;
+	int waitEpollHandle; // epoll set of waitForEvents: port, wait event, modem event, wakeup event
+	int waitEventHandle; // signaled on abort or close
+	int modemEventHandle; // signaled by the modem line helper thread
+	int wakeupEventHandle; // signaled by wakeup(), kept until an wait consumes it
+	unsigned int waitPortEvents = 0; // port events requested by the last waitForEvents call
+	bool readPending = false; // if an non blocking read found no data and waits for the port to become readable
+	bool writePending = false; // if an non blocking write found the transmit buffer full and waits for the port to become writable
+	std::mutex m_port; // serializes closePort, which is called by the reading and the writing thread on errors
+	std::shared_ptr<ModemWait> modemWait; // state of the modem line helper thread of the open port
+	bool lowLatencyApplied = false; // if the low latency mode was requested by the last setConfig
+	int savedLatencyTimer = -1; // latency timer of the adapter before low latency mode was enabled
+#ifdef SERIAL_PORT_URING_SUPPORT
+	std::unique_ptr<SerialPortUring> uring; // optional io_uring backend for non blocking reads and writes
+#endif
+
+	/**
+	 * Runs in the modem line helper thread.
+	 * Blocks in TIOCMIWAIT until DSR or CTS change and signals the modem event in the wait epoll set.
+	 * If the driver does not support TIOCMIWAIT, it falls back to polling the lines every PORT_STATE_POLL_INTERVAL ms.
+	 * Returns as soon as the lines changed while no wait requests them, or the port was closed.
+	 */
+	static void modemWaitLoop(std::shared_ptr<ModemWait> modemWait)
+	{
+		bool pollState = false;
+		std::unique_lock<std::mutex> lock(modemWait->m_state);
+		while (modemWait->requested && !modemWait->stopped) {
+
+			// catch changes which happened while not waiting in the ioctl
+			int state = 0;
+			if (::ioctl(modemWait->portHandle, TIOCMGET, &state) == -1) break;
+			state &= TIOCM_DSR | TIOCM_CTS;
+			if (modemWait->lastState >= 0 && state != modemWait->lastState) {
+				unsigned long long val = 1;
+				if (::write(modemWait->eventHandle, (char*) &val, 8) == -1)
+					printError("error %i in SerialPort:modemWaitLoop:write(evtModem): %s\n");
+			}
+			modemWait->lastState = state;
+
+			if (pollState) {
+				modemWait->cv_state.wait_for(lock, std::chrono::milliseconds(PORT_STATE_POLL_INTERVAL), [&modemWait]() { return !modemWait->requested || modemWait->stopped; });
+				continue;
+			}
+
+			// the lock is not held while blocked, so that waits and closePort can change the request meanwhile
+			lock.unlock();
+			int result = ::ioctl(modemWait->portHandle, TIOCMIWAIT, TIOCM_DSR | TIOCM_CTS);
+			int error = errno;
+			lock.lock();
+			if (result == -1 && (error == ENOTTY || error == EINVAL)) {
+				pollState = true;
+				continue;
+			}
+			if (result == -1 && error != EINTR) break;
+
+		}
+		modemWait->running = false;
+	}
+
+	/**
+	 * Starts the modem line helper thread if modem line events are requested and it is not running, or lets it exit if not.
+	 */
+	void requestModemEvents(bool request)
+	{
+		std::lock_guard<std::mutex> portLock(this->m_port);
+		if (this->modemWait == nullptr) return;
+
+		std::lock_guard<std::mutex> lock(this->modemWait->m_state);
+		this->modemWait->requested = request;
+		if (!request) {
+			this->modemWait->cv_state.notify_all();
+			return;
+		}
+		if (this->modemWait->running) return;
+		this->modemWait->running = true;
+		std::thread(modemWaitLoop, this->modemWait).detach();
+	}
+
+	/**
+	 * Releases the modem line helper thread, called by closePort with m_port held.
+	 */
+	void stopModemWait()
+	{
+		if (this->modemWait == nullptr) return;
+
+		bool blocked;
+		{
+			std::lock_guard<std::mutex> lock(this->modemWait->m_state);
+			this->modemWait->stopped = true;
+			blocked = this->modemWait->running;
+		}
+		this->modemWait->cv_state.notify_all();
+
+		// an blocked thread keeps the port open until the lines change, so the hang up on close has to be done here
+		struct termios state;
+		if (blocked && ::tcgetattr(this->comPortHandle, &state) == 0 && (state.c_cflag & HUPCL)) {
+			int lines = TIOCM_DTR | TIOCM_RTS;
+			if (::ioctl(this->comPortHandle, TIOCMBIC, &lines) == -1)
+				printError("error %i in SerialPort:stopModemWait:ioctl(TIOCMBIC): %s\n");
+		}
+		this->modemWait.reset();
+	}
+
+	/**
+	 * Applies this->comPortState together with an arbitrary baud rate in one TCSETS2 call using BOTHER.
+	 * Used for rates not available in the fixed Bxxx table, the line is never switched to an intermediate rate.
+	 */
+	bool setCustomBaud(unsigned long baud, const char* caller)
+	{
+		struct SerialTermios2 comPortState2;
+		comPortState2.c_iflag = this->comPortState.c_iflag;
+		comPortState2.c_oflag = this->comPortState.c_oflag;
+		comPortState2.c_cflag = this->comPortState.c_cflag;
+		comPortState2.c_lflag = this->comPortState.c_lflag;
+		comPortState2.c_line = this->comPortState.c_line;
+		memcpy(comPortState2.c_cc, this->comPortState.c_cc, sizeof(comPortState2.c_cc));
+
+		comPortState2.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+		comPortState2.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+		comPortState2.c_ispeed = comPortState2.c_ospeed = baud;
+
+		if (::ioctl(this->comPortHandle, SERIAL_TCSETS2, &comPortState2) != 0) {
+			if (errno == EBADF || errno == EIO) {
+				closePort();
+				return false;
+			}
+			printf("error %i in SerialPort:%s:ioctl(TCSETS2): %s\n", errno, caller, strerror(errno));
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Reads the baud rate actually applied by the driver.
+	 * Uses TCGETS2 if available, which also reports non standard rates, otherwise the fixed Bxxx table.
+	 */
+	unsigned long readBaud()
+	{
+		struct SerialTermios2 comPortState2;
+		if (::ioctl(this->comPortHandle, SERIAL_TCGETS2, &comPortState2) == 0)
+			return comPortState2.c_ospeed;
+
+		int baudRate = getBaudValue(cfgetospeed(&this->comPortState));
+		return baudRate < 0 ? 0 : baudRate;
+	}
+
+	/**
+	 * Returns the sysfs latency_timer attribute of the port, which only exists for USB serial adapters.
+	 * Symlinks such as /dev/serial/by-id/ are resolved to the tty device first.
+	 */
+	std::string latencyTimerFile()
+	{
+		char devicePath[PATH_MAX];
+		if (::realpath(this->portFileName, devicePath) == NULL) return std::string();
+		const char* deviceName = strrchr(devicePath, '/');
+		return std::string(USB_SERIAL_SYSFS_PATH) + (deviceName == NULL ? devicePath : deviceName + 1) + "/latency_timer";
+	}
+
+	int readLatencyTimer()
+	{
+		std::string timerFile = latencyTimerFile();
+		if (timerFile.empty()) return -1;
+		FILE* file = ::fopen(timerFile.c_str(), "r");
+		if (file == NULL) return -1;
+		int latency = -1;
+		if (::fscanf(file, "%d", &latency) != 1) latency = -1;
+		::fclose(file);
+		return latency;
+	}
+
+	bool writeLatencyTimer(int latency)
+	{
+		std::string timerFile = latencyTimerFile();
+		if (timerFile.empty()) return false;
+		FILE* file = ::fopen(timerFile.c_str(), "w");
+		if (file == NULL) return false; // usually not writable without root or an udev rule
+		bool written = ::fprintf(file, "%d", latency) > 0;
+		return ::fclose(file) == 0 && written;
+	}
+
+	/**
+	 * Enables or disables the low latency mode of the driver.
+	 * Sets ASYNC_LOW_LATENCY trough TIOCSSERIAL and lowers the latency timer of USB serial adapters, if writable.
+	 * Both are optional, the return value only indicates if any of them could be changed.
+	 */
+	bool setLowLatency(bool enable)
+	{
+		bool applied = false;
+
+		struct serial_struct serialInfo;
+		if (::ioctl(this->comPortHandle, TIOCGSERIAL, &serialInfo) == 0) {
+			if (enable)
+				serialInfo.flags |= ASYNC_LOW_LATENCY;
+			else
+				serialInfo.flags &= ~ASYNC_LOW_LATENCY;
+			applied = ::ioctl(this->comPortHandle, TIOCSSERIAL, &serialInfo) == 0;
+		}
+
+		// the latency timer of some adapters is not coupled to the flag, restore the original value when disabled
+		int latency = readLatencyTimer();
+		if (enable && latency > USB_SERIAL_LOW_LATENCY) {
+			if (writeLatencyTimer(USB_SERIAL_LOW_LATENCY)) {
+				this->savedLatencyTimer = latency;
+				applied = true;
+			}
+		} else if (!enable && this->savedLatencyTimer > 0) {
+			if (writeLatencyTimer(this->savedLatencyTimer)) applied = true;
+			this->savedLatencyTimer = -1;
+		}
+
+		return applied;
+	}
+
+	/**
+	 * Checks if the driver currently operates in low latency mode.
+	 */
+	bool getLowLatency()
+	{
+		struct serial_struct serialInfo;
+		if (::ioctl(this->comPortHandle, TIOCGSERIAL, &serialInfo) == 0 && (serialInfo.flags & ASYNC_LOW_LATENCY))
+			return true;
+		int latency = readLatencyTimer();
+		return latency >= 0 && latency <= USB_SERIAL_LOW_LATENCY;
+	}
+
+#ifdef SERIAL_PORT_URING_SUPPORT
+
+	/**
+	 * Waits for the completion of the read started by an previous non blocking call.
+	 * If it does not complete in time, it is cancelled, so that the port is not read by both the ring and readBytes.
+	 * @return The number of bytes read, 0 if it timed out, less than -1 if an error occurred
+	 */
+	long long int finishUringRead(char* buffer, unsigned long bufferCapacity, std::chrono::steady_clock::time_point deadline)
+	{
+		long long int received;
+		while ((received = this->uring->takeRead(buffer, bufferCapacity)) == -1) {
+			int timeout = -1;
+			if (this->rxTimeout >= 0) {
+				auto now = std::chrono::steady_clock::now();
+				timeout = deadline <= now ? 0 : (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count();
+			}
+			if (timeout == 0 || !this->uring->waitCompletion(this->pollfdRx[1].fd, timeout)) {
+				if (!isOpen()) return -2;
+				this->uring->cancelRead();
+				received = this->uring->takeRead(buffer, bufferCapacity);
+				return received == -1 ? 0 : received;
+			}
+		}
+		return received;
+	}
+
+	/**
+	 * Waits for the completion of the write started by an previous non blocking call.
+	 * If it does not complete in time, it is cancelled.
+	 * @return The number of bytes written, less than -1 if an error occurred
+	 */
+	long long int finishUringWrite()
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->txTimeout);
+		long long int written;
+		while ((written = this->uring->takeWrite()) == -1) {
+			int timeout = -1;
+			if (this->txTimeout > 0) {
+				auto now = std::chrono::steady_clock::now();
+				timeout = deadline <= now ? 0 : (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count();
+			}
+			if (timeout == 0 || !this->uring->waitCompletion(this->pollfdTx[1].fd, timeout)) {
+				if (!isOpen()) return -2;
+				this->uring->cancelWrite();
+				written = this->uring->takeWrite();
+				return written == -1 ? 0 : written;
+			}
+		}
+		return written;
+	}
+
+#endif
+
+	void setWaitEvents(int fd, int operation, unsigned int events)
+	{
+		struct epoll_event event;
+		event.events = events;
+		event.data.fd = fd;
+		if (::epoll_ctl(this->waitEpollHandle, operation, fd, &event) == -1)
+			printError("error %i in SerialPort:setWaitEvents:epoll_ctl: %s\n");
+	}
+
+	/**
+	 * Applies the port events requested by the last waitForEvents call, extended by the events the pending operations wait for.
+	 * This makes the event handle signal as soon as an pending read or write can complete.
+	 */
+	void updatePortEvents()
+	{
+		setWaitEvents(this->comPortHandle, EPOLL_CTL_MOD, this->waitPortEvents | (this->readPending ? (uint32_t) EPOLLIN : 0) | (this->writePending ? (uint32_t) EPOLLOUT : 0));
+	}
+
+	/**
+	 * Marks the non blocking read or write as pending or completed, updates the port events if this changed.
+	 */
+	void setReadPending(bool pending)
+	{
+		if (this->readPending == pending) return;
+		this->readPending = pending;
+		updatePortEvents();
+	}
+
+	void setWritePending(bool pending)
+	{
+		if (this->writePending == pending) return;
+		this->writePending = pending;
+		updatePortEvents();
+	}
+
+	void clearEvent(int eventfd)
+	{
+		unsigned long long val;
+		if (::read(eventfd, (char*) &val, 8) == -1 && errno != EAGAIN)
+			printError("error %i in SerialPort:clearEvent:read: %s\n");
+	}
 
 public:
 
@@ -114,35 +490,69 @@ public:
 	{
 		this->portFileName = portFile;
 		this->comPortHandle = -1;
-		this->pollfdTx[1].fd = eventfd(0, 0);
+		this->pollfdTx[1].fd = eventfd(0, EFD_NONBLOCK);
 		this->pollfdTx[1].events = POLLIN;
-		this->pollfdRx[1].fd = eventfd(0, 0);
+		this->pollfdRx[1].fd = eventfd(0, EFD_NONBLOCK);
 		this->pollfdRx[1].events = POLLIN;
-		this->pollfdWait[2].fd = eventfd(0, 0);
-		this->pollfdWait[2].events = POLLIN;
+		this->waitEventHandle = eventfd(0, EFD_NONBLOCK);
+		this->modemEventHandle = eventfd(0, EFD_NONBLOCK);
+		this->wakeupEventHandle = eventfd(0, EFD_NONBLOCK);
+		this->waitEpollHandle = epoll_create1(EPOLL_CLOEXEC);
+		if (this->waitEpollHandle == -1)
+			printError("error %i in SerialPort:SerialPort:epoll_create1: %s\n");
+		setWaitEvents(this->waitEventHandle, EPOLL_CTL_ADD, EPOLLIN);
+		setWaitEvents(this->modemEventHandle, EPOLL_CTL_ADD, 0);
+		setWaitEvents(this->wakeupEventHandle, EPOLL_CTL_ADD, EPOLLIN);
+#ifdef SERIAL_PORT_URING_SUPPORT
+		// completions of the io_uring backend are reported as data or transmit events
+		this->uring.reset(SerialPortUring::create());
+		if (this->uring) setWaitEvents(this->uring->getHandle(), EPOLL_CTL_ADD, EPOLLIN);
+#endif
 	}
 
 	~SerialPortLin() {
 		closePort();
 		::close(this->pollfdRx[1].fd);
 		::close(this->pollfdTx[1].fd);
-		::close(this->pollfdWait[1].fd);
+		::close(this->waitEpollHandle);
+		::close(this->waitEventHandle);
+		::close(this->modemEventHandle);
+		::close(this->wakeupEventHandle);
 	}
 
 	bool openPort() override
 	{
 		if (this->comPortHandle >= 0) return false;
-		this->comPortHandle = ::open(this->portFileName, O_RDWR);
+
+		// reads and writes have to return immediately if they can not complete, they are then continued as pending operation
+		// the io_uring backend waits for the port with an linked poll instead, so that blocking calls still honor the timeouts and the abort event
+		this->comPortHandle = ::open(this->portFileName, O_RDWR | O_NONBLOCK);
 
 		if (isOpen()) {
 			this->pollfdRx[0].fd = this->comPortHandle;
 			this->pollfdRx[0].events = POLLIN;
 			this->pollfdTx[0].fd = this->comPortHandle;
 			this->pollfdTx[0].events = POLLOUT;
-			this->pollfdWait[0].fd = this->comPortHandle;
-			this->pollfdWait[0].events = POLLIN;
-			this->pollfdWait[1].fd = this->comPortHandle;
-			this->pollfdWait[1].events = POLLOUT;
+			this->waitPortEvents = 0;
+			this->readPending = this->writePending = false;
+			setWaitEvents(this->comPortHandle, EPOLL_CTL_ADD, 0);
+
+			// discard close and abort events from an previous session
+			clearEvent(this->pollfdRx[1].fd);
+			clearEvent(this->pollfdTx[1].fd);
+			clearEvent(this->waitEventHandle);
+			clearEvent(this->modemEventHandle);
+
+			// the helper thread is only started once an wait requests modem line events
+			std::shared_ptr<ModemWait> modemWait = std::make_shared<ModemWait>();
+			modemWait->portHandle = ::fcntl(this->comPortHandle, F_DUPFD_CLOEXEC, 0);
+			modemWait->eventHandle = ::fcntl(this->modemEventHandle, F_DUPFD_CLOEXEC, 0);
+			if (modemWait->portHandle < 0 || modemWait->eventHandle < 0) {
+				printError("error %i in SerialPort:openPort:fcntl(F_DUPFD_CLOEXEC): %s\n");
+			} else {
+				std::lock_guard<std::mutex> lock(this->m_port);
+				this->modemWait = modemWait;
+			}
 
 			setConfig(SerialAccess::DEFAULT_PORT_CONFIGURATION);
 			setTimeouts(SerialAccess::DEFAULT_PORT_RX_TIMEOUT, SerialAccess::DEFAULT_PORT_RX_TIMEOUT_MULTIPLIER, SerialAccess::DEFAULT_PORT_TX_TIMEOUT);
@@ -154,7 +564,17 @@ public:
 
 	void closePort() override
 	{
+		// the reading and the writing thread might both fail and close the port at the same time
+		std::lock_guard<std::mutex> lock(this->m_port);
 		if (!isOpen()) return;
+		stopModemWait();
+
+		// the latency timer of USB adapters outlives the port, restore the value it had before the low latency mode
+		if (this->lowLatencyApplied)
+			setLowLatency(false);
+		this->lowLatencyApplied = false;
+
+		setWaitEvents(this->comPortHandle, EPOLL_CTL_DEL, 0);
 		::close(this->comPortHandle);
 		this->comPortHandle = -1;
 
@@ -164,9 +584,14 @@ public:
 			printError("error %i in SerialPort:closePort:write(evtRx): %s\n");
 		if (::write(this->pollfdTx[1].fd, (char*) &val, 8) == -1)
 			printError("error %i in SerialPort:closePort:write(evtTx): %s\n");
-		if (::write(this->pollfdWait[2].fd, (char*) &val, 8) == -1)
+		if (::write(this->waitEventHandle, (char*) &val, 8) == -1)
 			printError("error %i in SerialPort:closePort:write(evtWait): %s\n");
 
+#ifdef SERIAL_PORT_URING_SUPPORT
+		// the pending operations keep the file referenced, they have to be cancelled
+		if (this->uring) this->uring->reset();
+#endif
+
 	}
 
 	bool isOpen() override
@@ -253,8 +678,9 @@ public:
 			return false;
 		}
 
+		// rates not in the Bxxx table are applied trough TCSETS2 together with the other settings
 		int baudCfg = getBaudCfgValue(config.baudRate);
-		if (baudCfg < 0 || ::cfsetspeed(&this->comPortState, baudCfg) != 0) {
+		if (baudCfg >= 0 && ::cfsetspeed(&this->comPortState, baudCfg) != 0) {
 			printError("error %i in SerialPort:setConfig:cfsetspeed: %s\n");
 			return false;
 		}
@@ -263,7 +689,10 @@ public:
 		this->comPortState.c_cc[VSTOP] = config.xoffChar;
 
 		// Save this->comPortHandle settings, also checking for error
-		if (tcsetattr(this->comPortHandle, TCSANOW, &this->comPortState) != 0) {
+		if (baudCfg < 0) {
+			if (!setCustomBaud(config.baudRate, "setConfig"))
+				return false;
+		} else if (tcsetattr(this->comPortHandle, TCSANOW, &this->comPortState) != 0) {
 			if (errno == EBADF || errno == EIO) {
 				closePort();
 				return false;
@@ -272,6 +701,12 @@ public:
 			return 1;
 		}
 
+		// only touch the driver if requested or to revert an previous request, success is reported trough getConfig()
+		if (config.lowLatency || this->lowLatencyApplied) {
+			setLowLatency(config.lowLatency);
+			this->lowLatencyApplied = config.lowLatency;
+		}
+
 		return true;
 	}
 
@@ -288,8 +723,7 @@ public:
 			return false;
 		}
 
-		int baudRate = getBaudValue(cfgetospeed(&this->comPortState));
-		config.baudRate = baudRate < 0 ? 0 : baudRate;
+		config.baudRate = readBaud();
 
 		if (this->comPortState.c_cflag & PARENB) {
 			config.parity = (this->comPortState.c_cflag & PARODD) ? SerialAccess::SPC_PARITY_ODD : SerialAccess::SPC_PARITY_EVEN;
@@ -315,6 +749,7 @@ public:
 
 		config.xonChar = this->comPortState.c_cc[VSTART];
 		config.xoffChar = this->comPortState.c_cc[VSTOP];
+		config.lowLatency = getLowLatency();
 
 		return true;
 	}
@@ -332,8 +767,12 @@ public:
 			return false;
 		}
 
+		// rates not in the Bxxx table are applied trough TCSETS2
 		int baudCfg = getBaudCfgValue(baud);
-		if (baudCfg < 0 || ::cfsetspeed(&this->comPortState, baudCfg) != 0) {
+		if (baudCfg < 0)
+			return setCustomBaud(baud, "setBaud");
+
+		if (::cfsetspeed(&this->comPortState, baudCfg) != 0) {
 			printError("error %i in SerialPort:setBaud:cfsetspeed: %s\n");
 			return false;
 		}
@@ -363,8 +802,7 @@ public:
 			return 0;
 		}
 
-		int baudRate = getBaudValue(cfgetospeed(&this->comPortState));
-		return baudRate < 0 ? 0 : baudRate;
+		return readBaud();
 	}
 
 	bool setTimeouts(int readTimeout, int readTimeoutInterval, int writeTimeout) override
@@ -380,21 +818,11 @@ public:
 			return false;
 		}
 
-		if (readTimeout < 0) {
-			// No timeout, but wait indefinitely for at least one byte
-			// When receiving a byte, wait additional readTimeoutInterval ms for another one before returning
-			this->rxTimeout = -1;
-			this->rxTimeoutInterval = readTimeoutInterval; // NOTE currently not supported by linux, value just stored
-			this->comPortState.c_cc[VTIME] = readTimeoutInterval < 0 ? 0 : (unsigned char) (readTimeoutInterval / 100);
-			this->comPortState.c_cc[VMIN] = 1;
-		} else {
-			// Wait for readTimeout ms, then return no matter what has or has not been received
-			// When receiving a byte, wait additonal readTimeoutInterval ms for another one before returning
-			this->rxTimeout = (unsigned char) (readTimeout / 100);
-			this->rxTimeoutInterval = readTimeoutInterval; // NOTE currently not supported by linux, value just stored
-			this->comPortState.c_cc[VTIME] = readTimeoutInterval < 0 ? 0 : (unsigned char) (readTimeoutInterval / 100);
-			this->comPortState.c_cc[VMIN] = 0;
-		}
+		// the timeouts are implemented by readBytes, the driver only returns what is already buffered
+		this->rxTimeout = readTimeout < 0 ? -1 : readTimeout;
+		this->rxTimeoutInterval = readTimeoutInterval < 0 ? 0 : readTimeoutInterval;
+		this->comPortState.c_cc[VTIME] = 0;
+		this->comPortState.c_cc[VMIN] = 0;
 
 		// Wait for writeTimeout ms for data to be send
 		this->txTimeout = writeTimeout < 0 ? 0 : writeTimeout;
@@ -424,33 +852,109 @@ public:
 	{
 		if (!isOpen()) return -2;
 
-		// if an timeout is configured
-		if (this->rxTimeout != 0) {
+		// poll status of pending operation, return immediately if wait is false
+		if (!wait) {
+#ifdef SERIAL_PORT_URING_SUPPORT
+			// without timeout, the read returns what is buffered, so there is nothing to run in the background
+			if (this->uring && (this->rxTimeout != 0 || !this->uring->isReadIdle())) {
+				// start an new read if none is pending, it completes as soon as data arrives
+				if (this->uring->isReadIdle() && !this->uring->submitRead(this->comPortHandle, bufferCapacity)) {
+					closePort();
+					return -2;
+				}
+				long long int receivedBytes = this->uring->takeRead(buffer, bufferCapacity);
+				if (receivedBytes < -1) closePort();
+				return receivedBytes;
+			}
+#endif
+			// the port does not block, so the read either completes with the buffered data or remains pending
+			ssize_t receivedBytes = ::read(this->comPortHandle, buffer, bufferCapacity);
+			if (receivedBytes < 0 && errno != EAGAIN && errno != EINTR) {
+				closePort();
+				return -2;
+			}
+			if (receivedBytes > 0 || this->rxTimeout == 0) {
+				setReadPending(false);
+				return receivedBytes < 0 ? 0 : receivedBytes;
+			}
+
+			// the event handle signals once data arrived, the next call then completes the read
+			setReadPending(true);
+			return -1; // event still pending, but wait = false
+		}
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->rxTimeout);
+		auto lastReception = std::chrono::steady_clock::now();
+		unsigned long receivedBytes = 0;
+#ifdef SERIAL_PORT_URING_SUPPORT
+		// finish the read started by an previous non blocking call first
+		if (this->uring && !this->uring->isReadIdle()) {
+			long long int received = finishUringRead(buffer, bufferCapacity, deadline);
+			if (received < -1) {
+				closePort();
+				return -2;
+			}
+			// return if data of the operation is left, it is returned by the next call
+			if (!this->uring->isReadIdle()) return received;
+			receivedBytes = received;
+			lastReception = std::chrono::steady_clock::now();
+		}
+#endif
+		while (receivedBytes < bufferCapacity) {
+
+			// read what is buffered by the driver, VMIN and VTIME are zero, so this does not block
+			ssize_t received = ::read(this->comPortHandle, buffer + receivedBytes, bufferCapacity - receivedBytes);
+			if (received < 0 && errno != EAGAIN && errno != EINTR) {
+				closePort();
+				return -2;
+			}
+			if (received > 0) {
+				receivedBytes += received;
+				lastReception = std::chrono::steady_clock::now();
+				continue;
+			}
+
+			// determine how long to wait for the next byte, according to the timeouts
+			auto now = std::chrono::steady_clock::now();
+			auto waitUntil = deadline;
+			if (receivedBytes == 0) {
+				// nothing received yet, only the overall timeout applies
+				if (this->rxTimeout < 0) waitUntil = std::chrono::steady_clock::time_point::max();
+			} else if (this->rxTimeoutInterval > 0) {
+				// the inter-byte timeout restarts with every received byte, bounded by the overall timeout
+				auto intervalEnd = lastReception + std::chrono::milliseconds(this->rxTimeoutInterval);
+				if (this->rxTimeout < 0 || intervalEnd < deadline) waitUntil = intervalEnd;
+			} else if (this->rxTimeout <= 0) {
+				// without inter-byte timeout, only an positive timeout waits for the remaining bytes
+				break;
+			}
+			if (waitUntil <= now) break;
+
+			int timeout = -1;
+			if (waitUntil != std::chrono::steady_clock::time_point::max()) {
+				// round up, poll would otherwise return early and cause an busy loop for the last millisecond
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(waitUntil - now + std::chrono::microseconds(999)).count();
+				timeout = (int) std::min(remaining, (decltype(remaining)) INT_MAX);
+			}
 
-			// poll status of pending operation, return immediately if wait is false
 			this->pollfdRx[0].revents = this->pollfdRx[1].revents = 0;
-			int pollres = ::poll(this->pollfdRx, 2, wait ? this->rxTimeout : 0);
+			int pollres = ::poll(this->pollfdRx, 2, timeout);
 			if (pollres < 0) {
+				if (errno == EINTR) continue;
 				closePort();
 				return -2; // error
-			} else if (pollres == 0) {
-				return -1; // event still pending, but wait = false
 			}
 
-			// operation aborted, return error
-			if (this->pollfdRx[0].revents == 0) {
+			// operation aborted or port disconnected, return error
+			if (this->pollfdRx[1].revents != 0 || (this->pollfdRx[0].revents & (POLLERR | POLLHUP | POLLNVAL))) {
 				closePort();
 				return -2;
 			}
 
 		}
 
-		// perform actual read
-		ssize_t receivedBytes = ::read(this->comPortHandle, buffer, bufferCapacity);
-		if (receivedBytes < 0) {
-			closePort();
-			return -2;
-		}
+		// an read left pending by an previous non blocking call is completed by this one
+		setReadPending(false);
 		return receivedBytes;
 	}
 
@@ -458,33 +962,71 @@ public:
 	{
 		if (!isOpen()) return -2;
 
-		// if an timeout is configured
-		if (this->txTimeout != 0) {
+#ifdef SERIAL_PORT_URING_SUPPORT
+		if (this->uring) {
+			// like overlapped writes on windows, the result of an pending write is returned instead of writing the buffer again
+			long long int writtenBytes = -1;
+			if (!this->uring->isWriteIdle()) {
+				writtenBytes = wait ? finishUringWrite() : this->uring->takeWrite();
+			} else if (!wait) {
+				if (!this->uring->submitWrite(this->comPortHandle, buffer, bufferLength)) {
+					closePort();
+					return -2;
+				}
+				writtenBytes = this->uring->takeWrite();
+			}
+			if (writtenBytes < -1) closePort();
+			if (writtenBytes != -1 || !wait) return writtenBytes;
+		}
+#endif
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->txTimeout);
+		unsigned long writtenBytes = 0;
+		while (writtenBytes < bufferLength) {
+
+			// write as much as fits into the transmit buffer, the port does not block, not even with the io_uring backend
+			ssize_t written = ::write(this->comPortHandle, buffer + writtenBytes, bufferLength - writtenBytes);
+			if (written < 0 && errno != EAGAIN && errno != EINTR) {
+				closePort();
+				return -2;
+			}
+			if (written > 0) {
+				writtenBytes += written;
+				continue;
+			}
+
+			if (!wait) {
+				// the event handle signals once the transmit buffer has space again, the next call then completes the write
+				if (writtenBytes > 0) break;
+				setWritePending(true);
+				return -1; // operation still pending, but wait = false
+			}
+
+			int timeout = -1;
+			if (this->txTimeout > 0) {
+				auto now = std::chrono::steady_clock::now();
+				if (deadline <= now) break;
+				// round up, poll would otherwise return early and cause an busy loop for the last millisecond
+				timeout = (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count();
+			}
 
-			// poll status of pending operation, return immediately if wait is false
 			this->pollfdTx[0].revents = this->pollfdTx[1].revents = 0;
-			int pollres = ::poll(this->pollfdTx, 2, wait ? this->txTimeout : 0);
+			int pollres = ::poll(this->pollfdTx, 2, timeout);
 			if (pollres < 0) {
+				if (errno == EINTR) continue;
 				closePort();
 				return -2; // error
-			} else if (pollres == 0) {
-				return -1; // operation still pending, but wait = false
 			}
 
-			// operation aborted, return error
-			if (this->pollfdTx[0].revents == 0) {
+			// operation aborted or port disconnected, return error
+			if (this->pollfdTx[1].revents != 0 || (this->pollfdTx[0].revents & (POLLERR | POLLHUP | POLLNVAL))) {
 				closePort();
 				return -2;
 			}
 
 		}
 
-		// perform actual write
-		ssize_t writtenBytes = ::write(this->comPortHandle, buffer, bufferLength);
-		if (writtenBytes < 0) {
-			closePort();
-			return -2;
-		}
+		setWritePending(false);
 		return writtenBytes;
 	}
 
@@ -546,57 +1088,92 @@ public:
 		return true;
 	}
 
-#define PORT_STATE_POLL_INTERVAL 10
-
 	bool waitForEvents(bool& comStateChange, bool& dataReceived, bool& dataTransmitted, bool wait) override
 	{
 		if (!isOpen()) return false;
 
-		// read current com port state
-		bool dsrState, ctsState;
-		if (!getPortState(dsrState, ctsState)) return false;
+		// enable read and write event, pending operations additionally enable the event they wait for
+		this->waitPortEvents = (dataReceived ? (uint32_t) EPOLLIN : 0) | (dataTransmitted ? (uint32_t) EPOLLOUT : 0);
+		updatePortEvents();
+		// enable modem line event, the helper thread only watches the lines while they are requested
+		setWaitEvents(this->modemEventHandle, EPOLL_CTL_MOD, comStateChange ? (uint32_t) EPOLLIN : 0);
+		requestModemEvents(comStateChange);
 
-		// enable read event
-		this->pollfdWait[0].events = dataReceived ? POLLIN : 0;
-		// enable write event
-		this->pollfdWait[1].events = dataTransmitted ? POLLOUT : 0;
+		// the completion of an pending operation is reported as data or transmit event, even if it was not requested
+		bool receiveRequested = dataReceived || this->readPending;
+		bool transmitRequested = dataTransmitted || this->writePending;
 
-		bool comStateEvent = false, dataReceiveEvent = false, dataTransmitEvent = false;
-		this->abortWaitFlag = false;
+		bool comStateEvent = false, dataReceiveEvent = false, dataTransmitEvent = false, abortEvent = false, wakeupEvent = false;
 		do {
 
-			// wait for read/write events for interval
-			this->pollfdWait[0].revents = this->pollfdTx[1].revents = this->pollfdTx[2].revents = 0;
-			int pollres = ::poll(this->pollfdWait, 3, wait ? PORT_STATE_POLL_INTERVAL : 0);
-			if (pollres < 0) return false;
+			int timeout = wait ? -1 : 0;
+#ifdef SERIAL_PORT_URING_SUPPORT
+			// completed operations of the io_uring backend are reported like data being available, they might already be reaped
+			if (this->uring) {
+				if (!this->uring->isReadIdle()) receiveRequested = true;
+				if (!this->uring->isWriteIdle()) transmitRequested = true;
+				if (this->uring->isReadDone()) dataReceiveEvent = true;
+				if (this->uring->isWriteDone()) dataTransmitEvent = true;
+				if ((dataReceiveEvent && receiveRequested) || (dataTransmitEvent && transmitRequested)) timeout = 0;
+			}
+#endif
 
-			// check dsr cts state
-			bool dsrNew, ctsNew;
-			if (!getPortState(dsrNew, ctsNew)) return false;
-			if (dsrNew != dsrState || ctsNew != ctsState) {
-				comStateEvent = true;
+			// wait for read/write/modem events
+			struct epoll_event events[5];
+			int eventCount = ::epoll_wait(this->waitEpollHandle, events, 5, timeout);
+			if (eventCount < 0) {
+				if (errno == EINTR) continue;
+				return false;
 			}
 
-			if (pollres > 0) {
-				if (this->pollfdWait[0].revents > 0) dataReceiveEvent = true;
-				if (this->pollfdWait[1].revents > 0) dataTransmitEvent = true;
+			for (int i = 0; i < eventCount; i++) {
+				if (events[i].data.fd == this->comPortHandle) {
+					if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) dataReceiveEvent = true;
+					if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) dataTransmitEvent = true;
+					if (events[i].events & (EPOLLERR | EPOLLHUP)) abortEvent = true;
+				} else if (events[i].data.fd == this->modemEventHandle) {
+					clearEvent(this->modemEventHandle);
+					comStateEvent = true;
+				} else if (events[i].data.fd == this->waitEventHandle) {
+					clearEvent(this->waitEventHandle);
+					abortEvent = true;
+				} else if (events[i].data.fd == this->wakeupEventHandle) {
+					clearEvent(this->wakeupEventHandle);
+					wakeupEvent = true;
+				}
 			}
 
 		} while (	(!comStateEvent || !comStateChange) &&
-					(!dataReceiveEvent || !dataReceived) &&
-					(!dataTransmitEvent || !dataTransmitted)
-					&& wait && isOpen() && !this->abortWaitFlag);
+					(!dataReceiveEvent || !receiveRequested) &&
+					(!dataTransmitEvent || !transmitRequested)
+					&& wait && isOpen() && !abortEvent && !wakeupEvent);
 
 		comStateChange = comStateEvent;
-		dataReceived = dataReceiveEvent;
-		dataTransmitted = dataTransmitEvent;
+		dataReceived = dataReceiveEvent && receiveRequested;
+		dataTransmitted = dataTransmitEvent && transmitRequested;
 		return true;
 	}
 
 	void abortWait() override
 	{
 		// signal event wait loop to exit
-		this->abortWaitFlag = true;
+		unsigned long long val = 1;
+		if (::write(this->waitEventHandle, (char*) &val, 8) == -1)
+			printError("error %i in SerialPort:abortWait:write(evtWait): %s\n");
+	}
+
+	void wakeup() override
+	{
+		// the eventfd keeps the signal until the next wait consumes it, so an wakeup can not get lost
+		unsigned long long val = 1;
+		if (::write(this->wakeupEventHandle, (char*) &val, 8) == -1)
+			printError("error %i in SerialPort:wakeup:write(evtWakeup): %s\n");
+	}
+
+	long long int getEventHandle() override
+	{
+		// the epoll set itself is pollable, it signals if an event enabled by the last waitForEvents call is pending
+		return this->waitEpollHandle;
 	}
 
 };
@@ -0,0 +1,179 @@
+#ifdef PLATFORM_LIN
+
+#include "serial_port_set.hpp"
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+void printError(const char* format);
+
+// max number of epoll events collected by an single wait
+#define PORT_SET_MAX_EVENTS 64
+
+typedef struct SerialPortSetEntry {
+	long long int eventHandle;
+	bool comStateChange;
+	bool dataReceived;
+	bool dataTransmitted;
+} SerialPortSetEntry;
+
+class SerialPortSetLin : public SerialAccess::SerialPortSet {
+
+private:
+	int setEpollHandle; // epoll set of the port event handles and the abort event
+	int abortEventHandle;
+	std::mutex m_ports;
+	std::map<SerialAccess::SerialPort*, SerialPortSetEntry> ports;
+
+	/**
+	 * Collects the pending events of the port, this also applies the requested events to the event handle of the port.
+	 * Closed ports are removed from the set.
+	 * Has to be called with m_ports locked.
+	 */
+	bool collectEvents(SerialAccess::SerialPort* port, SerialPortSetEntry& entry, SerialAccess::SerialPortEvent& event)
+	{
+		event.port = port;
+		event.comStateChange = entry.comStateChange;
+		event.dataReceived = entry.dataReceived;
+		event.dataTransmitted = entry.dataTransmitted;
+		event.portClosed = !port->waitForEvents(event.comStateChange, event.dataReceived, event.dataTransmitted, false);
+
+		if (event.portClosed) {
+			event.comStateChange = event.dataReceived = event.dataTransmitted = false;
+			::epoll_ctl(this->setEpollHandle, EPOLL_CTL_DEL, (int) entry.eventHandle, NULL);
+			this->ports.erase(port);
+			return true;
+		}
+
+		return event.comStateChange || event.dataReceived || event.dataTransmitted;
+	}
+
+public:
+
+	SerialPortSetLin()
+	{
+		this->setEpollHandle = epoll_create1(EPOLL_CLOEXEC);
+		if (this->setEpollHandle == -1)
+			printError("error %i in SerialPortSet:SerialPortSet:epoll_create1: %s\n");
+		this->abortEventHandle = eventfd(0, EFD_NONBLOCK);
+
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		if (::epoll_ctl(this->setEpollHandle, EPOLL_CTL_ADD, this->abortEventHandle, &event) == -1)
+			printError("error %i in SerialPortSet:SerialPortSet:epoll_ctl: %s\n");
+	}
+
+	~SerialPortSetLin()
+	{
+		::close(this->setEpollHandle);
+		::close(this->abortEventHandle);
+	}
+
+	bool addPort(SerialAccess::SerialPort* port, bool comStateChange, bool dataReceived, bool dataTransmitted) override
+	{
+		if (port == NULL || !port->isOpen()) return false;
+		std::lock_guard<std::mutex> lock(this->m_ports);
+
+		// the event handle of the port signals while an requested event is pending, so the port epoll set is nested into this one
+		SerialPortSetEntry entry;
+		entry.eventHandle = port->getEventHandle();
+		entry.comStateChange = comStateChange;
+		entry.dataReceived = dataReceived;
+		entry.dataTransmitted = dataTransmitted;
+
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = port;
+		auto existing = this->ports.find(port);
+		if (existing == this->ports.end()) {
+			if (::epoll_ctl(this->setEpollHandle, EPOLL_CTL_ADD, (int) entry.eventHandle, &event) == -1) {
+				printError("error %i in SerialPortSet:addPort:epoll_ctl: %s\n");
+				return false;
+			}
+		}
+		this->ports[port] = entry;
+
+		// apply the requested events to the port, events already pending are reported by the next wait
+		bool comState = comStateChange, received = dataReceived, transmitted = dataTransmitted;
+		if (!port->waitForEvents(comState, received, transmitted, false)) {
+			::epoll_ctl(this->setEpollHandle, EPOLL_CTL_DEL, (int) entry.eventHandle, NULL);
+			this->ports.erase(port);
+			return false;
+		}
+		return true;
+	}
+
+	void removePort(SerialAccess::SerialPort* port) override
+	{
+		std::lock_guard<std::mutex> lock(this->m_ports);
+
+		auto entry = this->ports.find(port);
+		if (entry == this->ports.end()) return;
+		::epoll_ctl(this->setEpollHandle, EPOLL_CTL_DEL, (int) entry->second.eventHandle, NULL);
+		this->ports.erase(entry);
+	}
+
+	unsigned int portCount() override
+	{
+		std::lock_guard<std::mutex> lock(this->m_ports);
+		return this->ports.size();
+	}
+
+	int wait(SerialAccess::SerialPortEvent* events, unsigned int maxEvents, int timeout) override
+	{
+		if (maxEvents == 0) return 0;
+
+		struct epoll_event readyEvents[PORT_SET_MAX_EVENTS];
+		int readyCount;
+		do {
+			readyCount = ::epoll_wait(this->setEpollHandle, readyEvents, maxEvents < PORT_SET_MAX_EVENTS ? maxEvents : PORT_SET_MAX_EVENTS, timeout);
+		} while (readyCount < 0 && errno == EINTR);
+		if (readyCount < 0) {
+			printError("error %i in SerialPortSet:wait:epoll_wait: %s\n");
+			return -1;
+		}
+
+		std::lock_guard<std::mutex> lock(this->m_ports);
+		unsigned int eventCount = 0;
+		for (int i = 0; i < readyCount; i++) {
+
+			// abort event
+			if (readyEvents[i].data.ptr == NULL) {
+				unsigned long long val;
+				if (::read(this->abortEventHandle, (char*) &val, 8) == -1 && errno != EAGAIN)
+					printError("error %i in SerialPortSet:wait:read: %s\n");
+				continue;
+			}
+
+			// the port might have been removed after epoll_wait returned
+			SerialAccess::SerialPort* port = (SerialAccess::SerialPort*) readyEvents[i].data.ptr;
+			auto entry = this->ports.find(port);
+			if (entry == this->ports.end()) continue;
+
+			if (collectEvents(port, entry->second, events[eventCount]))
+				eventCount++;
+		}
+
+		return eventCount;
+	}
+
+	void abortWait() override
+	{
+		unsigned long long val = 1;
+		if (::write(this->abortEventHandle, (char*) &val, 8) == -1)
+			printError("error %i in SerialPortSet:abortWait:write: %s\n");
+	}
+
+};
+
+SerialAccess::SerialPortSet* SerialAccess::newSerialPortSet() {
+	return new SerialPortSetLin();
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifdef PLATFORM_WIN
+
+#include "serial_port_set.hpp"
+#include <windows.h>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+
+void printError(const char* format);
+
+typedef struct SerialPortSetEntry {
+	SerialAccess::SerialPort* port;
+	bool comStateChange;
+	bool dataReceived;
+	bool dataTransmitted;
+} SerialPortSetEntry;
+
+class SerialPortSetWin : public SerialAccess::SerialPortSet {
+
+private:
+	HANDLE abortEventHandle;
+	std::mutex m_ports;
+	std::vector<SerialPortSetEntry> ports;
+
+	/**
+	 * Collects the pending events of the port, this also starts an new wait operation on the port if none is pending.
+	 * Closed ports are removed from the set.
+	 * Has to be called with m_ports locked.
+	 */
+	bool collectEvents(unsigned int index, SerialAccess::SerialPortEvent& event)
+	{
+		SerialPortSetEntry& entry = this->ports[index];
+		event.port = entry.port;
+		event.comStateChange = entry.comStateChange;
+		event.dataReceived = entry.dataReceived;
+		event.dataTransmitted = entry.dataTransmitted;
+		event.portClosed = !entry.port->waitForEvents(event.comStateChange, event.dataReceived, event.dataTransmitted, false);
+
+		if (event.portClosed) {
+			event.comStateChange = event.dataReceived = event.dataTransmitted = false;
+			this->ports.erase(this->ports.begin() + index);
+			return true;
+		}
+
+		return event.comStateChange || event.dataReceived || event.dataTransmitted;
+	}
+
+	/**
+	 * Collects the pending events of all ports.
+	 * Has to be called with m_ports locked.
+	 */
+	unsigned int collectAllEvents(SerialAccess::SerialPortEvent* events, unsigned int maxEvents)
+	{
+		unsigned int eventCount = 0;
+		unsigned int index = 0;
+		while (index < this->ports.size() && eventCount < maxEvents) {
+			bool ready = collectEvents(index, events[eventCount]);
+			if (!ready || !events[eventCount].portClosed) index++; // closed entries are removed from the list
+			if (ready) eventCount++;
+		}
+		return eventCount;
+	}
+
+public:
+
+	SerialPortSetWin()
+	{
+		this->abortEventHandle = CreateEventA(NULL, FALSE, FALSE, NULL);
+		if (this->abortEventHandle == NULL)
+			printError("error 0x%x in SerialPortSet:SerialPortSet:CreateEventA: %s");
+	}
+
+	~SerialPortSetWin()
+	{
+		CloseHandle(this->abortEventHandle);
+	}
+
+	bool addPort(SerialAccess::SerialPort* port, bool comStateChange, bool dataReceived, bool dataTransmitted) override
+	{
+		if (port == NULL || !port->isOpen()) return false;
+		std::lock_guard<std::mutex> lock(this->m_ports);
+
+		for (SerialPortSetEntry& entry : this->ports) {
+			if (entry.port != port) continue;
+			entry.comStateChange = comStateChange;
+			entry.dataReceived = dataReceived;
+			entry.dataTransmitted = dataTransmitted;
+			return true;
+		}
+
+		// one wait handle is reserved for the abort event
+		if (this->ports.size() >= MAXIMUM_WAIT_OBJECTS - 1) return false;
+		this->ports.push_back({ port, comStateChange, dataReceived, dataTransmitted });
+		return true;
+	}
+
+	void removePort(SerialAccess::SerialPort* port) override
+	{
+		std::lock_guard<std::mutex> lock(this->m_ports);
+
+		for (auto entry = this->ports.begin(); entry != this->ports.end(); entry++) {
+			if (entry->port != port) continue;
+			this->ports.erase(entry);
+			return;
+		}
+	}
+
+	unsigned int portCount() override
+	{
+		std::lock_guard<std::mutex> lock(this->m_ports);
+		return this->ports.size();
+	}
+
+	int wait(SerialAccess::SerialPortEvent* events, unsigned int maxEvents, int timeout) override
+	{
+		if (maxEvents == 0) return 0;
+
+		// the wait handles of the ports are only signaled while an wait operation is pending, collecting the events starts them
+		HANDLE waitHandles[MAXIMUM_WAIT_OBJECTS];
+		DWORD handleCount = 0;
+		unsigned int eventCount = 0;
+		{
+			std::lock_guard<std::mutex> lock(this->m_ports);
+			eventCount = collectAllEvents(events, maxEvents);
+			if (eventCount > 0) return eventCount;
+
+			for (SerialPortSetEntry& entry : this->ports)
+				waitHandles[handleCount++] = (HANDLE) entry.port->getEventHandle();
+		}
+		waitHandles[handleCount++] = this->abortEventHandle;
+
+		DWORD result = WaitForMultipleObjects(handleCount, waitHandles, FALSE, timeout < 0 ? INFINITE : (DWORD) timeout);
+		if (result == WAIT_FAILED) {
+			printError("error 0x%x in SerialPortSet:wait:WaitForMultipleObjects: %s");
+			return -1;
+		}
+		if (result == WAIT_TIMEOUT || result == WAIT_OBJECT_0 + handleCount - 1) return 0;
+
+		// collect the completed events, the ports might have changed in the meantime, so check all of them
+		std::lock_guard<std::mutex> lock(this->m_ports);
+		return collectAllEvents(events, maxEvents);
+	}
+
+	void abortWait() override
+	{
+		if (!SetEvent(this->abortEventHandle))
+			printError("error 0x%x in SerialPortSet:abortWait:SetEvent: %s");
+	}
+
+};
+
+SerialAccess::SerialPortSet* SerialAccess::newSerialPortSet() {
+	return new SerialPortSetWin();
+}
+
+#endif
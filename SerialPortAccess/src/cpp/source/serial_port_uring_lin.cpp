@@ -0,0 +1,431 @@
+#ifdef PLATFORM_LIN
+
+#include "serial_port_uring.hpp"
+
+#ifdef SERIAL_PORT_URING_SUPPORT
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+void printError(const char* format);
+
+// user data of the submitted operations
+#define URING_TAG_POLL_READ 1
+#define URING_TAG_READ 2
+#define URING_TAG_WRITE 3
+#define URING_TAG_CANCEL 4
+#define URING_TAG_POLL_WRITE 5
+// offset of -1 uses the current file position, required for non seekable files like ttys
+#define URING_CURRENT_POS ((unsigned long long) -1)
+
+SerialPortUring::SerialPortUring()
+{
+	this->ringHandle = -1;
+	this->sqRing = this->cqRing = MAP_FAILED;
+	this->sqEntries = (struct io_uring_sqe*) MAP_FAILED;
+	this->sqQueued = 0;
+	this->cqOverflowSeen = 0;
+	this->fixedBuffers = false;
+	this->readState = this->writeState = URING_IDLE;
+	this->readResult = this->writeResult = 0;
+	this->readOffset = 0;
+	this->readHandle = this->writeHandle = -1;
+	this->readLength = this->writeLength = 0;
+	this->readCancelled = this->writeCancelled = false;
+}
+
+SerialPortUring::~SerialPortUring()
+{
+	if (this->sqEntries != MAP_FAILED) ::munmap(this->sqEntries, this->sqEntriesLen);
+	if (this->cqRing != MAP_FAILED && this->cqRing != this->sqRing) ::munmap(this->cqRing, this->cqRingLen);
+	if (this->sqRing != MAP_FAILED) ::munmap(this->sqRing, this->sqRingLen);
+	if (this->ringHandle >= 0) ::close(this->ringHandle);
+}
+
+SerialPortUring* SerialPortUring::create()
+{
+	const char* enabled = ::getenv(SERIAL_PORT_URING_ENV);
+	if (enabled == NULL || strcmp(enabled, "1") != 0) return nullptr;
+
+	SerialPortUring* uring = new SerialPortUring();
+	if (!uring->setup()) {
+		// not supported by the kernel or blocked by an seccomp filter, fall back to poll() and read()/write()
+		printError("error %i in SerialPortUring:create:setup, falling back to poll: %s\n");
+		delete uring;
+		return nullptr;
+	}
+	return uring;
+}
+
+bool SerialPortUring::setup()
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	this->ringHandle = ::syscall(__NR_io_uring_setup, SERIAL_PORT_URING_ENTRIES, &params);
+	if (this->ringHandle < 0) return false;
+
+	// check if all required operations are supported by the kernel
+	size_t probeLen = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe* probe = (struct io_uring_probe*) calloc(1, probeLen);
+	if (probe == NULL) return false;
+	bool supported = ::syscall(__NR_io_uring_register, this->ringHandle, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+	for (int operation : { IORING_OP_POLL_ADD, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ASYNC_CANCEL }) {
+		if (!supported) break;
+		supported = operation <= probe->last_op && (probe->ops[operation].flags & IO_URING_OP_SUPPORTED);
+	}
+	free(probe);
+	if (!supported) {
+		errno = ENOSYS;
+		return false;
+	}
+
+	// map the submission and completion queues
+	this->sqRingLen = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	this->cqRingLen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMap) this->sqRingLen = this->cqRingLen = this->sqRingLen > this->cqRingLen ? this->sqRingLen : this->cqRingLen;
+	this->sqRing = ::mmap(NULL, this->sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringHandle, IORING_OFF_SQ_RING);
+	if (this->sqRing == MAP_FAILED) return false;
+	this->cqRing = singleMap ? this->sqRing : ::mmap(NULL, this->cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringHandle, IORING_OFF_CQ_RING);
+	if (this->cqRing == MAP_FAILED) return false;
+	this->sqEntriesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+	this->sqEntries = (struct io_uring_sqe*) ::mmap(NULL, this->sqEntriesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringHandle, IORING_OFF_SQES);
+	if (this->sqEntries == MAP_FAILED) return false;
+
+	this->sqHead = (unsigned int*) ((char*) this->sqRing + params.sq_off.head);
+	this->sqTail = (unsigned int*) ((char*) this->sqRing + params.sq_off.tail);
+	this->sqMask = (unsigned int*) ((char*) this->sqRing + params.sq_off.ring_mask);
+	this->sqArray = (unsigned int*) ((char*) this->sqRing + params.sq_off.array);
+	this->sqFlags = (unsigned int*) ((char*) this->sqRing + params.sq_off.flags);
+	this->cqHead = (unsigned int*) ((char*) this->cqRing + params.cq_off.head);
+	this->cqTail = (unsigned int*) ((char*) this->cqRing + params.cq_off.tail);
+	this->cqMask = (unsigned int*) ((char*) this->cqRing + params.cq_off.ring_mask);
+	this->cqEntries = (struct io_uring_cqe*) ((char*) this->cqRing + params.cq_off.cqes);
+	this->cqOverflow = (unsigned int*) ((char*) this->cqRing + params.cq_off.overflow);
+
+	// registered buffers save the page pinning on every operation, but might exceed the memlock limit on older kernels
+	struct iovec buffers[2];
+	buffers[0].iov_base = this->readBuffer;
+	buffers[0].iov_len = SERIAL_PORT_URING_BUFFER_LEN;
+	buffers[1].iov_base = this->writeBuffer;
+	buffers[1].iov_len = SERIAL_PORT_URING_BUFFER_LEN;
+	this->fixedBuffers = ::syscall(__NR_io_uring_register, this->ringHandle, IORING_REGISTER_BUFFERS, buffers, 2) == 0;
+
+	return true;
+}
+
+struct io_uring_sqe* SerialPortUring::nextEntry()
+{
+	// this is the only producer, so only the head written by the kernel has to be synchronized
+	unsigned int tail = *this->sqTail + this->sqQueued;
+	unsigned int head = __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE);
+	if (tail - head > *this->sqMask) return nullptr;
+
+	// the entry is only published by submit(), after the caller filled it
+	unsigned int index = tail & *this->sqMask;
+	struct io_uring_sqe* entry = &this->sqEntries[index];
+	memset(entry, 0, sizeof(struct io_uring_sqe));
+	this->sqArray[index] = index;
+	this->sqQueued++;
+	return entry;
+}
+
+bool SerialPortUring::submit()
+{
+	// the release store makes the filled entries visible to the kernel before it sees the new tail
+	unsigned int count = this->sqQueued;
+	__atomic_store_n(this->sqTail, *this->sqTail + count, __ATOMIC_RELEASE);
+	this->sqQueued = 0;
+
+	while (count > 0) {
+		int submitted = ::syscall(__NR_io_uring_enter, this->ringHandle, count, 0, 0, NULL, 0);
+		if (submitted < 0) {
+			if (errno == EINTR) continue;
+			printError("error %i in SerialPortUring:submit:io_uring_enter: %s\n");
+			return false;
+		}
+		count -= submitted;
+	}
+	return true;
+}
+
+bool SerialPortUring::queueRead()
+{
+	// the read is linked behind an poll, the port does not block and would complete the read without data otherwise
+	struct io_uring_sqe* poll = nextEntry();
+	if (poll == nullptr) return false;
+	poll->opcode = IORING_OP_POLL_ADD;
+	poll->fd = this->readHandle;
+	poll->poll32_events = POLLIN;
+	poll->flags = IOSQE_IO_LINK;
+	poll->user_data = URING_TAG_POLL_READ;
+
+	struct io_uring_sqe* read = nextEntry();
+	if (read == nullptr) {
+		this->sqQueued = 0;
+		return false;
+	}
+	read->opcode = this->fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	read->fd = this->readHandle;
+	read->addr = (unsigned long long) this->readBuffer;
+	read->len = this->readLength;
+	read->off = URING_CURRENT_POS;
+	read->buf_index = 0;
+	read->user_data = URING_TAG_READ;
+
+	this->readState = URING_PENDING;
+	this->readCancelled = false;
+	return submit();
+}
+
+bool SerialPortUring::queueWrite()
+{
+	// like the read, the write is linked behind an poll, it would fail with EAGAIN while the transmit buffer is full otherwise
+	struct io_uring_sqe* poll = nextEntry();
+	if (poll == nullptr) return false;
+	poll->opcode = IORING_OP_POLL_ADD;
+	poll->fd = this->writeHandle;
+	poll->poll32_events = POLLOUT;
+	poll->flags = IOSQE_IO_LINK;
+	poll->user_data = URING_TAG_POLL_WRITE;
+
+	struct io_uring_sqe* write = nextEntry();
+	if (write == nullptr) {
+		this->sqQueued = 0;
+		return false;
+	}
+	write->opcode = this->fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	write->fd = this->writeHandle;
+	write->addr = (unsigned long long) this->writeBuffer;
+	write->len = this->writeLength;
+	write->off = URING_CURRENT_POS;
+	write->buf_index = 1;
+	write->user_data = URING_TAG_WRITE;
+
+	this->writeState = URING_PENDING;
+	this->writeCancelled = false;
+	return submit();
+}
+
+void SerialPortUring::reap()
+{
+	unsigned int head = *this->cqHead;
+	unsigned int tail = __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		struct io_uring_cqe* completion = &this->cqEntries[head & *this->cqMask];
+		// the tty can report the port ready and still fail the operation, e.g. if it was interrupted, it is then submitted again
+		bool retry = completion->res == -EAGAIN || completion->res == -EINTR;
+		switch (completion->user_data) {
+		case URING_TAG_READ:
+			if (retry && !this->readCancelled && queueRead()) break;
+			this->readResult = completion->res;
+			this->readOffset = 0;
+			this->readState = URING_DONE;
+			break;
+		case URING_TAG_WRITE:
+			if (retry && !this->writeCancelled && queueWrite()) break;
+			this->writeResult = completion->res;
+			this->writeState = URING_DONE;
+			break;
+		default:
+			break; // the poll and cancel results are reflected by the read and write results
+		}
+		head++;
+	}
+	__atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);
+
+	// completions which did not fit into the queue are held back by the kernel until they are flushed by an enter call
+	if (__atomic_load_n(this->sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+		if (::syscall(__NR_io_uring_enter, this->ringHandle, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			printError("error %i in SerialPortUring:reap:io_uring_enter: %s\n");
+		else if (__atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE) != head)
+			reap();
+	}
+
+	// kernels without IORING_FEAT_NODROP drop them, the affected operation is unknown so all pending ones are failed
+	unsigned int overflow = __atomic_load_n(this->cqOverflow, __ATOMIC_ACQUIRE);
+	if (overflow != this->cqOverflowSeen) {
+		printf("error in SerialPortUring:reap: %u completions were dropped\n", overflow - this->cqOverflowSeen);
+		this->cqOverflowSeen = overflow;
+		if (this->readState == URING_PENDING) {
+			this->readResult = -EIO;
+			this->readState = URING_DONE;
+		}
+		if (this->writeState == URING_PENDING) {
+			this->writeResult = -EIO;
+			this->writeState = URING_DONE;
+		}
+	}
+}
+
+int SerialPortUring::getHandle()
+{
+	return this->ringHandle;
+}
+
+bool SerialPortUring::isReadIdle()
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	return this->readState == URING_IDLE;
+}
+
+bool SerialPortUring::isReadDone()
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	return this->readState == URING_DONE;
+}
+
+bool SerialPortUring::isWriteIdle()
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	return this->writeState == URING_IDLE;
+}
+
+bool SerialPortUring::isWriteDone()
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	return this->writeState == URING_DONE;
+}
+
+bool SerialPortUring::submitRead(int fd, unsigned long bufferCapacity)
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	if (this->readState != URING_IDLE) return false;
+
+	this->readHandle = fd;
+	this->readLength = bufferCapacity < SERIAL_PORT_URING_BUFFER_LEN ? bufferCapacity : SERIAL_PORT_URING_BUFFER_LEN;
+	return queueRead();
+}
+
+long long int SerialPortUring::takeRead(char* buffer, unsigned long bufferCapacity)
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	if (this->readState != URING_DONE) return -1;
+
+	// an cancelled or interrupted read is not an error, it just did not receive anything
+	if (this->readResult < 0) {
+		this->readState = URING_IDLE;
+		return this->readResult == -ECANCELED || this->readResult == -EAGAIN || this->readResult == -EINTR ? 0 : -2;
+	}
+
+	unsigned long available = (unsigned long) this->readResult - this->readOffset;
+	unsigned long taken = available < bufferCapacity ? available : bufferCapacity;
+	memcpy(buffer, this->readBuffer + this->readOffset, taken);
+	this->readOffset += taken;
+	if (this->readOffset >= (unsigned long) this->readResult) this->readState = URING_IDLE;
+	return taken;
+}
+
+bool SerialPortUring::submitWrite(int fd, const char* buffer, unsigned long bufferLength)
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	if (this->writeState != URING_IDLE) return false;
+
+	this->writeHandle = fd;
+	this->writeLength = bufferLength < SERIAL_PORT_URING_BUFFER_LEN ? bufferLength : SERIAL_PORT_URING_BUFFER_LEN;
+	memcpy(this->writeBuffer, buffer, this->writeLength);
+	return queueWrite();
+}
+
+long long int SerialPortUring::takeWrite()
+{
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	reap();
+	if (this->writeState != URING_DONE) return -1;
+
+	this->writeState = URING_IDLE;
+	if (this->writeResult < 0)
+		return this->writeResult == -ECANCELED || this->writeResult == -EAGAIN || this->writeResult == -EINTR ? 0 : -2;
+	return this->writeResult;
+}
+
+bool SerialPortUring::waitCompletion(int abortHandle, int timeout)
+{
+	struct pollfd pollfds[2];
+	pollfds[0].fd = this->ringHandle;
+	pollfds[0].events = POLLIN;
+	pollfds[1].fd = abortHandle;
+	pollfds[1].events = POLLIN;
+	pollfds[0].revents = pollfds[1].revents = 0;
+	int pollres = ::poll(pollfds, 2, timeout);
+	if (pollres < 0) return errno == EINTR;
+	return pollfds[1].revents == 0;
+}
+
+bool SerialPortUring::cancelOperation(unsigned long long tag)
+{
+	struct io_uring_sqe* cancel = nextEntry();
+	if (cancel == nullptr) return false;
+	cancel->opcode = IORING_OP_ASYNC_CANCEL;
+	cancel->addr = tag;
+	cancel->user_data = URING_TAG_CANCEL;
+	return submit();
+}
+
+void SerialPortUring::cancelRead()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->m_ring);
+		reap();
+		if (this->readState != URING_PENDING) return;
+		this->readCancelled = true;
+		// cancelling the poll also cancels the linked read, the read itself is only cancelled if it already started
+		cancelOperation(URING_TAG_POLL_READ);
+		cancelOperation(URING_TAG_READ);
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SERIAL_PORT_URING_CANCEL_TIMEOUT);
+	while (!isReadDone() && std::chrono::steady_clock::now() < deadline)
+		waitCompletion(-1, SERIAL_PORT_URING_CANCEL_TIMEOUT);
+}
+
+void SerialPortUring::cancelWrite()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->m_ring);
+		reap();
+		if (this->writeState != URING_PENDING) return;
+		this->writeCancelled = true;
+		// cancelling the poll also cancels the linked write, the write itself is only cancelled if it already started
+		cancelOperation(URING_TAG_POLL_WRITE);
+		cancelOperation(URING_TAG_WRITE);
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SERIAL_PORT_URING_CANCEL_TIMEOUT);
+	while (!isWriteDone() && std::chrono::steady_clock::now() < deadline)
+		waitCompletion(-1, SERIAL_PORT_URING_CANCEL_TIMEOUT);
+}
+
+void SerialPortUring::reset()
+{
+	// the operations write into the bounce buffers until their completion arrived, so they can not be abandoned
+	while (true) {
+		cancelRead();
+		cancelWrite();
+
+		std::lock_guard<std::mutex> lock(this->m_ring);
+		reap();
+		if (this->readState != URING_PENDING && this->writeState != URING_PENDING) break;
+		printf("error in SerialPortUring:reset: operations not cancelled after %i ms, retrying\n", SERIAL_PORT_URING_CANCEL_TIMEOUT);
+	}
+
+	std::lock_guard<std::mutex> lock(this->m_ring);
+	this->readState = this->writeState = URING_IDLE;
+}
+
+#endif
+
+#endif
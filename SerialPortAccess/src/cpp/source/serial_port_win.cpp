@@ -5,6 +5,8 @@
 #include <windows.h>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <atomic>
 #include <stdio.h>
 
 void printError(const char* format) {
@@ -30,6 +32,8 @@ private:
 	HANDLE writeEventHandle;
 	HANDLE readEventHandle;
 	HANDLE waitEventHandle;
+	std::atomic<bool> wakeupPending; // set by wakeup(), which also signals the wait event handle
+	std::mutex m_port; // keeps closePort() from closing the handles while wakeup() is called from an other thread
 	DWORD eventMask = 0;
 	DWORD eventMaskReturned = 0;
 	HANDLE comPortHandle;
@@ -46,6 +50,7 @@ public:
 		this->writeOverlapped.hEvent = this->writeEventHandle = INVALID_HANDLE_VALUE;
 		this->readOverlapped.hEvent = this->readEventHandle = INVALID_HANDLE_VALUE;
 		this->waitOverlapped.hEvent = this->waitEventHandle = INVALID_HANDLE_VALUE;
+		this->wakeupPending = false;
 	}
 
 	~SerialPortWin() {
@@ -90,6 +95,7 @@ public:
 	void closePort() override
 	{
 		if (!isOpen()) return;
+		std::lock_guard<std::mutex> lock(this->m_port);
 		CloseHandle(this->comPortHandle);
 		if (this->writeEventHandle != NULL)
 			CloseHandle(this->writeEventHandle);
@@ -101,6 +107,7 @@ public:
 		this->writeEventHandle = NULL;
 		this->readEventHandle = NULL;
 		this->waitEventHandle = NULL;
+		this->wakeupPending = false;
 	}
 
 	bool isOpen() override
@@ -206,6 +213,7 @@ public:
 		}
 		config.xonChar = this->comPortState.XonChar;
 		config.xoffChar = this->comPortState.XoffChar;
+		config.lowLatency = false; // the latency timer of USB adapters is an driver setting on windows
 
 		return true;
 	}
@@ -553,12 +561,45 @@ public:
 
 		}
 
+		// pending reads and writes of the requested directions end the wait too, their results are taken by the next readBytes()/writeBytes()
+		bool readPending = dataReceived && this->readOverlapped.hEvent != INVALID_HANDLE_VALUE;
+		bool writePending = dataTransmitted && this->writeOverlapped.hEvent != INVALID_HANDLE_VALUE;
+
 		comStateChange = false;
 		dataReceived = false;
 		dataTransmitted = false;
 
-		// If not, wait for completition
+		// an wakeup is reported like an completed wait without events, the wait operation remains pending
+		// starting the wait operation resets the event handle, so it is signaled again for external event loops
+		if (this->wakeupPending.exchange(false)) {
+			if (!wait && !SetEvent(this->waitEventHandle))
+				printError("error 0x%x in SerialPort:waitForEvents:SetEvent: %s");
+			return true;
+		}
+
+		// If not, wait for completition or an wakeup
+		if (wait) {
+			HANDLE waitHandles[3] = { this->waitEventHandle };
+			DWORD handleCount = 1;
+			if (readPending) waitHandles[handleCount++] = this->readEventHandle;
+			if (writePending) waitHandles[handleCount++] = this->writeEventHandle;
+			DWORD result = WaitForMultipleObjects(handleCount, waitHandles, FALSE, INFINITE);
+			if (result == WAIT_OBJECT_0 && this->wakeupPending.exchange(false)) return true;
+			if (result >= WAIT_OBJECT_0 + 1 && result < WAIT_OBJECT_0 + handleCount) {
+				dataReceived = readPending && waitHandles[result - WAIT_OBJECT_0] == this->readEventHandle;
+				dataTransmitted = writePending && waitHandles[result - WAIT_OBJECT_0] == this->writeEventHandle;
+				return true;
+			}
+			if (result == WAIT_FAILED)
+				printError("error 0x%x in SerialPort:waitForEvents:WaitForMultipleObjects: %s");
+		}
+
 		DWORD returnedBytes;
+		if (!wait && !HasOverlappedIoCompleted(&this->waitOverlapped)) {
+			// clear the signal of an consumed wakeup, so that external event loops do not spin, unless an new one arrived meanwhile
+			ResetEvent(this->waitEventHandle);
+			if (this->wakeupPending) SetEvent(this->waitEventHandle);
+		}
 		if (!GetOverlappedResult(this->comPortHandle, &this->waitOverlapped, &returnedBytes, wait)) {
 			if (GetLastError() == ERROR_IO_INCOMPLETE)
 				return true; // not yet completed
@@ -588,6 +629,21 @@ public:
 		}
 	}
 
+	void wakeup() override
+	{
+		std::lock_guard<std::mutex> lock(this->m_port);
+		if (!isOpen()) return;
+
+		this->wakeupPending = true;
+		if (!SetEvent(this->waitEventHandle))
+			printError("error 0x%x in SerialPort:wakeup:SetEvent: %s");
+	}
+
+	long long int getEventHandle() override
+	{
+		return (long long int) this->waitEventHandle;
+	}
+
 };
 
 SerialAccess::SerialPort* SerialAccess::newSerialPort(const char* portFile) {
@@ -52,6 +52,7 @@ int main(int argc, const char** argv) {
 		printf(" -flowctrl [flow control] : none|xonxoff|rtscts|dsrdtr\n");
 		printf(" -lineedit (send new line) : sendlf|sendcr\n");
 		printf(" -crtolf : prints all carriage returns received as line feeds\n");
+		printf(" -lowlatency : reduce the receive latency of USB serial adapters (linux only, might require root)\n");
 		printf(" -dclose [pipe close delay] : [ms]\n");
 		printf("serial terminal version: " ASSTRING(BUILD_VERSION) "\n");
 		return 1;
@@ -101,6 +102,8 @@ int main(int argc, const char** argv) {
 			lineEditing = true;
 		} else if (flag == "-crtolf") {
 			sendLFonCR = true;
+		} else if (flag == "-lowlatency") {
+			portConfiguration.lowLatency = true;
 		}
 	}
 
@@ -146,6 +149,13 @@ int main(int argc, const char** argv) {
 		return -1;
 	}
 
+	// low latency mode is best effort, check if the driver accepted it
+	if (portConfiguration.lowLatency) {
+		SerialAccess::SerialPortConfiguration appliedConfig;
+		if (!port->getConfig(appliedConfig) || !appliedConfig.lowLatency)
+			printf("[!] low latency mode not supported or not permitted: %s\n", portName.c_str());
+	}
+
 	// start reception thread
 	shouldTerminate = false;
 	std::thread receptionThread(receptionLoop);
@@ -0,0 +1,509 @@
+/*
+ * virtual_serial_port_lin.cpp
+ *
+ * Implements the virtual serial port on linux using an pseudo terminal.
+ * The application opens the slave side trough an symlink, the master side is operated by this class.
+ * The master is put into packet mode and the slave into external processing mode, so that termios changes made by the application are reported trough the master.
+ *
+ *  Created on: 17.10.2026
+ *      Author: agent
+ */
+
+#ifdef PLATFORM_LIN
+
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "virtual_serial_port.hpp"
+
+static void printError(const char* format) {
+	setbuf(stdout, NULL);
+	int errorCode = errno;
+	if (errorCode == 0) return;
+	printf(format, errorCode, strerror(errorCode));
+}
+
+// termios2 is not declared by the libc headers, only used to read back arbitrary baud rates
+struct VirtualTermios2 {
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+#define VIRTUAL_TCGETS2 _IOR('T', 0x2A, struct VirtualTermios2)
+
+// the pty line discipline does not have an configurable buffer size
+#define PTY_BUFFER_SIZE 4096
+
+class VirtualSerialPortLin : public SerialAccess::VirtualSerialPort
+{
+
+private:
+	int masterHandle;
+	int slaveHandle;
+	int waitEventHandle;
+	bool configChangePending;
+	bool linkCreated;
+	std::string portFileName;
+
+	/**
+	 * Consumes an packet mode status byte, an termios change of the application is signaled by TIOCPKT_IOCTL.
+	 */
+	void processPacketStatus(unsigned char status)
+	{
+		if (status & TIOCPKT_IOCTL)
+			this->configChangePending = true;
+	}
+
+	/**
+	 * Removes the port file if it is an link left behind by an previous instance.
+	 * Only links to an pseudo terminal that does no longer exist are removed, anything else at the path is left untouched.
+	 * The number of an closed pseudo terminal is reused, so an link to the own slave is stale too.
+	 * @param slaveName The name of the slave side of the pseudo terminal of this port
+	 * @return true if the path is free to create the link
+	 */
+	bool removeStaleLink(const char* slaveName)
+	{
+		struct stat linkState;
+		if (::lstat(this->portFileName.c_str(), &linkState) != 0) {
+			if (errno == ENOENT) return true;
+			printError("error %i in VirtualSerialPort:openPort:lstat: %s\n");
+			return false;
+		}
+
+		char linkTarget[PATH_MAX];
+		ssize_t targetLength = S_ISLNK(linkState.st_mode) ? ::readlink(this->portFileName.c_str(), linkTarget, sizeof(linkTarget) - 1) : -1;
+		if (targetLength <= 0) {
+			printf("[!] VirtualSerialPort:openPort: %s already exists and is not an link to an pseudo terminal\n", this->portFileName.c_str());
+			return false;
+		}
+		linkTarget[targetLength] = '\0';
+
+		// the pts node disappears once its master is closed, an existing node is still used by an other process
+		struct stat targetState;
+		bool targetStale = ::strcmp(linkTarget, slaveName) == 0 || (::stat(linkTarget, &targetState) != 0 && errno == ENOENT);
+		if (::strncmp(linkTarget, "/dev/pts/", 9) != 0 || !targetStale) {
+			printf("[!] VirtualSerialPort:openPort: %s already exists and links to %s, which is not an stale pseudo terminal\n", this->portFileName.c_str(), linkTarget);
+			return false;
+		}
+
+		if (::unlink(this->portFileName.c_str()) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:unlink: %s\n");
+			return false;
+		}
+		return true;
+	}
+
+public:
+	VirtualSerialPortLin(const char* portFile)
+	{
+		this->portFileName = portFile;
+		this->masterHandle = -1;
+		this->slaveHandle = -1;
+		this->configChangePending = false;
+		this->linkCreated = false;
+		this->waitEventHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (this->waitEventHandle == -1)
+			printError("error %i in VirtualSerialPort:eventfd: %s\n");
+	}
+
+	~VirtualSerialPortLin() {
+		closePort();
+		::close(this->waitEventHandle);
+	}
+
+	bool openPort() override
+	{
+		if (isCreated()) return false;
+
+		// create pseudo terminal
+		this->masterHandle = ::posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		if (this->masterHandle == -1) {
+			printError("error %i in VirtualSerialPort:openPort:posix_openpt: %s\n");
+			return false;
+		}
+		if (::grantpt(this->masterHandle) != 0 || ::unlockpt(this->masterHandle) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:unlockpt: %s\n");
+			closePort();
+			return false;
+		}
+		const char* slaveName = ::ptsname(this->masterHandle);
+		if (slaveName == nullptr) {
+			printError("error %i in VirtualSerialPort:openPort:ptsname: %s\n");
+			closePort();
+			return false;
+		}
+
+		// keep the slave open, otherwise the master reports an hangup while the application has not opened the port
+		this->slaveHandle = ::open(slaveName, O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (this->slaveHandle == -1) {
+			printError("error %i in VirtualSerialPort:openPort:open: %s\n");
+			closePort();
+			return false;
+		}
+
+		// raw mode with external processing, termios changes are then reported to the master
+		struct termios slaveState;
+		if (::tcgetattr(this->slaveHandle, &slaveState) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:tcgetattr: %s\n");
+			closePort();
+			return false;
+		}
+		::cfmakeraw(&slaveState);
+		slaveState.c_lflag |= EXTPROC;
+		slaveState.c_cflag |= CLOCAL;
+		if (::tcsetattr(this->slaveHandle, TCSANOW, &slaveState) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:tcsetattr: %s\n");
+			closePort();
+			return false;
+		}
+
+		int packetMode = 1;
+		if (::ioctl(this->masterHandle, TIOCPKT, &packetMode) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:ioctl(TIOCPKT): %s\n");
+			closePort();
+			return false;
+		}
+
+		// expose the pseudo terminal under the requested name, replacing an stale link of an previous instance
+		if (!removeStaleLink(slaveName)) {
+			closePort();
+			return false;
+		}
+		if (::symlink(slaveName, this->portFileName.c_str()) != 0) {
+			printError("error %i in VirtualSerialPort:openPort:symlink: %s\n");
+			closePort();
+			return false;
+		}
+		this->linkCreated = true;
+
+		// drain abort signals of an previous instance
+		unsigned long long val;
+		if (::read(this->waitEventHandle, (char*) &val, 8) == -1 && errno != EAGAIN)
+			printError("error %i in VirtualSerialPort:openPort:read: %s\n");
+		this->configChangePending = false;
+
+		return true;
+	}
+
+	void closePort() override
+	{
+		if (this->linkCreated)
+			::unlink(this->portFileName.c_str());
+		this->linkCreated = false;
+		if (this->slaveHandle != -1)
+			::close(this->slaveHandle);
+		if (this->masterHandle != -1)
+			::close(this->masterHandle);
+		this->slaveHandle = -1;
+		this->masterHandle = -1;
+
+		// release pending waits
+		unsigned long long val = 1;
+		if (::write(this->waitEventHandle, (char*) &val, 8) == -1)
+			printError("error %i in VirtualSerialPort:closePort:write: %s\n");
+	}
+
+	bool isCreated() override
+	{
+		return this->masterHandle != -1;
+	}
+
+	bool getConfig(SerialAccess::SerialPortConfig &config) override
+	{
+		if (!isCreated()) return false;
+
+		struct termios slaveState;
+		if (::tcgetattr(this->slaveHandle, &slaveState) != 0) {
+			printError("error %i in VirtualSerialPort:getConfig:tcgetattr: %s\n");
+			return false;
+		}
+
+		config.baudRate = getBaud();
+
+		// NOTE: the pty driver always forces CS8 and clears PARENB, data bits and parity can not be transported
+		switch (slaveState.c_cflag & CSIZE) {
+		case CS5: config.dataBits = 5; break;
+		case CS6: config.dataBits = 6; break;
+		case CS7: config.dataBits = 7; break;
+		default:
+		case CS8: config.dataBits = 8; break;
+		}
+
+		if (slaveState.c_cflag & PARENB) {
+			config.parity = (slaveState.c_cflag & PARODD) ? SerialAccess::SPC_PARITY_ODD : SerialAccess::SPC_PARITY_EVEN;
+		} else
+			config.parity = SerialAccess::SPC_PARITY_NONE;
+
+		config.stopBits = (slaveState.c_cflag & CSTOPB) ? SerialAccess::SPC_STOPB_TWO : SerialAccess::SPC_STOPB_ONE;
+
+		if ((slaveState.c_iflag & IXON) || (slaveState.c_iflag & IXOFF))
+			config.flowControl = SerialAccess::SPC_FLOW_XON_XOFF;
+		else if (slaveState.c_cflag & CRTSCTS)
+			config.flowControl = SerialAccess::SPC_FLOW_RTS_CTS;
+		else
+			config.flowControl = SerialAccess::SPC_FLOW_NONE;
+
+		config.xonChar = slaveState.c_cc[VSTART];
+		config.xoffChar = slaveState.c_cc[VSTOP];
+		config.lowLatency = false;
+
+		return true;
+	}
+
+	unsigned long getBaud() override
+	{
+		if (!isCreated()) return 0;
+
+		// the kernel keeps the numeric rate updated, also for rates set trough the Bxxx table
+		struct VirtualTermios2 slaveState2;
+		if (::ioctl(this->slaveHandle, VIRTUAL_TCGETS2, &slaveState2) != 0) {
+			printError("error %i in VirtualSerialPort:getBaud:ioctl(TCGETS2): %s\n");
+			return 0;
+		}
+
+		return slaveState2.c_ospeed;
+	}
+
+	bool getTimeouts(int* readTimeout, int* readTimeoutInterval, int* writeTimeout) override
+	{
+		if (!isCreated()) return false;
+
+		struct termios slaveState;
+		if (::tcgetattr(this->slaveHandle, &slaveState) != 0) {
+			printError("error %i in VirtualSerialPort:getTimeouts:tcgetattr: %s\n");
+			return false;
+		}
+
+		// VTIME is in tenths of a second, without VTIME but with VMIN reads block indefinitely
+		*readTimeout = (slaveState.c_cc[VTIME] == 0 && slaveState.c_cc[VMIN] > 0) ? -1 : slaveState.c_cc[VTIME] * 100;
+		*readTimeoutInterval = 0;
+		*writeTimeout = 0;
+		return true;
+	}
+
+	long long int readBytes(char* buffer, unsigned long bufferCapacity, bool wait) override
+	{
+		if (!isCreated()) return -2;
+
+		while (true) {
+
+			// in packet mode, every read starts with an status byte
+			unsigned char status = 0;
+			struct iovec parts[2] = {
+				{ &status, 1 },
+				{ buffer, bufferCapacity }
+			};
+			ssize_t receivedBytes = ::readv(this->masterHandle, parts, 2);
+
+			if (receivedBytes < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN) {
+					if (!wait) return 0;
+					struct pollfd pollfds[2] = {
+						{ this->masterHandle, POLLIN, 0 },
+						{ this->waitEventHandle, POLLIN, 0 }
+					};
+					if (::poll(pollfds, 2, -1) < 0 && errno != EINTR) {
+						printError("error %i in VirtualSerialPort:readBytes:poll: %s\n");
+						return -2;
+					}
+					if (!isCreated()) return -2;
+					continue;
+				}
+				printError("error %i in VirtualSerialPort:readBytes:readv: %s\n");
+				closePort();
+				return -2;
+			}
+
+			if (receivedBytes == 0) return 0;
+
+			// an status only packet does not contain any data
+			if (status != TIOCPKT_DATA) {
+				processPacketStatus(status);
+				if (!wait) return 0;
+				continue;
+			}
+
+			return receivedBytes - 1;
+		}
+	}
+
+	long long int writeBytes(const char* buffer, unsigned long bufferLength, bool wait) override
+	{
+		if (!isCreated()) return -2;
+
+		while (true) {
+
+			ssize_t writtenBytes = ::write(this->masterHandle, buffer, bufferLength);
+
+			if (writtenBytes < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN) {
+					if (!wait) return -1; // the application did not yet read enough data
+					struct pollfd pollfds[2] = {
+						{ this->masterHandle, POLLOUT, 0 },
+						{ this->waitEventHandle, POLLIN, 0 }
+					};
+					if (::poll(pollfds, 2, -1) < 0 && errno != EINTR) {
+						printError("error %i in VirtualSerialPort:writeBytes:poll: %s\n");
+						return -2;
+					}
+					if (!isCreated()) return -2;
+					continue;
+				}
+				printError("error %i in VirtualSerialPort:writeBytes:write: %s\n");
+				closePort();
+				return -2;
+			}
+
+			return writtenBytes;
+		}
+	}
+
+	bool getBufferSizes(unsigned long* txBufferSize, unsigned long* rxBufferSize) override
+	{
+		if (!isCreated()) return false;
+
+		*txBufferSize = PTY_BUFFER_SIZE;
+		*rxBufferSize = PTY_BUFFER_SIZE;
+		return true;
+	}
+
+	bool setBufferSizes(unsigned long /*txBufferSize*/, unsigned long /*rxBufferSize*/) override
+	{
+		if (!isCreated()) return false;
+
+		// the buffers of the pty line discipline are fixed, only clear them
+		if (::tcflush(this->slaveHandle, TCIOFLUSH) != 0) {
+			printError("error %i in VirtualSerialPort:setBufferSizes:tcflush: %s\n");
+			return false;
+		}
+		return true;
+	}
+
+	bool getPortState(bool& dtr, bool& rts) override
+	{
+		if (!isCreated()) return false;
+
+		// an pseudo terminal has no modem lines, report them as always asserted
+		dtr = true;
+		rts = true;
+		return true;
+	}
+
+	bool setManualPortState(bool /*dsr*/, bool /*cts*/) override
+	{
+		if (!isCreated()) return false;
+
+		// an pseudo terminal has no modem lines, the state can not be passed to the application
+		return true;
+	}
+
+	bool waitForEvents(bool& configChange, bool& timeoutChange, bool& comStateChange, bool& dataReceived, bool& dataTransmitted, bool wait) override
+	{
+		if (!isCreated()) return false;
+
+		bool requestConfig = configChange || timeoutChange;
+		bool requestReceive = dataReceived;
+		bool requestTransmit = dataTransmitted;
+
+		configChange = false;
+		timeoutChange = false;
+		comStateChange = false;
+		dataReceived = false;
+		dataTransmitted = false;
+
+		// if no event was requested, return
+		if (!requestConfig && !requestReceive && !requestTransmit) return true;
+
+		while (true) {
+
+			// config changes might have been collected by an previous read
+			if (requestConfig && this->configChangePending) {
+				this->configChangePending = false;
+				configChange = true;
+				timeoutChange = true; // timeouts are part of the termios configuration
+				return true;
+			}
+
+			// status changes are signaled as priority data
+			struct pollfd pollfds[2] = {
+				{ this->masterHandle, (short) ((requestConfig ? POLLPRI : 0) | (requestReceive ? POLLIN : 0) | (requestTransmit ? POLLOUT : 0)), 0 },
+				{ this->waitEventHandle, POLLIN, 0 }
+			};
+			int pollres = ::poll(pollfds, 2, wait ? -1 : 0);
+			if (pollres < 0) {
+				if (errno == EINTR) continue;
+				printError("error %i in VirtualSerialPort:waitForEvents:poll: %s\n");
+				return false;
+			}
+			if (pollres == 0) return true;
+
+			// wait aborted
+			if (pollfds[1].revents) {
+				unsigned long long val;
+				if (::read(this->waitEventHandle, (char*) &val, 8) == -1 && errno != EAGAIN)
+					printError("error %i in VirtualSerialPort:waitForEvents:read: %s\n");
+				return false;
+			}
+
+			// an pending status is returned by the next read, without any data
+			if (pollfds[0].revents & POLLPRI) {
+				unsigned char status = 0;
+				if (::read(this->masterHandle, (char*) &status, 1) == 1)
+					processPacketStatus(status);
+				if (!requestReceive && !requestTransmit) continue;
+			}
+
+			if (pollfds[0].revents & (POLLERR | POLLHUP)) {
+				closePort();
+				return false;
+			}
+
+			dataReceived = requestReceive && (pollfds[0].revents & POLLIN);
+			dataTransmitted = requestTransmit && (pollfds[0].revents & POLLOUT);
+			if (requestConfig && this->configChangePending) {
+				this->configChangePending = false;
+				configChange = true;
+				timeoutChange = true;
+			}
+			if (configChange || dataReceived || dataTransmitted) return true;
+			if (!wait) return true;
+
+		}
+	}
+
+	void abortWait() override
+	{
+		unsigned long long val = 1;
+		if (::write(this->waitEventHandle, (char*) &val, 8) == -1)
+			printError("error %i in VirtualSerialPort:abortWait:write: %s\n");
+	}
+
+};
+
+SerialAccess::VirtualSerialPort* SerialAccess::newVirtualSerialPort(const char* portFile) {
+	return new VirtualSerialPortLin(portFile);
+}
+
+SerialAccess::VirtualSerialPort* SerialAccess::newVirtualSerialPortS(const std::string& portFile) {
+	return new VirtualSerialPortLin(portFile.c_str());
+}
+
+#endif
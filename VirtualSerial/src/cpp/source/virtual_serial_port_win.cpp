@@ -5,6 +5,8 @@
  *      Author: marvi
  */
 
+#ifdef PLATFORM_WIN
+
 #include "VCOM/public.h"
 #include "VCOM/serial.h"
 #include <windows.h>
@@ -172,6 +174,7 @@ public:
 
 		config.xonChar = serialChars.XonChar;
 		config.xoffChar = serialChars.XoffChar;
+		config.lowLatency = false;
 
 		SERIAL_HANDFLOW flowControl;
 		if (!::DeviceIoControl(this->comPortHandle, IOCTL_APPLINK_GET_FLOW_CONTROL, NULL, 0, &flowControl, sizeof(SERIAL_HANDFLOW), &bytesReturned, NULL)) {
@@ -531,13 +534,31 @@ public:
 
 		}
 
+		// pending reads and writes of the requested directions end the wait too, their results are taken by the next readBytes()/writeBytes()
+		bool readPending = dataReceived && this->readOverlapped.hEvent != INVALID_HANDLE_VALUE;
+		bool writePending = dataTransmitted && this->writeOverlapped.hEvent != INVALID_HANDLE_VALUE;
+
 		configChange = false;
 		timeoutChange = false;
 		comStateChange = false;
 		dataReceived = false;
 		dataTransmitted = false;
 
-		// If not, wait for completition
+		// If not, wait for completition, abortWait() cancels the wait operation which also ends this wait
+		if (wait && (readPending || writePending)) {
+			HANDLE waitHandles[3] = { this->waitEventHandle };
+			DWORD handleCount = 1;
+			if (readPending) waitHandles[handleCount++] = this->readEventHandle;
+			if (writePending) waitHandles[handleCount++] = this->writeEventHandle;
+			DWORD result = WaitForMultipleObjects(handleCount, waitHandles, FALSE, INFINITE);
+			if (result >= WAIT_OBJECT_0 + 1 && result < WAIT_OBJECT_0 + handleCount) {
+				dataReceived = readPending && waitHandles[result - WAIT_OBJECT_0] == this->readEventHandle;
+				dataTransmitted = writePending && waitHandles[result - WAIT_OBJECT_0] == this->writeEventHandle;
+				return true;
+			}
+			if (result == WAIT_FAILED)
+				printError("error 0x%x in VirtualSerialPort:waitForEvents:WaitForMultipleObjects: %s");
+		}
 		if (!GetOverlappedResult(this->comPortHandle, &this->waitOverlapped, &bytesReturned, wait)) {
 			if (GetLastError() == ERROR_IO_INCOMPLETE)
 				return true; // not yet completed
@@ -579,3 +600,5 @@ SerialAccess::VirtualSerialPort* SerialAccess::newVirtualSerialPort(const char*
 SerialAccess::VirtualSerialPort* SerialAccess::newVirtualSerialPortS(const std::string& portFile) {
 	return new VirtualSerialPortWin(portFile.c_str());
 }
+
+#endif